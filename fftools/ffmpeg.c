@@ -343,6 +343,7 @@ static void ffmpeg_cleanup(int ret)
     hw_device_free_all();
 
     av_freep(&filter_nbthreads);
+    av_freep(&filter_buffer_pool_flags);
 
     av_freep(&print_graphs_file);
     av_freep(&print_graphs_format);
@@ -738,6 +738,8 @@ extern float max_error_rate;
 extern char *filter_nbthreads;
 extern int filter_complex_nbthreads;
 extern int filter_buffered_frames;
+extern char *filter_buffer_pool_flags;
+extern int filter_pipeline;
 extern int vstats_version;
 extern int print_graphs;
 extern char *print_graphs_file;
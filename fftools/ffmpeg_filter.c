@@ -594,6 +594,157 @@ fail:
     return ret;
 }
 
+#define WHITESPACES " \n\t\r"
+
+static int skip_token(const char **buf, const char *term)
+{
+    char *tok = av_get_token(buf, term);
+    if (!tok)
+        return AVERROR(ENOMEM);
+    av_free(tok);
+    return 0;
+}
+
+static int skip_labels(const char **buf, int *found)
+{
+    while (**buf == '[') {
+        const char *end = strchr(*buf, ']');
+        if (!end)
+            return AVERROR(EINVAL);
+        *buf   = end + 1 + strspn(end + 1, WHITESPACES);
+        *found = 1;
+    }
+    return 0;
+}
+
+static int add_stage(char ***stages, int *nb_stages, const char *prefix,
+                     int prefix_len, AVBPrint *stage)
+{
+    char *desc;
+    int ret;
+
+    if (!av_bprint_is_complete(stage))
+        return AVERROR(ENOMEM);
+
+    desc = av_asprintf("%.*s%s", prefix_len, prefix, stage->str);
+    if (!desc)
+        return AVERROR(ENOMEM);
+
+    ret = av_dynarray_add_nofree(stages, nb_stages, desc);
+    if (ret < 0)
+        av_free(desc);
+
+    av_bprint_clear(stage);
+    return ret;
+}
+
+/**
+ * Split a filtergraph description into stages for -filter_pipeline.
+ *
+ * Each chain becomes a stage of its own. With per_filter, so does each filter
+ * in a chain whose link to the previous filter is not labeled: the link is
+ * given a generated label on both sides, so that the stages are connected
+ * with the same label binding as separate -filter_complex graphs. For simple
+ * filtergraphs, only plain chains without any labels are split, and the
+ * stages are returned without labels, to be bound explicitly.
+ *
+ * The description is not otherwise validated here, anything unexpected
+ * leaves it as a single stage for the filtergraph parser to report.
+ *
+ * @return number of stages, *pstages is only set if there is more than one;
+ *         or a negative error code
+ */
+static int graph_split(const char *desc, int simple, int per_filter,
+                       char ***pstages)
+{
+    static unsigned nb_links;
+    const char *p = desc, *prefix = "";
+    char **stages = NULL;
+    int nb_stages = 0, prefix_len = 0, ret = 0;
+    int chained = 0, prev_out = 0, parsed = 0;
+    AVBPrint stage;
+
+    *pstages = NULL;
+
+    av_bprint_init(&stage, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    p += strspn(p, WHITESPACES);
+    if (!strncmp(p, "sws_flags=", 10)) {
+        const char *end = strchr(p, ';');
+        if (simple || !end)
+            goto end;
+        prefix     = p;
+        prefix_len = end + 1 - p;
+        p          = end + 1;
+    }
+
+    while (*(p += strspn(p, WHITESPACES))) {
+        const char *start = p;
+        int has_in = 0, has_out = 0;
+        char sep;
+
+        if ((ret = skip_labels(&p, &has_in)) < 0 ||
+            (ret = skip_token(&p, "=,;[")) < 0)
+            goto end;
+        if (*p == '=') {
+            p++;
+            if ((ret = skip_token(&p, "[],;")) < 0)
+                goto end;
+        }
+        if ((ret = skip_labels(&p, &has_out)) < 0)
+            goto end;
+
+        sep = *p;
+        if ((sep && sep != ',' && sep != ';') ||
+            (simple && (has_in || has_out || sep == ';')))
+            goto end;
+
+        if (chained && per_filter && !prev_out && !has_in) {
+            if (!simple)
+                av_bprintf(&stage, "[_pipe%u]", nb_links);
+            ret = add_stage(&stages, &nb_stages, prefix, prefix_len, &stage);
+            if (ret < 0)
+                goto end;
+            if (!simple)
+                av_bprintf(&stage, "[_pipe%u]", nb_links++);
+        } else if (chained)
+            av_bprint_chars(&stage, ',', 1);
+        av_bprint_append_data(&stage, start, p - start);
+
+        if (sep != ',') {
+            ret = add_stage(&stages, &nb_stages, prefix, prefix_len, &stage);
+            if (ret < 0)
+                goto end;
+        }
+
+        chained  = sep == ',';
+        prev_out = has_out;
+        if (sep)
+            p++;
+    }
+    // a chain may end with a trailing comma
+    if (stage.len) {
+        ret = add_stage(&stages, &nb_stages, prefix, prefix_len, &stage);
+        if (ret < 0)
+            goto end;
+    }
+    parsed = 1;
+
+end:
+    av_bprint_finalize(&stage, NULL);
+
+    if (parsed && nb_stages > 1) {
+        *pstages = stages;
+        return nb_stages;
+    }
+
+    for (int i = 0; i < nb_stages; i++)
+        av_free(stages[i]);
+    av_free(stages);
+
+    return ret == AVERROR(ENOMEM) ? ret : 1;
+}
+
 // Filters can be configured only if the formats of all inputs are known.
 static int ifilter_has_all_input_formats(FilterGraph *fg)
 {
@@ -920,9 +1071,11 @@ static int ofilter_bind_ifilter(OutputFilter *ofilter, InputFilterPriv *ifp,
     return 0;
 }
 
-static int ifilter_bind_fg(InputFilterPriv *ifp, FilterGraph *fg_src, int out_idx)
+static int ifilter_bind_fg(InputFilterPriv *ifp, FilterGraph *fg_src, int out_idx,
+                           const char *output_name)
 {
     FilterGraphPriv      *fgp = fgp_from_fg(ifp->ifilter.graph);
+    FilterGraphPriv  *fgp_src = fgp_from_fg(fg_src);
     OutputFilter *ofilter_src = fg_src->outputs[out_idx];
     OutputFilterOptions opts;
     char name[32];
@@ -942,14 +1095,17 @@ static int ifilter_bind_fg(InputFilterPriv *ifp, FilterGraph *fg_src, int out_id
 
     memset(&opts, 0, sizeof(opts));
 
-    snprintf(name, sizeof(name), "fg:%d:%d", fgp->fg.index, ifp->ifilter.index);
+    if (output_name)
+        av_strlcpy(name, output_name, sizeof(name));
+    else
+        snprintf(name, sizeof(name), "fg:%d:%d", fgp->fg.index, ifp->ifilter.index);
     opts.name = name;
 
     ret = ofilter_bind_ifilter(ofilter_src, ifp, &opts);
     if (ret < 0)
         return ret;
 
-    ret = sch_connect(fgp->sch, SCH_FILTER_OUT(fg_src->index, out_idx),
+    ret = sch_connect(fgp->sch, SCH_FILTER_OUT(fgp_src->sch_idx, out_idx),
                                 SCH_FILTER_IN(fgp->sch_idx, ifp->ifilter.index));
     if (ret < 0)
         return ret;
@@ -1066,6 +1222,29 @@ int fg_create(FilterGraph **pfg, char *graph_desc, Scheduler *sch)
     AVFilterGraph *graph;
     int ret = 0;
 
+    if (!pfg && filter_pipeline) {
+        char **stages;
+        int nb_stages = graph_split(graph_desc, 0, filter_pipeline > 1, &stages);
+
+        if (nb_stages < 0) {
+            av_freep(&graph_desc);
+            return nb_stages;
+        }
+        if (nb_stages > 1) {
+            av_log(NULL, AV_LOG_VERBOSE, "Running filtergraph '%s' as %d "
+                   "pipelined stages\n", graph_desc, nb_stages);
+            for (int i = 0; i < nb_stages; i++) {
+                if (ret >= 0)
+                    ret = fg_create(NULL, stages[i], sch);
+                else
+                    av_freep(&stages[i]);
+            }
+            av_freep(&stages);
+            av_freep(&graph_desc);
+            return ret;
+        }
+    }
+
     fgp = av_mallocz(sizeof(*fgp));
     if (!fgp) {
         av_freep(&graph_desc);
@@ -1200,49 +1379,103 @@ int fg_create_simple(FilterGraph **pfg,
                      const OutputFilterOptions *opts)
 {
     const enum AVMediaType type = ist->par->codec_type;
-    FilterGraph *fg;
+    FilterGraph *fg, *prev = NULL;
     FilterGraphPriv *fgp;
-    int ret;
+    char **stages = NULL;
+    int nb_stages = 1, ret = 0;
 
-    ret = fg_create(pfg, graph_desc, sch);
-    if (ret < 0)
-        return ret;
-    fg  = *pfg;
-    fgp = fgp_from_fg(fg);
+    if (filter_pipeline > 1) {
+        nb_stages = graph_split(graph_desc, 1, 1, &stages);
+        if (nb_stages < 0) {
+            av_freep(&graph_desc);
+            return nb_stages;
+        }
+    }
 
-    fgp->is_simple = 1;
+    // with -filter_pipeline, the leading filters of the chain run in
+    // filtergraphs of their own, each feeding the next one
+    for (int i = 0; i < nb_stages; i++) {
+        const int last = i == nb_stages - 1;
+        char *desc = graph_desc;
 
-    snprintf(fgp->log_name, sizeof(fgp->log_name), "%cf%s",
-             av_get_media_type_string(type)[0], opts->name);
+        if (stages) {
+            desc      = stages[i];
+            stages[i] = NULL;
+        }
 
-    if (fg->nb_inputs != 1 || fg->nb_outputs != 1) {
-        av_log(fg, AV_LOG_ERROR, "Simple filtergraph '%s' was expected "
-               "to have exactly 1 input and 1 output. "
-               "However, it had %d input(s) and %d output(s). Please adjust, "
-               "or use a complex filtergraph (-filter_complex) instead.\n",
-               graph_desc, fg->nb_inputs, fg->nb_outputs);
-        return AVERROR(EINVAL);
-    }
-    if (fg->outputs[0]->type != type) {
-        av_log(fg, AV_LOG_ERROR, "Filtergraph has a %s output, cannot connect "
-               "it to %s output stream\n",
-               av_get_media_type_string(fg->outputs[0]->type),
-               av_get_media_type_string(type));
-        return AVERROR(EINVAL);
-    }
+        ret = fg_create(last ? pfg : NULL, desc, sch);
+        if (ret < 0)
+            goto fail;
+        fg  = last ? *pfg : filtergraphs[nb_filtergraphs - 1];
+        fgp = fgp_from_fg(fg);
 
-    ret = ifilter_bind_ist(fg->inputs[0], ist, opts->vs);
-    if (ret < 0)
-        return ret;
+        fgp->is_simple = 1;
 
-    ret = ofilter_bind_enc(fg->outputs[0], sched_idx_enc, opts);
-    if (ret < 0)
-        return ret;
+        if (last)
+            snprintf(fgp->log_name, sizeof(fgp->log_name), "%cf%s",
+                     av_get_media_type_string(type)[0], opts->name);
+        else
+            snprintf(fgp->log_name, sizeof(fgp->log_name), "%cf%s/%d",
+                     av_get_media_type_string(type)[0], opts->name, i);
+
+        if (fg->nb_inputs != 1 || fg->nb_outputs != 1) {
+            av_log(fg, AV_LOG_ERROR, "Simple filtergraph '%s' was expected "
+                   "to have exactly 1 input and 1 output. "
+                   "However, it had %d input(s) and %d output(s). Please adjust, "
+                   "or use a complex filtergraph (-filter_complex) instead.\n",
+                   fg->graph_desc, fg->nb_inputs, fg->nb_outputs);
+            ret = AVERROR(EINVAL);
+            goto fail;
+        }
+        if (last && fg->outputs[0]->type != type) {
+            av_log(fg, AV_LOG_ERROR, "Filtergraph has a %s output, cannot connect "
+                   "it to %s output stream\n",
+                   av_get_media_type_string(fg->outputs[0]->type),
+                   av_get_media_type_string(type));
+            ret = AVERROR(EINVAL);
+            goto fail;
+        }
 
-    if (opts->nb_threads >= 0)
-        fgp->nb_threads = opts->nb_threads;
+        if (prev) {
+            char name[32];
 
-    return 0;
+            snprintf(name, sizeof(name), "%s/%d", opts->name, i - 1);
+            ret = ifilter_bind_fg(ifp_from_ifilter(fg->inputs[0]), prev, 0, name);
+        } else
+            ret = ifilter_bind_ist(fg->inputs[0], ist, opts->vs);
+        if (ret < 0)
+            goto fail;
+
+        if (last) {
+            ret = ofilter_bind_enc(fg->outputs[0], sched_idx_enc, opts);
+            if (ret < 0)
+                goto fail;
+        } else {
+            OutputFilterPriv *ofp = ofp_from_ofilter(fg->outputs[0]);
+
+            // scaling and resampling options apply to every stage
+            ret = av_dict_copy(&ofp->sws_opts, opts->sws_opts, 0);
+            if (ret < 0)
+                goto fail;
+            ret = av_dict_copy(&ofp->swr_opts, opts->swr_opts, 0);
+            if (ret < 0)
+                goto fail;
+        }
+
+        if (opts->nb_threads >= 0)
+            fgp->nb_threads = opts->nb_threads;
+
+        prev = fg;
+    }
+
+fail:
+    if (stages) {
+        for (int i = 0; i < nb_stages; i++)
+            av_freep(&stages[i]);
+        av_freep(&stages);
+        av_freep(&graph_desc);
+    }
+    return ret;
 }
 
 static int fg_complex_bind_input(FilterGraph *fg, InputFilter *ifilter)
@@ -1300,7 +1533,7 @@ static int fg_complex_bind_input(FilterGraph *fg, InputFilter *ifilter)
                            "Binding input with label '%s' to filtergraph output %d:%d\n",
                            ifilter->linklabel, i, j);
 
-                    ret = ifilter_bind_fg(ifp, fg_src, j);
+                    ret = ifilter_bind_fg(ifp, fg_src, j, NULL);
                     if (ret < 0)
                         av_log(fg, AV_LOG_ERROR, "Error binding filtergraph input %s\n",
                                ifilter->linklabel);
@@ -1955,6 +2188,12 @@ static int configure_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
             return ret;
     }
 
+    if (filter_buffer_pool_flags) {
+        ret = av_opt_set(fgt->graph, "buffer_pool_flags", filter_buffer_pool_flags, 0);
+        if (ret < 0)
+            return ret;
+    }
+
     hw_device = hw_device_for_filter();
 
     ret = graph_parse(fg, fgt->graph, graph_desc, &inputs, &outputs, hw_device);
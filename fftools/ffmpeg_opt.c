@@ -76,6 +76,8 @@ float max_error_rate  = 2.0/3;
 char *filter_nbthreads;
 int filter_complex_nbthreads = 0;
 int filter_buffered_frames = 0;
+char *filter_buffer_pool_flags;
+int filter_pipeline = 0;
 int vstats_version = 2;
 int print_graphs = 0;
 char *print_graphs_file = NULL;
@@ -628,6 +630,18 @@ static int opt_sdp_file(void *optctx, const char *opt, const char *arg)
     return sch_sdp_filename(go->sch, arg);
 }
 
+static int opt_sched_stats(void *optctx, const char *opt, const char *arg)
+{
+    GlobalOptionsContext *go = optctx;
+    return sch_stats(go->sch, NULL);
+}
+
+static int opt_sched_trace(void *optctx, const char *opt, const char *arg)
+{
+    GlobalOptionsContext *go = optctx;
+    return sch_stats(go->sch, arg);
+}
+
 #if CONFIG_VAAPI
 static int opt_vaapi_device(void *optctx, const char *opt, const char *arg)
 {
@@ -1619,6 +1633,12 @@ const OptionDef options[] = {
     { "benchmark_all",          OPT_TYPE_BOOL, OPT_EXPERT,
         { &do_benchmark_all },
       "add timings for each task" },
+    { "sched_stats",            OPT_TYPE_FUNC, OPT_EXPERT,
+        { .func_arg = opt_sched_stats },
+      "print how long each thread was busy or waiting and how full its input queue was" },
+    { "sched_trace",            OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_sched_trace },
+      "like sched_stats, and write each wait to a file in the Chrome trace format", "filename" },
     { "progress",               OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_progress },
       "write program-readable progress information", "url" },
@@ -1718,6 +1738,12 @@ const OptionDef options[] = {
     { "filter_buffered_frames", OPT_TYPE_INT, OPT_EXPERT,
         { &filter_buffered_frames },
         "maximum number of buffered frames in a filter graph" },
+    { "filter_buffer_pool_flags", OPT_TYPE_STRING, OPT_EXPERT,
+        { &filter_buffer_pool_flags },
+        "allocation flags for the frame buffer pools of filter graphs", "flags" },
+    { "filter_pipeline",        OPT_TYPE_INT, OPT_EXPERT,
+        { &filter_pipeline },
+        "run filtergraphs as pipelined stages in separate threads: 1 per filterchain, 2 per filter", "level" },
 #if FFMPEG_OPT_FILTER_SCRIPT
     { "filter_script",          OPT_TYPE_STRING, OPT_PERSTREAM | OPT_EXPERT | OPT_OUTPUT,
         { .off = OFFSET(filter_scripts) },
@@ -32,6 +32,7 @@
 #include "libavcodec/packet.h"
 
 #include "libavutil/avassert.h"
+#include "libavutil/bprint.h"
 #include "libavutil/error.h"
 #include "libavutil/fifo.h"
 #include "libavutil/frame.h"
@@ -40,6 +41,8 @@
 #include "libavutil/threadmessage.h"
 #include "libavutil/time.h"
 
+#include "libavformat/avio.h"
+
 // 100 ms
 // FIXME: some other value? make this dynamic?
 #define SCHEDULE_TOLERANCE (100 * 1000)
@@ -60,6 +63,33 @@ typedef struct SchWaiter {
     int                 choked_next;
 } SchWaiter;
 
+enum SchWait {
+    // in a receive call, i.e. waiting for input
+    SCH_WAIT_INPUT,
+    // in a send call, i.e. waiting for downstream queues to accept output
+    SCH_WAIT_OUTPUT,
+    // paused by the scheduler, see waiter_wait()
+    SCH_WAIT_CHOKED,
+    SCH_WAIT_NB,
+};
+
+typedef struct SchTraceEvent {
+    int64_t             start;
+    int64_t             duration;
+    enum SchWait        type;
+} SchTraceEvent;
+
+// only accessed by the task's own thread while it runs
+typedef struct SchTaskStats {
+    int64_t             start;
+    int64_t             end;
+    int64_t             wait[SCH_WAIT_NB];
+
+    SchTraceEvent      *events;
+    int              nb_events;
+    int                 events_failed;
+} SchTaskStats;
+
 typedef struct SchTask {
     Scheduler          *parent;
     SchedulerNode       node;
@@ -69,6 +99,8 @@ typedef struct SchTask {
 
     pthread_t           thread;
     int                 thread_running;
+
+    SchTaskStats        stats;
 } SchTask;
 
 typedef struct SchDecOutput {
@@ -311,8 +343,39 @@ struct Scheduler {
     pthread_mutex_t     schedule_lock;
 
     atomic_int_least64_t last_dts;
+
+    // set before starting, see sch_stats()
+    int                 stats;
+    char               *trace_filename;
+    int64_t             stats_start;
 };
 
+static int64_t stats_begin(const Scheduler *sch)
+{
+    return sch->stats ? av_gettime_relative() : 0;
+}
+
+static void stats_end(SchTask *task, enum SchWait type, int64_t start)
+{
+    SchTaskStats *st = &task->stats;
+    SchTraceEvent ev;
+
+    if (!task->parent->stats)
+        return;
+
+    ev = (SchTraceEvent){ .start    = start,
+                          .duration = av_gettime_relative() - start,
+                          .type     = type };
+    st->wait[type] += ev.duration;
+
+    if (!task->parent->trace_filename || !ev.duration || st->events_failed)
+        return;
+    // on failure the array is freed, so the trace for this task is dropped
+    if (!av_dynarray2_add((void **)&st->events, &st->nb_events, sizeof(ev),
+                          (const uint8_t *)&ev))
+        st->events_failed = 1;
+}
+
 /**
  * Wait until this task is allowed to proceed.
  *
@@ -371,8 +434,12 @@ static void waiter_uninit(SchWaiter *w)
     pthread_cond_destroy(&w->cond);
 }
 
+/**
+ * @param spsc the queue has a single stream and no two threads send to it
+ *             concurrently
+ */
 static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_size,
-                       enum QueueType type)
+                       enum QueueType type, int spsc)
 {
     ThreadQueue *tq;
 
@@ -392,7 +459,11 @@ static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_si
         av_assert0(queue_size == DEFAULT_FRAME_THREAD_QUEUE_SIZE);
     }
 
-    tq = tq_alloc(nb_streams, queue_size,
+    av_assert0(!spsc || nb_streams == 1);
+    tq = spsc ?
+         tq_alloc_spsc(queue_size,
+                       (type == QUEUE_PACKETS) ? THREAD_QUEUE_PACKETS : THREAD_QUEUE_FRAMES) :
+         tq_alloc(nb_streams, queue_size,
                   (type == QUEUE_PACKETS) ? THREAD_QUEUE_PACKETS : THREAD_QUEUE_FRAMES);
     if (!tq)
         return AVERROR(ENOMEM);
@@ -558,6 +629,7 @@ void sch_free(Scheduler **psch)
     av_freep(&sch->filters);
 
     av_freep(&sch->sdp_filename);
+    av_freep(&sch->trace_filename);
 
     pthread_mutex_destroy(&sch->schedule_lock);
 
@@ -615,6 +687,20 @@ int sch_sdp_filename(Scheduler *sch, const char *sdp_filename)
     return sch->sdp_filename ? 0 : AVERROR(ENOMEM);
 }
 
+int sch_stats(Scheduler *sch, const char *trace_filename)
+{
+    av_assert0(sch->state == SCH_STATE_UNINIT);
+
+    sch->stats = 1;
+
+    if (!trace_filename)
+        return 0;
+
+    av_freep(&sch->trace_filename);
+    sch->trace_filename = av_strdup(trace_filename);
+    return sch->trace_filename ? 0 : AVERROR(ENOMEM);
+}
+
 static const AVClass sch_mux_class = {
     .class_name                = "SchMux",
     .version                   = LIBAVUTIL_VERSION_INT,
@@ -761,10 +847,6 @@ int sch_add_dec(Scheduler *sch, SchThreadFunc func, void *ctx, int send_end_ts)
     if (ret < 0)
         return ret;
 
-    ret = queue_alloc(&dec->queue, 1, 0, QUEUE_PACKETS);
-    if (ret < 0)
-        return ret;
-
     if (send_end_ts) {
         ret = av_thread_message_queue_alloc(&dec->queue_end_ts, 1, sizeof(Timestamp));
         if (ret < 0)
@@ -805,10 +887,6 @@ int sch_add_enc(Scheduler *sch, SchThreadFunc func, void *ctx,
     if (!enc->send_pkt)
         return AVERROR(ENOMEM);
 
-    ret = queue_alloc(&enc->queue, 1, 0, QUEUE_FRAMES);
-    if (ret < 0)
-        return ret;
-
     return idx;
 }
 
@@ -853,7 +931,7 @@ int sch_add_filtergraph(Scheduler *sch, unsigned nb_inputs, unsigned nb_outputs,
     if (ret < 0)
         return ret;
 
-    ret = queue_alloc(&fg->queue, fg->nb_inputs + 1, 0, QUEUE_FRAMES);
+    ret = queue_alloc(&fg->queue, fg->nb_inputs + 1, 0, QUEUE_FRAMES, 0);
     if (ret < 0)
         return ret;
 
@@ -1443,6 +1521,23 @@ fail:
     return ret;
 }
 
+static int dec_is_heartbeat_dst(const Scheduler *sch, unsigned dec_idx)
+{
+    for (unsigned i = 0; i < sch->nb_mux; i++) {
+        const SchMux *mux = &sch->mux[i];
+
+        for (unsigned j = 0; j < mux->nb_streams; j++) {
+            const SchMuxStream *ms = &mux->streams[j];
+
+            for (unsigned k = 0; k < ms->nb_sub_heartbeat_dst; k++)
+                if (ms->sub_heartbeat_dst[k] == dec_idx)
+                    return 1;
+        }
+    }
+
+    return 0;
+}
+
 static int start_prepare(Scheduler *sch)
 {
     int ret;
@@ -1487,6 +1582,13 @@ static int start_prepare(Scheduler *sch)
             if (!o->dst_finished)
                 return AVERROR(ENOMEM);
         }
+
+        // packets come from the source only, unless a muxer also sends
+        // subtitle heartbeats from its own thread
+        ret = queue_alloc(&dec->queue, 1, 0, QUEUE_PACKETS,
+                          !dec_is_heartbeat_dst(sch, i));
+        if (ret < 0)
+            return ret;
     }
 
     for (unsigned i = 0; i < sch->nb_enc; i++) {
@@ -1506,6 +1608,12 @@ static int start_prepare(Scheduler *sch)
         enc->dst_finished = av_calloc(enc->nb_dst, sizeof(*enc->dst_finished));
         if (!enc->dst_finished)
             return AVERROR(ENOMEM);
+
+        // frames come from the source, or from whichever thread flushes the
+        // encoder's sync queue, with its lock held
+        ret = queue_alloc(&enc->queue, 1, 0, QUEUE_FRAMES, 1);
+        if (ret < 0)
+            return ret;
     }
 
     for (unsigned i = 0; i < sch->nb_mux; i++) {
@@ -1537,7 +1645,7 @@ static int start_prepare(Scheduler *sch)
         }
 
         ret = queue_alloc(&mux->queue, mux->nb_streams, mux->queue_size,
-                          QUEUE_PACKETS);
+                          QUEUE_PACKETS, 0);
         if (ret < 0)
             return ret;
     }
@@ -1599,6 +1707,8 @@ int sch_start(Scheduler *sch)
     av_assert0(sch->state == SCH_STATE_UNINIT);
     sch->state = SCH_STATE_STARTED;
 
+    sch->stats_start = stats_begin(sch);
+
     for (unsigned i = 0; i < sch->nb_mux; i++) {
         SchMux *mux = &sch->mux[i];
 
@@ -2030,22 +2140,31 @@ int sch_demux_send(Scheduler *sch, unsigned demux_idx, AVPacket *pkt,
                    unsigned flags)
 {
     SchDemux *d;
-    int terminate;
+    int64_t t;
+    int terminate, ret;
 
     av_assert0(demux_idx < sch->nb_demux);
     d = &sch->demux[demux_idx];
 
+    t = stats_begin(sch);
     terminate = waiter_wait(sch, &d->waiter);
+    stats_end(&d->task, SCH_WAIT_CHOKED, t);
     if (terminate)
         return AVERROR_EXIT;
 
+    t = stats_begin(sch);
+
     // flush the downstreams after seek
     if (pkt->stream_index == -1)
-        return demux_flush(sch, d, pkt);
+        ret = demux_flush(sch, d, pkt);
+    else {
+        av_assert0(pkt->stream_index < d->nb_streams);
+        ret = demux_send_for_stream(sch, d, &d->streams[pkt->stream_index], pkt, flags);
+    }
 
-    av_assert0(pkt->stream_index < d->nb_streams);
+    stats_end(&d->task, SCH_WAIT_OUTPUT, t);
 
-    return demux_send_for_stream(sch, d, &d->streams[pkt->stream_index], pkt, flags);
+    return ret;
 }
 
 static int demux_done(Scheduler *sch, unsigned demux_idx)
@@ -2073,12 +2192,16 @@ static int demux_done(Scheduler *sch, unsigned demux_idx)
 int sch_mux_receive(Scheduler *sch, unsigned mux_idx, AVPacket *pkt)
 {
     SchMux *mux;
+    int64_t t;
     int ret, stream_idx;
 
     av_assert0(mux_idx < sch->nb_mux);
     mux = &sch->mux[mux_idx];
 
+    t = stats_begin(sch);
     ret = tq_receive(mux->queue, &stream_idx, pkt);
+    stats_end(&mux->task, SCH_WAIT_INPUT, t);
+
     pkt->stream_index = stream_idx;
     return ret;
 }
@@ -2157,6 +2280,7 @@ static int mux_done(Scheduler *sch, unsigned mux_idx)
 int sch_dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
 {
     SchDec *dec;
+    int64_t t;
     int ret, dummy;
 
     av_assert0(dec_idx < sch->nb_dec);
@@ -2172,7 +2296,9 @@ int sch_dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
         dec->expect_end_ts = 0;
     }
 
+    t = stats_begin(sch);
     ret = tq_receive(dec->queue, &dummy, pkt);
+    stats_end(&dec->task, SCH_WAIT_INPUT, t);
     av_assert0(dummy <= 0);
 
     // got a flush packet, on the next call to this function the decoder
@@ -2230,8 +2356,8 @@ finish:
     return AVERROR_EOF;
 }
 
-int sch_dec_send(Scheduler *sch, unsigned dec_idx,
-                 unsigned out_idx, AVFrame *frame)
+static int dec_send(Scheduler *sch, unsigned dec_idx,
+                    unsigned out_idx, AVFrame *frame)
 {
     SchDec *dec;
     SchDecOutput *o;
@@ -2274,6 +2400,17 @@ int sch_dec_send(Scheduler *sch, unsigned dec_idx,
     return (nb_done == o->nb_dst) ? AVERROR_EOF : 0;
 }
 
+int sch_dec_send(Scheduler *sch, unsigned dec_idx,
+                 unsigned out_idx, AVFrame *frame)
+{
+    int64_t t = stats_begin(sch);
+    int ret = dec_send(sch, dec_idx, out_idx, frame);
+
+    stats_end(&sch->dec[dec_idx].task, SCH_WAIT_OUTPUT, t);
+
+    return ret;
+}
+
 static int dec_done(Scheduler *sch, unsigned dec_idx)
 {
     SchDec *dec = &sch->dec[dec_idx];
@@ -2302,12 +2439,15 @@ static int dec_done(Scheduler *sch, unsigned dec_idx)
 int sch_enc_receive(Scheduler *sch, unsigned enc_idx, AVFrame *frame)
 {
     SchEnc *enc;
+    int64_t t;
     int ret, dummy;
 
     av_assert0(enc_idx < sch->nb_enc);
     enc = &sch->enc[enc_idx];
 
+    t = stats_begin(sch);
     ret = tq_receive(enc->queue, &dummy, frame);
+    stats_end(&enc->task, SCH_WAIT_INPUT, t);
     av_assert0(dummy <= 0);
 
     return ret;
@@ -2343,7 +2483,7 @@ finish:
     return AVERROR_EOF;
 }
 
-int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
+static int enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
 {
     SchEnc *enc;
     int ret;
@@ -2376,6 +2516,16 @@ int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
     return 0;
 }
 
+int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
+{
+    int64_t t = stats_begin(sch);
+    int ret = enc_send(sch, enc_idx, pkt);
+
+    stats_end(&sch->enc[enc_idx].task, SCH_WAIT_OUTPUT, t);
+
+    return ret;
+}
+
 static int enc_done(Scheduler *sch, unsigned enc_idx)
 {
     SchEnc *enc = &sch->enc[enc_idx];
@@ -2416,14 +2566,18 @@ int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
     }
 
     if (*in_idx == fg->nb_inputs) {
+        int64_t t = stats_begin(sch);
         int terminate = waiter_wait(sch, &fg->waiter);
+        stats_end(&fg->task, SCH_WAIT_CHOKED, t);
         return terminate ? AVERROR_EOF : AVERROR(EAGAIN);
     }
 
     while (1) {
+        int64_t t = stats_begin(sch);
         int ret, idx;
 
         ret = tq_receive(fg->queue, &idx, frame);
+        stats_end(&fg->task, SCH_WAIT_INPUT, t);
         if (idx < 0)
             return AVERROR_EOF;
         else if (ret >= 0) {
@@ -2461,6 +2615,8 @@ int sch_filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *
 {
     SchFilterGraph *fg;
     SchedulerNode  dst;
+    int64_t t;
+    int ret;
 
     av_assert0(fg_idx < sch->nb_filters);
     fg = &sch->filters[fg_idx];
@@ -2468,9 +2624,13 @@ int sch_filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *
     av_assert0(out_idx < fg->nb_outputs);
     dst = fg->outputs[out_idx].dst;
 
-    return (dst.type == SCH_NODE_TYPE_ENC)                                    ?
-           send_to_enc   (sch, &sch->enc[dst.idx],                     frame) :
-           send_to_filter(sch, &sch->filters[dst.idx], dst.idx_stream, frame);
+    t = stats_begin(sch);
+    ret = (dst.type == SCH_NODE_TYPE_ENC)                                    ?
+          send_to_enc   (sch, &sch->enc[dst.idx],                     frame) :
+          send_to_filter(sch, &sch->filters[dst.idx], dst.idx_stream, frame);
+    stats_end(&fg->task, SCH_WAIT_OUTPUT, t);
+
+    return ret;
 }
 
 static int filter_done(Scheduler *sch, unsigned fg_idx)
@@ -2531,6 +2691,8 @@ static void *task_wrapper(void *arg)
     int ret;
     int err = 0;
 
+    task->stats.start = stats_begin(sch);
+
     ret = task->func(task->func_arg);
     if (ret < 0)
         av_log(task->func_arg, AV_LOG_ERROR,
@@ -2539,6 +2701,8 @@ static void *task_wrapper(void *arg)
     err = task_cleanup(sch, task->node);
     ret = err_merge(ret, err);
 
+    task->stats.end = stats_begin(sch);
+
     // EOF is considered normal termination
     if (ret == AVERROR_EOF)
         ret = 0;
@@ -2572,6 +2736,171 @@ static int task_stop(Scheduler *sch, SchTask *task)
     return (intptr_t)thread_ret;
 }
 
+/**
+ * Enumerate all tasks, along with the queue each one receives its input from,
+ * if any. Returns NULL past the last one.
+ */
+static SchTask *stats_task(Scheduler *sch, unsigned idx, ThreadQueue **queue)
+{
+    *queue = NULL;
+
+    if (idx < sch->nb_demux)
+        return &sch->demux[idx].task;
+    idx -= sch->nb_demux;
+
+    if (idx < sch->nb_dec) {
+        *queue = sch->dec[idx].queue;
+        return &sch->dec[idx].task;
+    }
+    idx -= sch->nb_dec;
+
+    if (idx < sch->nb_filters) {
+        *queue = sch->filters[idx].queue;
+        return &sch->filters[idx].task;
+    }
+    idx -= sch->nb_filters;
+
+    if (idx < sch->nb_enc) {
+        *queue = sch->enc[idx].queue;
+        return &sch->enc[idx].task;
+    }
+    idx -= sch->nb_enc;
+
+    if (idx < sch->nb_mux) {
+        *queue = sch->mux[idx].queue;
+        return &sch->mux[idx].task;
+    }
+
+    return NULL;
+}
+
+static void stats_print(const SchTask *task, const ThreadQueue *queue)
+{
+    const SchTaskStats *st = &task->stats;
+    const double total = FFMAX(st->end - st->start, 1);
+    int64_t busy = st->end - st->start;
+    const uint64_t *hist;
+    uint64_t nb_sends = 0;
+    size_t nb_hist;
+    AVBPrint bp;
+
+    for (int i = 0; i < SCH_WAIT_NB; i++)
+        busy -= st->wait[i];
+
+    av_log(task->func_arg, AV_LOG_INFO,
+           "Ran for %.3fs: busy %.1f%%, waiting for input %.1f%%, "
+           "for output %.1f%%, choked %.1f%%\n",
+           total / 1e6, 100 * busy / total,
+           100 * st->wait[SCH_WAIT_INPUT]  / total,
+           100 * st->wait[SCH_WAIT_OUTPUT] / total,
+           100 * st->wait[SCH_WAIT_CHOKED] / total);
+
+    if (!queue)
+        return;
+
+    nb_hist = tq_occupancy(queue, &hist);
+    for (size_t i = 0; i < nb_hist; i++)
+        nb_sends += hist[i];
+    if (!nb_sends)
+        return;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_AUTOMATIC);
+    for (size_t i = 0; i < nb_hist; i++)
+        if (hist[i])
+            av_bprintf(&bp, " %zu:%.1f%%", i, 100.0 * hist[i] / nb_sends);
+    av_log(task->func_arg, AV_LOG_INFO,
+           "Input queue items after each of %"PRIu64" sends, out of %zu:%s\n",
+           nb_sends, nb_hist - 1, bp.str);
+    av_bprint_finalize(&bp, NULL);
+}
+
+static void trace_write_string(AVIOContext *pb, const char *str)
+{
+    avio_w8(pb, '"');
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\')
+            avio_w8(pb, '\\');
+        if ((unsigned char)*str >= 0x20)
+            avio_w8(pb, *str);
+    }
+    avio_w8(pb, '"');
+}
+
+/* Write the trace in the Chrome trace event format, as read by e.g. Perfetto,
+ * with a track for each task. */
+static int stats_write_trace(Scheduler *sch)
+{
+    static const char *const wait_names[SCH_WAIT_NB] = {
+        [SCH_WAIT_INPUT]  = "wait for input",
+        [SCH_WAIT_OUTPUT] = "wait for output",
+        [SCH_WAIT_CHOKED] = "choked",
+    };
+    AVIOContext *pb;
+    ThreadQueue *queue;
+    SchTask *task;
+    const char *sep = "";
+    int ret;
+
+    ret = avio_open2(&pb, sch->trace_filename, AVIO_FLAG_WRITE, NULL, NULL);
+    if (ret < 0) {
+        av_log(sch, AV_LOG_ERROR, "Could not open trace file '%s': %s\n",
+               sch->trace_filename, av_err2str(ret));
+        return ret;
+    }
+
+    avio_printf(pb, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (unsigned i = 0; (task = stats_task(sch, i, &queue)); i++) {
+        const SchTaskStats *st = &task->stats;
+        const AVClass *cls = *(const AVClass **)task->func_arg;
+
+        if (!st->start)
+            continue;
+        if (st->events_failed)
+            av_log(task->func_arg, AV_LOG_WARNING,
+                   "Out of memory while tracing, trace is incomplete\n");
+
+        avio_printf(pb, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                    "\"name\":\"thread_name\",\"args\":{\"name\":", sep, i);
+        trace_write_string(pb, cls->item_name(task->func_arg));
+        avio_printf(pb, "}},\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"name\":\"run\","
+                    "\"ts\":%"PRId64",\"dur\":%"PRId64"}",
+                    i, st->start - sch->stats_start, st->end - st->start);
+        for (int j = 0; j < st->nb_events; j++) {
+            const SchTraceEvent *ev = &st->events[j];
+            avio_printf(pb, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"name\":\"%s\","
+                        "\"ts\":%"PRId64",\"dur\":%"PRId64"}",
+                        i, wait_names[ev->type], ev->start - sch->stats_start,
+                        ev->duration);
+        }
+        sep = ",\n";
+    }
+    avio_printf(pb, "\n]}\n");
+    avio_flush(pb);
+
+    ret = pb->error;
+    avio_closep(&pb);
+    if (ret < 0)
+        av_log(sch, AV_LOG_ERROR, "Error writing trace file '%s': %s\n",
+               sch->trace_filename, av_err2str(ret));
+    return ret;
+}
+
+static void stats_report(Scheduler *sch)
+{
+    ThreadQueue *queue;
+    SchTask *task;
+
+    for (unsigned i = 0; (task = stats_task(sch, i, &queue)); i++)
+        if (task->stats.start)
+            stats_print(task, queue);
+
+    if (sch->trace_filename)
+        stats_write_trace(sch);
+
+    for (unsigned i = 0; (task = stats_task(sch, i, &queue)); i++)
+        av_freep(&task->stats.events);
+}
+
 int sch_stop(Scheduler *sch, int64_t *finish_ts)
 {
     int ret = 0, err;
@@ -2625,6 +2954,9 @@ int sch_stop(Scheduler *sch, int64_t *finish_ts)
     if (finish_ts)
         *finish_ts = trailing_dts(sch, 1);
 
+    if (sch->stats)
+        stats_report(sch);
+
     sch->state = SCH_STATE_STOPPED;
 
     return ret;
@@ -298,6 +298,17 @@ int sch_mux_stream_ready(Scheduler *sch, unsigned mux_idx, unsigned stream_idx);
  */
 int sch_sdp_filename(Scheduler *sch, const char *sdp_filename);
 
+/**
+ * Measure how long each task spends working, waiting for input, waiting for
+ * downstream queues to accept its output and paused by the scheduler, and how
+ * full each queue is, and print this when transcoding stops. Must be called
+ * before sch_start().
+ *
+ * @param trace_filename if not NULL, every wait of every task is also written
+ *                       to this file in the Chrome trace event format
+ */
+int sch_stats(Scheduler *sch, const char *trace_filename);
+
 /**
  * Add an encoder to the scheduler.
  *
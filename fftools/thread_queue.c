@@ -16,6 +16,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -37,6 +38,11 @@ enum {
     FINISHED_RECV = (1 << 1),
 };
 
+enum {
+    WAITING_SEND = (1 << 0),
+    WAITING_RECV = (1 << 1),
+};
+
 struct ThreadQueue {
     int              *finished;
     unsigned int    nb_streams;
@@ -48,6 +54,24 @@ struct ThreadQueue {
 
     pthread_mutex_t lock;
     pthread_cond_t  cond;
+
+    /* single producer/consumer queues, see tq_alloc_spsc();
+     * only the lock and cond above are shared with the general case */
+    int             spsc;
+    void          **ring;
+    size_t          ring_size;
+    // counts of items read/written, each only modified by its own side
+    atomic_size_t   head;
+    atomic_size_t   tail;
+    // FINISHED_* for the single stream
+    atomic_int      state;
+    // WAITING_* for the side(s) parked on cond
+    atomic_int      waiting;
+
+    // number of sends after which the queue held a given number of items,
+    // queue_size + 1 entries
+    uint64_t       *occupancy;
+    size_t          queue_size;
 };
 
 void tq_free(ThreadQueue **ptq)
@@ -60,6 +84,16 @@ void tq_free(ThreadQueue **ptq)
     av_container_fifo_free(&tq->fifo);
     av_fifo_freep2(&tq->fifo_stream_index);
 
+    for (size_t i = 0; tq->ring && i < tq->ring_size; i++) {
+        if (tq->type == THREAD_QUEUE_FRAMES)
+            av_frame_free((AVFrame **)&tq->ring[i]);
+        else
+            av_packet_free((AVPacket **)&tq->ring[i]);
+    }
+    av_freep(&tq->ring);
+
+    av_freep(&tq->occupancy);
+
     av_freep(&tq->finished);
 
     pthread_cond_destroy(&tq->cond);
@@ -68,8 +102,7 @@ void tq_free(ThreadQueue **ptq)
     av_freep(ptq);
 }
 
-ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
-                      enum ThreadQueueType type)
+static ThreadQueue *queue_alloc(size_t queue_size, enum ThreadQueueType type)
 {
     ThreadQueue *tq;
     int ret;
@@ -91,13 +124,32 @@ ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
         return NULL;
     }
 
+    tq->type = type;
+
+    tq->occupancy = av_calloc(queue_size + 1, sizeof(*tq->occupancy));
+    if (!tq->occupancy) {
+        tq_free(&tq);
+        return NULL;
+    }
+    tq->queue_size = queue_size;
+
+    return tq;
+}
+
+ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
+                      enum ThreadQueueType type)
+{
+    ThreadQueue *tq;
+
+    tq = queue_alloc(queue_size, type);
+    if (!tq)
+        return NULL;
+
     tq->finished = av_calloc(nb_streams, sizeof(*tq->finished));
     if (!tq->finished)
         goto fail;
     tq->nb_streams = nb_streams;
 
-    tq->type = type;
-
     tq->fifo = (type == THREAD_QUEUE_FRAMES) ?
                av_container_fifo_alloc_avframe(0) : av_container_fifo_alloc_avpacket(0);
     if (!tq->fifo)
@@ -113,12 +165,167 @@ fail:
     return NULL;
 }
 
+ThreadQueue *tq_alloc_spsc(size_t queue_size, enum ThreadQueueType type)
+{
+    ThreadQueue *tq;
+
+    tq = queue_alloc(queue_size, type);
+    if (!tq)
+        return NULL;
+
+    tq->spsc       = 1;
+    tq->nb_streams = 1;
+
+    tq->ring = av_calloc(queue_size, sizeof(*tq->ring));
+    if (!tq->ring)
+        goto fail;
+    tq->ring_size = queue_size;
+
+    for (size_t i = 0; i < queue_size; i++) {
+        tq->ring[i] = (type == THREAD_QUEUE_FRAMES) ?
+                      (void*)av_frame_alloc() : (void*)av_packet_alloc();
+        if (!tq->ring[i])
+            goto fail;
+    }
+
+    atomic_init(&tq->head,    0);
+    atomic_init(&tq->tail,    0);
+    atomic_init(&tq->state,   0);
+    atomic_init(&tq->waiting, 0);
+
+    return tq;
+fail:
+    tq_free(&tq);
+    return NULL;
+}
+
+static void move_item(const ThreadQueue *tq, void *dst, void *src)
+{
+    if (tq->type == THREAD_QUEUE_FRAMES)
+        av_frame_move_ref(dst, src);
+    else
+        av_packet_move_ref(dst, src);
+}
+
+/* A producer that found the queue full sleeps until half of it is free
+ * again, instead of switching with the consumer on every item. */
+static size_t spsc_wake_level(const ThreadQueue *tq)
+{
+    return tq->ring_size - (tq->ring_size + 1) / 2;
+}
+
+static int spsc_send_blocked(ThreadQueue *tq)
+{
+    return !(atomic_load(&tq->state) & FINISHED_RECV) &&
+           atomic_load(&tq->tail) - atomic_load(&tq->head) > spsc_wake_level(tq);
+}
+
+static int spsc_receive_blocked(ThreadQueue *tq)
+{
+    return !atomic_load(&tq->state) &&
+           atomic_load(&tq->tail) == atomic_load(&tq->head);
+}
+
+/*
+ * Sleep until the queue is no longer full or empty, respectively. The
+ * sleeper raises its flag before checking the queue once more, and the other
+ * side checks the flag after each change it makes to the queue. With both
+ * in sequentially consistent order, either the sleeper sees the change or
+ * the other side sees the flag and wakes it, see spsc_wake().
+ */
+static void spsc_park(ThreadQueue *tq, int side, int (*blocked)(ThreadQueue *tq))
+{
+    pthread_mutex_lock(&tq->lock);
+
+    atomic_fetch_or(&tq->waiting, side);
+    while (blocked(tq))
+        pthread_cond_wait(&tq->cond, &tq->lock);
+    atomic_fetch_and(&tq->waiting, ~side);
+
+    pthread_mutex_unlock(&tq->lock);
+}
+
+/* Taking the lock makes sure that a sleeper which raised its flag has got
+ * to the wait. The signal is only sent after dropping the lock, so that the
+ * woken thread does not immediately block on it again. */
+static void spsc_wake(ThreadQueue *tq, int side)
+{
+    if (!(atomic_load(&tq->waiting) & side))
+        return;
+
+    pthread_mutex_lock(&tq->lock);
+    pthread_mutex_unlock(&tq->lock);
+    pthread_cond_broadcast(&tq->cond);
+}
+
+static int spsc_send(ThreadQueue *tq, void *data)
+{
+    size_t tail = atomic_load_explicit(&tq->tail, memory_order_relaxed);
+
+    if (atomic_load(&tq->state) & FINISHED_SEND)
+        return AVERROR(EINVAL);
+
+    while (1) {
+        if (atomic_load(&tq->state) & FINISHED_RECV) {
+            atomic_fetch_or(&tq->state, FINISHED_SEND);
+            return AVERROR_EOF;
+        }
+        if (tail - atomic_load(&tq->head) < tq->ring_size)
+            break;
+        spsc_park(tq, WAITING_SEND, spsc_send_blocked);
+    }
+
+    move_item(tq, tq->ring[tail % tq->ring_size], data);
+    atomic_store(&tq->tail, tail + 1);
+
+    tq->occupancy[tail + 1 - atomic_load(&tq->head)]++;
+
+    spsc_wake(tq, WAITING_RECV);
+
+    return 0;
+}
+
+static int spsc_receive(ThreadQueue *tq, int *stream_idx, void *data)
+{
+    size_t head = atomic_load_explicit(&tq->head, memory_order_relaxed);
+
+    while (1) {
+        int state = atomic_load(&tq->state);
+
+        if (state & FINISHED_RECV)
+            return AVERROR_EOF;
+        // the producer marks itself finished after writing its last item,
+        // so the tail read after the state includes that item
+        if (head != atomic_load(&tq->tail))
+            break;
+        if (state & FINISHED_SEND) {
+            /* return EOF to the consumer once for the stream */
+            atomic_fetch_or(&tq->state, FINISHED_RECV);
+            *stream_idx = 0;
+            return AVERROR_EOF;
+        }
+        spsc_park(tq, WAITING_RECV, spsc_receive_blocked);
+    }
+
+    move_item(tq, data, tq->ring[head % tq->ring_size]);
+    atomic_store(&tq->head, head + 1);
+
+    if (atomic_load(&tq->tail) - (head + 1) <= spsc_wake_level(tq))
+        spsc_wake(tq, WAITING_SEND);
+
+    *stream_idx = 0;
+    return 0;
+}
+
 int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
 {
     int *finished;
     int ret;
 
     av_assert0(stream_idx < tq->nb_streams);
+
+    if (tq->spsc)
+        return spsc_send(tq, data);
     finished = &tq->finished[stream_idx];
 
     pthread_mutex_lock(&tq->lock);
@@ -143,6 +350,8 @@ int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
         if (ret < 0)
             goto finish;
 
+        tq->occupancy[av_fifo_can_read(tq->fifo_stream_index)]++;
+
         pthread_cond_broadcast(&tq->cond);
     }
 
@@ -196,6 +405,9 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
 
     *stream_idx = -1;
 
+    if (tq->spsc)
+        return spsc_receive(tq, stream_idx, data);
+
     pthread_mutex_lock(&tq->lock);
 
     while (1) {
@@ -224,6 +436,12 @@ void tq_send_finish(ThreadQueue *tq, unsigned int stream_idx)
 {
     av_assert0(stream_idx < tq->nb_streams);
 
+    if (tq->spsc) {
+        atomic_fetch_or(&tq->state, FINISHED_SEND);
+        spsc_wake(tq, WAITING_RECV);
+        return;
+    }
+
     pthread_mutex_lock(&tq->lock);
 
     /* mark the stream as send-finished;
@@ -239,6 +457,12 @@ void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx)
 {
     av_assert0(stream_idx < tq->nb_streams);
 
+    if (tq->spsc) {
+        atomic_fetch_or(&tq->state, FINISHED_RECV);
+        spsc_wake(tq, WAITING_SEND);
+        return;
+    }
+
     pthread_mutex_lock(&tq->lock);
 
     /* mark the stream as recv-finished;
@@ -249,3 +473,9 @@ void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx)
 
     pthread_mutex_unlock(&tq->lock);
 }
+
+size_t tq_occupancy(const ThreadQueue *tq, const uint64_t **hist)
+{
+    *hist = tq->occupancy;
+    return tq->queue_size + 1;
+}
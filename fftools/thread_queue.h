@@ -19,6 +19,7 @@
 #ifndef FFTOOLS_THREAD_QUEUE_H
 #define FFTOOLS_THREAD_QUEUE_H
 
+#include <stdint.h>
 #include <string.h>
 
 enum ThreadQueueType {
@@ -38,6 +39,13 @@ typedef struct ThreadQueue ThreadQueue;
  */
 ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
                       enum ThreadQueueType type);
+/**
+ * Allocate a queue for a single stream, to which items are sent from one
+ * thread at a time and from which they are received by one thread at a time.
+ * Items are then passed through a lock-free ring and the two sides only
+ * synchronize when it is empty or full.
+ */
+ThreadQueue *tq_alloc_spsc(size_t queue_size, enum ThreadQueueType type);
 void         tq_free(ThreadQueue **tq);
 
 /**
@@ -78,4 +86,14 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data);
  */
 void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx);
 
+/**
+ * Get how full the queue was each time an item was sent to it, i.e. for each
+ * possible number of queued items, how many times the queue held exactly that
+ * many items right after a send. Must not be called while items are sent.
+ *
+ * @param hist the array of counters, owned by the queue, will be written here
+ * @return the number of counters, i.e. the queue size plus one
+ */
+size_t tq_occupancy(const ThreadQueue *tq, const uint64_t **hist);
+
 #endif // FFTOOLS_THREAD_QUEUE_H
@@ -90,6 +90,7 @@ extern const FFCodec ff_cpia_decoder;
 extern const FFCodec ff_cri_decoder;
 extern const FFCodec ff_cscd_decoder;
 extern const FFCodec ff_cyuv_decoder;
+extern const FFCodec ff_dds_encoder;
 extern const FFCodec ff_dds_decoder;
 extern const FFCodec ff_dfa_decoder;
 extern const FFCodec ff_dirac_decoder;
@@ -1923,6 +1923,15 @@ typedef struct AVCodecContext {
      */
     AVFrameSideData  **decoded_side_data;
     int             nb_decoded_side_data;
+
+    /**
+     * Allocation flags for the buffer pools of avcodec_default_get_buffer2(),
+     * a combination of AV_BUFFER_POOL_FLAG_*. See av_buffer_pool_init_flags().
+     *
+     * - encoding: unused
+     * - decoding: Set by user before avcodec_open2().
+     */
+    int buffer_pool_flags;
 } AVCodecContext;
 
 /**
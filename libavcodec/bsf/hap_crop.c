@@ -0,0 +1,280 @@
+/*
+ * Hap crop bitstream filter
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Hap crop bitstream filter
+ * crop Hap frames on texture block boundaries, without decoding them
+ */
+
+#include <string.h>
+
+#include "config.h"
+
+#include "bsf.h"
+#include "bsf_internal.h"
+#include "bytestream.h"
+#include "hap.h"
+
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+
+typedef struct HapCropContext {
+    const AVClass *class;
+    int x, y, w, h;
+    int compressor;
+    int chunks;
+
+    HapContext hap_in;
+    HapContext hap_out;
+
+    int in_blocks_w;                /* input width in blocks */
+    int out_blocks_w, out_blocks_h; /* output size in blocks */
+
+    uint8_t *tex[2];                /* cropped textures */
+    unsigned int tex_alloc[2];
+} HapCropContext;
+
+static int hap_crop_init(AVBSFContext *bsf)
+{
+    HapCropContext *s = bsf->priv_data;
+    int width  = bsf->par_in->width;
+    int height = bsf->par_in->height;
+
+    if (width <= 0 || height <= 0) {
+        av_log(bsf, AV_LOG_ERROR, "Invalid input dimensions %dx%d.\n", width, height);
+        return AVERROR(EINVAL);
+    }
+
+#if !CONFIG_LIBSNAPPY
+    if (s->compressor == HAP_COMP_SNAPPY) {
+        av_log(bsf, AV_LOG_ERROR, "Snappy compression requires libsnappy.\n");
+        return AVERROR(ENOSYS);
+    }
+#endif
+
+    if (!s->w)
+        s->w = width - s->x;
+    if (!s->h)
+        s->h = height - s->y;
+
+    if (s->x % TEXTURE_BLOCK_W || s->y % TEXTURE_BLOCK_H) {
+        av_log(bsf, AV_LOG_ERROR, "Crop position %dx%d is not on a block boundary.\n",
+               s->x, s->y);
+        return AVERROR(EINVAL);
+    }
+    if (s->w <= 0 || s->h <= 0 || s->x + s->w > width || s->y + s->h > height) {
+        av_log(bsf, AV_LOG_ERROR, "Crop area %dx%d+%d+%d is outside of the %dx%d frame.\n",
+               s->w, s->h, s->x, s->y, width, height);
+        return AVERROR(EINVAL);
+    }
+    /* Only the right and bottom edges may end inside a block */
+    if ((s->w % TEXTURE_BLOCK_W && s->x + s->w != width) ||
+        (s->h % TEXTURE_BLOCK_H && s->y + s->h != height)) {
+        av_log(bsf, AV_LOG_ERROR, "Crop size %dx%d is not a multiple of the block size.\n",
+               s->w, s->h);
+        return AVERROR(EINVAL);
+    }
+
+    s->in_blocks_w  = AV_CEIL_RSHIFT(width, 2);
+    s->out_blocks_w = AV_CEIL_RSHIFT(s->w, 2);
+    s->out_blocks_h = AV_CEIL_RSHIFT(s->h, 2);
+
+    bsf->par_out->width  = s->w;
+    bsf->par_out->height = s->h;
+
+    return 0;
+}
+
+static int crop_texture(AVBSFContext *bsf, int t, enum HapTextureFormat tex_fmt,
+                        const uint8_t *tex, size_t tex_size)
+{
+    HapCropContext *s = bsf->priv_data;
+    int tex_ratio = ff_hap_texture_ratio(tex_fmt);
+    int in_blocks_h = AV_CEIL_RSHIFT(bsf->par_in->height, 2);
+    size_t row_size = (size_t)s->out_blocks_w * tex_ratio;
+    const uint8_t *src;
+    uint8_t *dst;
+
+    if (tex_size != (size_t)s->in_blocks_w * in_blocks_h * tex_ratio) {
+        av_log(bsf, AV_LOG_ERROR, "uncompressed size mismatches\n");
+        return AVERROR_INVALIDDATA;
+    }
+
+    av_fast_malloc(&s->tex[t], &s->tex_alloc[t], row_size * s->out_blocks_h);
+    if (!s->tex[t])
+        return AVERROR(ENOMEM);
+
+    src = tex + ((size_t)(s->y / TEXTURE_BLOCK_H) * s->in_blocks_w +
+                 s->x / TEXTURE_BLOCK_W) * tex_ratio;
+    dst = s->tex[t];
+    for (int y = 0; y < s->out_blocks_h; y++) {
+        memcpy(dst, src, row_size);
+        src += (size_t)s->in_blocks_w * tex_ratio;
+        dst += row_size;
+    }
+
+    return 0;
+}
+
+static int hap_crop_filter(AVBSFContext *bsf, AVPacket *out)
+{
+    HapCropContext *s = bsf->priv_data;
+    enum HapTextureFormat tex_fmt[2];
+    enum HapCompressor compressor[2];
+    int chunk_count[2];
+    size_t tex_size[2];
+    int blocks = s->out_blocks_w * s->out_blocks_h;
+    size_t max_size = 0;
+    GetByteContext gbc;
+    PutByteContext pbc;
+    AVPacket *in;
+    int section_size, texture_count = 1, offset = 0, top_header_len = 0;
+    enum HapSectionType section_type;
+    int ret;
+
+    ret = ff_bsf_get_packet(bsf, &in);
+    if (ret < 0)
+        return ret;
+
+    /* check for multi texture header */
+    bytestream2_init(&gbc, in->data, in->size);
+    ret = ff_hap_parse_section_header(&gbc, &section_size, &section_type);
+    if (ret < 0)
+        goto fail;
+    if ((section_type & 0x0F) == HAP_FMT_HAPM)
+        texture_count = 2;
+    else
+        bytestream2_seek(&gbc, 0, SEEK_SET);
+
+    for (int t = 0; t < texture_count; t++) {
+        const uint8_t *tex;
+        int had_snappy = 0;
+
+        ret = ff_hap_unpack_texture(&s->hap_in, bsf, &gbc, &tex_fmt[t], &tex);
+        if (ret < 0)
+            goto fail;
+
+        ret = crop_texture(bsf, t, tex_fmt[t], tex, s->hap_in.tex_size);
+        if (ret < 0)
+            goto fail;
+
+        for (int i = 0; i < s->hap_in.chunk_count; i++)
+            had_snappy |= s->hap_in.chunks[i].compressor == HAP_COMP_SNAPPY;
+
+        if (s->compressor < 0)
+            compressor[t] = had_snappy && CONFIG_LIBSNAPPY ? HAP_COMP_SNAPPY : HAP_COMP_NONE;
+        else
+            compressor[t] = s->compressor;
+        /* No benefit chunking uncompressed data */
+        chunk_count[t] = compressor[t] == HAP_COMP_NONE ? 1 :
+                         ff_hap_chunk_count(s->chunks ? s->chunks : s->hap_in.chunk_count,
+                                            blocks);
+        tex_size[t] = (size_t)blocks * ff_hap_texture_ratio(tex_fmt[t]);
+        max_size += ff_hap_max_texture_section_size(chunk_count[t], compressor[t],
+                                                    tex_size[t]);
+    }
+
+    if (texture_count == 2) {
+        top_header_len = ff_hap_section_header_length(max_size);
+        max_size += top_header_len;
+    }
+    if (max_size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE) {
+        ret = AVERROR(ERANGE);
+        goto fail;
+    }
+
+    ret = av_new_packet(out, max_size);
+    if (ret < 0)
+        goto fail;
+
+    offset = top_header_len;
+    for (int t = 0; t < texture_count; t++) {
+        ret = ff_hap_set_chunk_count(&s->hap_out, chunk_count[t], 1);
+        if (ret < 0)
+            goto fail;
+        ret = ff_hap_pack_texture(&s->hap_out, bsf, out->data + offset, tex_fmt[t],
+                                  compressor[t], s->tex[t], tex_size[t]);
+        if (ret < 0)
+            goto fail;
+        offset += ret;
+    }
+
+    if (texture_count == 2) {
+        bytestream2_init_writer(&pbc, out->data, offset);
+        ff_hap_write_section_header(&pbc, top_header_len, offset - top_header_len,
+                                    HAP_FMT_HAPM);
+    }
+    av_shrink_packet(out, offset);
+
+    ret = av_packet_copy_props(out, in);
+
+fail:
+    if (ret < 0)
+        av_packet_unref(out);
+    av_packet_free(&in);
+    return ret;
+}
+
+static void hap_crop_close(AVBSFContext *bsf)
+{
+    HapCropContext *s = bsf->priv_data;
+
+    ff_hap_free_context(&s->hap_in);
+    ff_hap_free_context(&s->hap_out);
+    av_freep(&s->tex[0]);
+    av_freep(&s->tex[1]);
+}
+
+static const enum AVCodecID codec_ids[] = {
+    AV_CODEC_ID_HAP, AV_CODEC_ID_NONE,
+};
+
+#define OFFSET(x) offsetof(HapCropContext, x)
+#define FLAGS (AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_BSF_PARAM)
+static const AVOption options[] = {
+    { "x", "left edge of the crop area, a multiple of 4", OFFSET(x), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, FLAGS },
+    { "y", "top edge of the crop area, a multiple of 4",  OFFSET(y), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, FLAGS },
+    { "w", "width of the crop area (0 to the right edge)",   OFFSET(w), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, FLAGS },
+    { "h", "height of the crop area (0 to the bottom edge)", OFFSET(h), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, FLAGS },
+    { "compressor", "second-stage compressor", OFFSET(compressor), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, HAP_COMP_SNAPPY, FLAGS, .unit = "compressor" },
+        { "auto",   "same as the input",   0, AV_OPT_TYPE_CONST, { .i64 = -1              }, 0, 0, FLAGS, .unit = "compressor" },
+        { "none",   "None",                0, AV_OPT_TYPE_CONST, { .i64 = HAP_COMP_NONE   }, 0, 0, FLAGS, .unit = "compressor" },
+        { "snappy", "Snappy",              0, AV_OPT_TYPE_CONST, { .i64 = HAP_COMP_SNAPPY }, 0, 0, FLAGS, .unit = "compressor" },
+    { "chunks", "chunk count (0 for the input one)", OFFSET(chunks), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, HAP_MAX_CHUNKS, FLAGS },
+    { NULL },
+};
+
+static const AVClass hap_crop_class = {
+    .class_name = "hap_crop_bsf",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+const FFBitStreamFilter ff_hap_crop_bsf = {
+    .p.name         = "hap_crop",
+    .p.codec_ids    = codec_ids,
+    .p.priv_class   = &hap_crop_class,
+    .priv_data_size = sizeof(HapCropContext),
+    .init           = hap_crop_init,
+    .filter         = hap_crop_filter,
+    .close          = hap_crop_close,
+};
@@ -0,0 +1,346 @@
+/*
+ * Hap rechunk bitstream filter
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Hap rechunk bitstream filter
+ * change the chunk count and second-stage compressor of Hap frames,
+ * keeping the textures as they are
+ */
+
+#include <string.h>
+
+#include "config.h"
+
+#include "bsf.h"
+#include "bsf_internal.h"
+#include "bytestream.h"
+#include "hap.h"
+
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/slicethread.h"
+
+typedef struct RechunkTexture {
+    enum HapTextureFormat format;
+    enum HapCompressor compressor; /* output compressor */
+    int chunk_count;               /* output chunk count */
+    const uint8_t *data;
+    size_t size;
+    uint8_t *buf;                  /* texture unless used in place */
+    unsigned int buf_size;
+} RechunkTexture;
+
+typedef struct HapRechunkContext {
+    const AVClass *class;
+    int chunks;
+    int compressor;
+    int threads;
+
+    AVSliceThread *slicethread;
+
+    HapContext hap_in;
+    HapContext hap_out;
+    RechunkTexture tex[2];
+
+    /* Work of the current texture, split by chunk between the threads */
+    int compress;              /* compressing, decompressing otherwise */
+    const uint8_t *chunk_data; /* chunk data of the input texture section */
+    uint8_t *tex_out;          /* decompressed texture */
+    const uint8_t *tex_in;     /* texture to compress */
+    uint8_t *dst;              /* compressed chunks, max_chunk_size apart */
+    size_t max_chunk_size;
+} HapRechunkContext;
+
+static void rechunk_worker(void *priv, int jobnr, int threadnr,
+                           int nb_jobs, int nb_threads)
+{
+    AVBSFContext *bsf = priv;
+    HapRechunkContext *s = bsf->priv_data;
+
+    if (s->compress) {
+        HapChunk *chunk = &s->hap_out.chunks[jobnr];
+        s->hap_out.chunk_results[jobnr] =
+            ff_hap_compress_chunk(bsf, chunk, s->tex_in + chunk->uncompressed_offset,
+                                  s->dst + jobnr * s->max_chunk_size);
+    } else {
+        s->hap_in.chunk_results[jobnr] =
+            ff_hap_decompress_chunk(&s->hap_in.chunks[jobnr], s->chunk_data, s->tex_out);
+    }
+}
+
+static int run_chunks(AVBSFContext *bsf, HapContext *ctx)
+{
+    HapRechunkContext *s = bsf->priv_data;
+
+    if (s->slicethread) {
+        avpriv_slicethread_execute(s->slicethread, ctx->chunk_count, 0);
+    } else {
+        for (int i = 0; i < ctx->chunk_count; i++)
+            rechunk_worker(bsf, i, 0, ctx->chunk_count, 1);
+    }
+
+    for (int i = 0; i < ctx->chunk_count; i++) {
+        if (ctx->chunk_results[i] < 0)
+            return ctx->chunk_results[i];
+    }
+
+    return 0;
+}
+
+static int unpack_texture(AVBSFContext *bsf, GetByteContext *gbc,
+                          RechunkTexture *tex)
+{
+    HapRechunkContext *s = bsf->priv_data;
+    HapContext *ctx = &s->hap_in;
+    int start = bytestream2_tell(gbc);
+    int header_length = bytestream2_peek_le24(gbc) ? HAP_HDR_SHORT : HAP_HDR_LONG;
+    int had_snappy = 0, ret;
+
+    ret = ff_hap_parse_texture_header(ctx, bsf, gbc, &tex->format);
+    if (ret < 0)
+        return ret;
+
+    tex->size = ctx->tex_size;
+    if (ff_hap_can_use_tex_in_place(ctx)) {
+        tex->data = gbc->buffer;
+    } else {
+        av_fast_malloc(&tex->buf, &tex->buf_size, tex->size);
+        if (!tex->buf)
+            return AVERROR(ENOMEM);
+
+        s->compress   = 0;
+        s->chunk_data = gbc->buffer;
+        s->tex_out    = tex->buf;
+        ret = run_chunks(bsf, ctx);
+        if (ret < 0) {
+            av_log(bsf, AV_LOG_ERROR, "Snappy uncompress error\n");
+            return ret;
+        }
+        tex->data = tex->buf;
+    }
+
+    for (int i = 0; i < ctx->chunk_count; i++)
+        had_snappy |= ctx->chunks[i].compressor == HAP_COMP_SNAPPY;
+
+    if (s->compressor < 0)
+        tex->compressor = had_snappy && CONFIG_LIBSNAPPY ? HAP_COMP_SNAPPY : HAP_COMP_NONE;
+    else
+        tex->compressor = s->compressor;
+    /* No benefit chunking uncompressed data */
+    tex->chunk_count = tex->compressor == HAP_COMP_NONE ? 1 :
+                       ff_hap_chunk_count(s->chunks ? s->chunks : ctx->chunk_count,
+                                          tex->size / ff_hap_texture_ratio(tex->format));
+
+    bytestream2_seek(gbc, start + header_length + ctx->texture_section_size, SEEK_SET);
+
+    return 0;
+}
+
+static int pack_texture(AVBSFContext *bsf, uint8_t *dst, const RechunkTexture *tex)
+{
+    HapRechunkContext *s = bsf->priv_data;
+    HapContext *ctx = &s->hap_out;
+    size_t chunk_size = tex->size / tex->chunk_count;
+    size_t max_chunk_size = ff_hap_max_chunk_size(tex->compressor, chunk_size);
+    size_t section_length = ff_hap_texture_section_length(tex->chunk_count,
+                                                          max_chunk_size * tex->chunk_count);
+    enum HapHeaderLength header_length = ff_hap_section_header_length(section_length);
+    int tex_header_len = ff_hap_texture_section_header_length(tex->chunk_count, header_length);
+    size_t final_size = 0;
+    int ret;
+
+    ret = ff_hap_set_chunk_count(ctx, tex->chunk_count, 1);
+    if (ret < 0)
+        return ret;
+
+    for (int i = 0; i < ctx->chunk_count; i++) {
+        HapChunk *chunk = &ctx->chunks[i];
+        chunk->uncompressed_size   = chunk_size;
+        chunk->uncompressed_offset = i * chunk_size;
+        chunk->compressed_size     = max_chunk_size;
+    }
+
+    if (tex->compressor == HAP_COMP_SNAPPY) {
+        s->compress       = 1;
+        s->tex_in         = tex->data;
+        s->dst            = dst + tex_header_len;
+        s->max_chunk_size = max_chunk_size;
+        ret = run_chunks(bsf, ctx);
+        if (ret < 0)
+            return ret;
+
+        /* Close the gaps left between the chunks compressed in parallel */
+        for (int i = 0; i < ctx->chunk_count; i++) {
+            HapChunk *chunk = &ctx->chunks[i];
+            chunk->compressed_offset = final_size;
+            memmove(s->dst + final_size, s->dst + i * max_chunk_size,
+                    chunk->compressed_size);
+            final_size += chunk->compressed_size;
+        }
+    } else {
+        memcpy(dst + tex_header_len, tex->data, tex->size);
+        ctx->chunks[0].compressor        = HAP_COMP_NONE;
+        ctx->chunks[0].compressed_offset = 0;
+        final_size = tex->size;
+    }
+
+    ff_hap_write_texture_header(ctx, dst, tex->format, ctx->chunk_count,
+                                final_size + tex_header_len, header_length);
+
+    return final_size + tex_header_len;
+}
+
+static int hap_rechunk_init(AVBSFContext *bsf)
+{
+    HapRechunkContext *s = bsf->priv_data;
+    int ret;
+
+#if !CONFIG_LIBSNAPPY
+    if (s->compressor == HAP_COMP_SNAPPY) {
+        av_log(bsf, AV_LOG_ERROR, "Snappy compression requires libsnappy.\n");
+        return AVERROR(ENOSYS);
+    }
+#endif
+
+    ret = avpriv_slicethread_create(&s->slicethread, bsf, rechunk_worker,
+                                    NULL, s->threads);
+    if (ret < 0 && ret != AVERROR(ENOSYS))
+        return ret;
+
+    return 0;
+}
+
+static int hap_rechunk_filter(AVBSFContext *bsf, AVPacket *out)
+{
+    HapRechunkContext *s = bsf->priv_data;
+    size_t max_size = 0;
+    GetByteContext gbc;
+    PutByteContext pbc;
+    AVPacket *in;
+    int section_size, texture_count = 1, offset, top_header_len = 0;
+    enum HapSectionType section_type;
+    int ret;
+
+    ret = ff_bsf_get_packet(bsf, &in);
+    if (ret < 0)
+        return ret;
+
+    /* check for multi texture header */
+    bytestream2_init(&gbc, in->data, in->size);
+    ret = ff_hap_parse_section_header(&gbc, &section_size, &section_type);
+    if (ret < 0)
+        goto fail;
+    if ((section_type & 0x0F) == HAP_FMT_HAPM)
+        texture_count = 2;
+    else
+        bytestream2_seek(&gbc, 0, SEEK_SET);
+
+    for (int t = 0; t < texture_count; t++) {
+        RechunkTexture *tex = &s->tex[t];
+
+        ret = unpack_texture(bsf, &gbc, tex);
+        if (ret < 0)
+            goto fail;
+
+        max_size += ff_hap_max_texture_section_size(tex->chunk_count, tex->compressor,
+                                                    tex->size);
+    }
+
+    if (texture_count == 2) {
+        top_header_len = ff_hap_section_header_length(max_size);
+        max_size += top_header_len;
+    }
+    if (max_size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE) {
+        ret = AVERROR(ERANGE);
+        goto fail;
+    }
+
+    ret = av_new_packet(out, max_size);
+    if (ret < 0)
+        goto fail;
+
+    offset = top_header_len;
+    for (int t = 0; t < texture_count; t++) {
+        ret = pack_texture(bsf, out->data + offset, &s->tex[t]);
+        if (ret < 0)
+            goto fail;
+        offset += ret;
+    }
+
+    if (texture_count == 2) {
+        bytestream2_init_writer(&pbc, out->data, offset);
+        ff_hap_write_section_header(&pbc, top_header_len, offset - top_header_len,
+                                    HAP_FMT_HAPM);
+    }
+    av_shrink_packet(out, offset);
+
+    ret = av_packet_copy_props(out, in);
+
+fail:
+    if (ret < 0)
+        av_packet_unref(out);
+    av_packet_free(&in);
+    return ret;
+}
+
+static void hap_rechunk_close(AVBSFContext *bsf)
+{
+    HapRechunkContext *s = bsf->priv_data;
+
+    avpriv_slicethread_free(&s->slicethread);
+    ff_hap_free_context(&s->hap_in);
+    ff_hap_free_context(&s->hap_out);
+    av_freep(&s->tex[0].buf);
+    av_freep(&s->tex[1].buf);
+}
+
+static const enum AVCodecID codec_ids[] = {
+    AV_CODEC_ID_HAP, AV_CODEC_ID_NONE,
+};
+
+#define OFFSET(x) offsetof(HapRechunkContext, x)
+#define FLAGS (AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_BSF_PARAM)
+static const AVOption options[] = {
+    { "chunks", "chunk count (0 for the input one)", OFFSET(chunks), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, HAP_MAX_CHUNKS, FLAGS },
+    { "compressor", "second-stage compressor", OFFSET(compressor), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, HAP_COMP_SNAPPY, FLAGS, .unit = "compressor" },
+        { "auto",   "same as the input",   0, AV_OPT_TYPE_CONST, { .i64 = -1              }, 0, 0, FLAGS, .unit = "compressor" },
+        { "none",   "None",                0, AV_OPT_TYPE_CONST, { .i64 = HAP_COMP_NONE   }, 0, 0, FLAGS, .unit = "compressor" },
+        { "snappy", "Snappy",              0, AV_OPT_TYPE_CONST, { .i64 = HAP_COMP_SNAPPY }, 0, 0, FLAGS, .unit = "compressor" },
+    { "threads", "number of threads (0 for automatic)", OFFSET(threads), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, FLAGS },
+    { NULL },
+};
+
+static const AVClass hap_rechunk_class = {
+    .class_name = "hap_rechunk_bsf",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+const FFBitStreamFilter ff_hap_rechunk_bsf = {
+    .p.name         = "hap_rechunk",
+    .p.codec_ids    = codec_ids,
+    .p.priv_class   = &hap_rechunk_class,
+    .priv_data_size = sizeof(HapRechunkContext),
+    .init           = hap_rechunk_init,
+    .filter         = hap_rechunk_filter,
+    .close          = hap_rechunk_close,
+};
@@ -32,15 +32,13 @@
 #include "libavutil/imgutils.h"
 
 #include "avcodec.h"
+#include "bc7dec.h"
 #include "bytestream.h"
 #include "codec_internal.h"
+#include "dds.h"
 #include "decode.h"
 #include "texturedsp.h"
 
-#define DDPF_FOURCC    (1 <<  2)
-#define DDPF_PALETTE   (1 <<  5)
-#define DDPF_NORMALMAP (1U << 31)
-
 enum DDSPostProc {
     DDS_NONE = 0,
     DDS_ALPHA_EXP,
@@ -57,45 +55,6 @@ enum DDSPostProc {
     DDS_SWIZZLE_XGXR,
 };
 
-enum DDSDXGIFormat {
-    DXGI_FORMAT_R16G16B16A16_TYPELESS       =  9,
-    DXGI_FORMAT_R16G16B16A16_FLOAT          = 10,
-    DXGI_FORMAT_R16G16B16A16_UNORM          = 11,
-    DXGI_FORMAT_R16G16B16A16_UINT           = 12,
-    DXGI_FORMAT_R16G16B16A16_SNORM          = 13,
-    DXGI_FORMAT_R16G16B16A16_SINT           = 14,
-
-    DXGI_FORMAT_R8G8B8A8_TYPELESS           = 27,
-    DXGI_FORMAT_R8G8B8A8_UNORM              = 28,
-    DXGI_FORMAT_R8G8B8A8_UNORM_SRGB         = 29,
-    DXGI_FORMAT_R8G8B8A8_UINT               = 30,
-    DXGI_FORMAT_R8G8B8A8_SNORM              = 31,
-    DXGI_FORMAT_R8G8B8A8_SINT               = 32,
-
-    DXGI_FORMAT_BC1_TYPELESS                = 70,
-    DXGI_FORMAT_BC1_UNORM                   = 71,
-    DXGI_FORMAT_BC1_UNORM_SRGB              = 72,
-    DXGI_FORMAT_BC2_TYPELESS                = 73,
-    DXGI_FORMAT_BC2_UNORM                   = 74,
-    DXGI_FORMAT_BC2_UNORM_SRGB              = 75,
-    DXGI_FORMAT_BC3_TYPELESS                = 76,
-    DXGI_FORMAT_BC3_UNORM                   = 77,
-    DXGI_FORMAT_BC3_UNORM_SRGB              = 78,
-    DXGI_FORMAT_BC4_TYPELESS                = 79,
-    DXGI_FORMAT_BC4_UNORM                   = 80,
-    DXGI_FORMAT_BC4_SNORM                   = 81,
-    DXGI_FORMAT_BC5_TYPELESS                = 82,
-    DXGI_FORMAT_BC5_UNORM                   = 83,
-    DXGI_FORMAT_BC5_SNORM                   = 84,
-    DXGI_FORMAT_B5G6R5_UNORM                = 85,
-    DXGI_FORMAT_B8G8R8A8_UNORM              = 87,
-    DXGI_FORMAT_B8G8R8X8_UNORM              = 88,
-    DXGI_FORMAT_B8G8R8A8_TYPELESS           = 90,
-    DXGI_FORMAT_B8G8R8A8_UNORM_SRGB         = 91,
-    DXGI_FORMAT_B8G8R8X8_TYPELESS           = 92,
-    DXGI_FORMAT_B8G8R8X8_UNORM_SRGB         = 93,
-};
-
 typedef struct DDSContext {
     TextureDSPContext texdsp;
     GetByteContext gbc;
@@ -251,8 +210,9 @@ static int parse_pixel_format(AVCodecContext *avctx)
                 av_log(avctx, AV_LOG_VERBOSE,
                        "Found array of size %d (ignored).\n", array);
 
-            /* Only BC[1-5] are actually compressed. */
-            ctx->compressed = (dxgi >= 70) && (dxgi <= 84);
+            /* Only BC[1-5] and BC7 are actually compressed. */
+            ctx->compressed = ((dxgi >= 70) && (dxgi <= 84)) ||
+                              ((dxgi >= 97) && (dxgi <= 99));
 
             av_log(avctx, AV_LOG_VERBOSE, "DXGI format %d.\n", dxgi);
             switch (dxgi) {
@@ -329,6 +289,13 @@ static int parse_pixel_format(AVCodecContext *avctx)
                 ctx->dec.tex_ratio = 16;
                 ctx->dec.tex_funct = ctx->texdsp.rgtc2s_block;
                 break;
+            case DXGI_FORMAT_BC7_UNORM_SRGB:
+                avctx->colorspace = AVCOL_SPC_RGB;
+            case DXGI_FORMAT_BC7_TYPELESS:
+            case DXGI_FORMAT_BC7_UNORM:
+                ctx->dec.tex_ratio = 16;
+                ctx->dec.tex_funct = ff_bc7dec_block;
+                break;
             default:
                 av_log(avctx, AV_LOG_ERROR,
                        "Unsupported DXGI format %d.\n", dxgi);
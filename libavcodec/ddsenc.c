@@ -0,0 +1,375 @@
+/*
+ * DirectDraw Surface image encoder
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * DDS encoder
+ *
+ * Writes BC1 (DXT1), BC3 (DXT5), BC4 (RGTC1) and BC7 (BPTC) textures, with
+ * an optional chain of box-filtered mipmaps.
+ *
+ * https://learn.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
+ */
+
+#include <stdint.h>
+
+#include "libavutil/imgutils.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+
+#include "avcodec.h"
+#include "bc7enc.h"
+#include "bytestream.h"
+#include "codec_internal.h"
+#include "dds.h"
+#include "encode.h"
+#include "texturedsp.h"
+
+#define DDS_MAX_MIPMAPS 16
+
+enum DDSEncFormat {
+    DDS_FMT_BC1,
+    DDS_FMT_BC3,
+    DDS_FMT_BC4,
+    DDS_FMT_BC7,
+};
+
+typedef struct DDSMipLevel {
+    uint8_t *buf;           // Padded RGBA copy, NULL if the frame is used as is
+    const uint8_t *data;    // Pixels to compress
+    ptrdiff_t linesize;
+    int width, height;      // Visible size of this level
+    int coded_width;        // Size aligned to TEXTURE_BLOCK_W/H
+    int coded_height;
+} DDSMipLevel;
+
+typedef struct DDSEncContext {
+    AVClass *class;
+
+    int opt_tex_fmt;        // Texture type
+    int opt_mipmaps;        // Requested number of levels, 0 for a full chain
+    int opt_dx10;           // Always write a DX10 extended header
+    int opt_bc7_uber_level; // BC7 encoder quality level
+
+    uint32_t fourcc;
+    enum DDSDXGIFormat dxgi;
+    int use_dx10;
+
+    int mip_count;
+    DDSMipLevel mip[DDS_MAX_MIPMAPS];
+    int cur_level;          // Level being generated by downscale_slice()
+    int mip_slices;
+
+    int64_t tex_size;       // Sum of the compressed size of all levels
+
+    TextureDSPThreadContext enc;
+} DDSEncContext;
+
+static int64_t level_tex_size(const DDSEncContext *ctx, const DDSMipLevel *level)
+{
+    return (int64_t)(level->coded_width  / TEXTURE_BLOCK_W) *
+                    (level->coded_height / TEXTURE_BLOCK_H) * ctx->enc.tex_ratio;
+}
+
+/* Replicate the last column and row into the block alignment padding. */
+static void pad_level(DDSMipLevel *level)
+{
+    uint8_t *buf = level->buf;
+    int x, y;
+
+    for (y = 0; y < level->height; y++) {
+        uint8_t *row = buf + y * level->linesize;
+        for (x = level->width; x < level->coded_width; x++)
+            AV_COPY32(row + x * 4, row + (level->width - 1) * 4);
+    }
+    for (y = level->height; y < level->coded_height; y++)
+        memcpy(buf + y * level->linesize, buf + (level->height - 1) * level->linesize,
+               level->coded_width * 4);
+}
+
+/* Generate one row band of the current mipmap level with a 2x2 box filter. */
+static int downscale_slice(AVCodecContext *avctx, void *arg,
+                           int slice, int thread_nb)
+{
+    DDSEncContext *ctx = arg;
+    const DDSMipLevel *src = &ctx->mip[ctx->cur_level - 1];
+    DDSMipLevel *dst = &ctx->mip[ctx->cur_level];
+    int start = dst->height *  slice      / ctx->mip_slices;
+    int end   = dst->height * (slice + 1) / ctx->mip_slices;
+    int x, y, c;
+
+    for (y = start; y < end; y++) {
+        const uint8_t *s0 = src->data + FFMIN(2 * y,     src->height - 1) * src->linesize;
+        const uint8_t *s1 = src->data + FFMIN(2 * y + 1, src->height - 1) * src->linesize;
+        uint8_t *d = dst->buf + y * dst->linesize;
+
+        for (x = 0; x < dst->width; x++) {
+            int x0 = FFMIN(2 * x,     src->width - 1) * 4;
+            int x1 = FFMIN(2 * x + 1, src->width - 1) * 4;
+            for (c = 0; c < 4; c++)
+                d[x * 4 + c] = (s0[x0 + c] + s0[x1 + c] +
+                                s1[x0 + c] + s1[x1 + c] + 2) >> 2;
+        }
+    }
+
+    return 0;
+}
+
+static void write_header(AVCodecContext *avctx, PutByteContext *pb)
+{
+    DDSEncContext *ctx = avctx->priv_data;
+    uint32_t flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH |
+                     DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+    uint32_t caps = DDSCAPS_TEXTURE;
+    int i;
+
+    if (ctx->mip_count > 1) {
+        flags |= DDSD_MIPMAPCOUNT;
+        caps  |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+    }
+
+    bytestream2_put_le32u(pb, MKTAG('D', 'D', 'S', ' '));
+    bytestream2_put_le32u(pb, DDS_HEADER_SIZE);
+    bytestream2_put_le32u(pb, flags);
+    bytestream2_put_le32u(pb, avctx->height);
+    bytestream2_put_le32u(pb, avctx->width);
+    bytestream2_put_le32u(pb, level_tex_size(ctx, &ctx->mip[0])); // linear size
+    bytestream2_put_le32u(pb, 0); // depth
+    bytestream2_put_le32u(pb, ctx->mip_count > 1 ? ctx->mip_count : 0);
+    for (i = 0; i < 11; i++)
+        bytestream2_put_le32u(pb, 0); // reserved1
+
+    /* DDS_PIXELFORMAT */
+    bytestream2_put_le32u(pb, DDS_PIXELFORMAT_SIZE);
+    bytestream2_put_le32u(pb, DDPF_FOURCC);
+    bytestream2_put_le32u(pb, ctx->use_dx10 ? MKTAG('D', 'X', '1', '0') : ctx->fourcc);
+    for (i = 0; i < 5; i++)
+        bytestream2_put_le32u(pb, 0); // rgbbitcount and masks
+
+    bytestream2_put_le32u(pb, caps);
+    bytestream2_put_le32u(pb, 0); // caps2
+    bytestream2_put_le32u(pb, 0); // caps3
+    bytestream2_put_le32u(pb, 0); // caps4
+    bytestream2_put_le32u(pb, 0); // reserved2
+
+    if (ctx->use_dx10) {
+        bytestream2_put_le32u(pb, ctx->dxgi);
+        bytestream2_put_le32u(pb, DDS_DIMENSION_TEXTURE2D);
+        bytestream2_put_le32u(pb, 0); // miscFlag
+        bytestream2_put_le32u(pb, 1); // arraySize
+        bytestream2_put_le32u(pb, 0); // miscFlags2
+    }
+}
+
+static int dds_encode(AVCodecContext *avctx, AVPacket *pkt,
+                      const AVFrame *frame, int *got_packet)
+{
+    DDSEncContext *ctx = avctx->priv_data;
+    PutByteContext pb0, *const pb = &pb0;
+    int64_t pkt_size;
+    uint8_t *dst;
+    int i, ret;
+
+    pkt_size = 4 + DDS_HEADER_SIZE + (ctx->use_dx10 ? DDS_DX10_HEADER_SIZE : 0) +
+               ctx->tex_size;
+    if (pkt_size > INT_MAX)
+        return AVERROR(EINVAL);
+
+    ret = ff_get_encode_buffer(avctx, pkt, pkt_size, 0);
+    if (ret < 0)
+        return ret;
+
+    /* The top level is compressed straight from the frame when its size
+     * is block aligned, otherwise from a padded copy. */
+    if (ctx->mip[0].buf) {
+        av_image_copy_plane(ctx->mip[0].buf, ctx->mip[0].linesize,
+                            frame->data[0], frame->linesize[0],
+                            avctx->width * 4, avctx->height);
+        pad_level(&ctx->mip[0]);
+    } else {
+        ctx->mip[0].data     = frame->data[0];
+        ctx->mip[0].linesize = frame->linesize[0];
+    }
+
+    for (i = 1; i < ctx->mip_count; i++) {
+        ctx->cur_level  = i;
+        ctx->mip_slices = av_clip(avctx->thread_count, 1, ctx->mip[i].height);
+        avctx->execute2(avctx, downscale_slice, ctx, NULL, ctx->mip_slices);
+        pad_level(&ctx->mip[i]);
+    }
+
+    bytestream2_init_writer(pb, pkt->data, pkt_size);
+    write_header(avctx, pb);
+
+    dst = pkt->data + bytestream2_tell_p(pb);
+    for (i = 0; i < ctx->mip_count; i++) {
+        const DDSMipLevel *level = &ctx->mip[i];
+
+        ctx->enc.tex_data.out   = dst;
+        ctx->enc.frame_data.in  = level->data;
+        ctx->enc.stride         = level->linesize;
+        ctx->enc.width          = level->coded_width;
+        ctx->enc.height         = level->coded_height;
+        ctx->enc.slice_count    = av_clip(avctx->thread_count, 1,
+                                          level->coded_height / TEXTURE_BLOCK_H);
+        ff_texturedsp_exec_compress_threads(avctx, &ctx->enc);
+
+        dst += level_tex_size(ctx, level);
+    }
+
+    *got_packet = 1;
+    return 0;
+}
+
+static av_cold int dds_init(AVCodecContext *avctx)
+{
+    DDSEncContext *ctx = avctx->priv_data;
+    TextureDSPEncContext dxtc;
+    int max_levels, w, h, i;
+    int ret = av_image_check_size(avctx->width, avctx->height, 0, avctx);
+
+    if (ret < 0) {
+        av_log(avctx, AV_LOG_ERROR, "Invalid image size %dx%d.\n",
+               avctx->width, avctx->height);
+        return ret;
+    }
+
+    ff_texturedspenc_init(&dxtc);
+
+    ctx->use_dx10 = ctx->opt_dx10;
+    switch (ctx->opt_tex_fmt) {
+    case DDS_FMT_BC1:
+        ctx->fourcc        = MKTAG('D', 'X', 'T', '1');
+        ctx->dxgi          = DXGI_FORMAT_BC1_UNORM;
+        ctx->enc.tex_ratio = 8;
+        ctx->enc.tex_funct = dxtc.dxt1_block;
+        break;
+    case DDS_FMT_BC3:
+        ctx->fourcc        = MKTAG('D', 'X', 'T', '5');
+        ctx->dxgi          = DXGI_FORMAT_BC3_UNORM;
+        ctx->enc.tex_ratio = 16;
+        ctx->enc.tex_funct = dxtc.dxt5_block;
+        break;
+    case DDS_FMT_BC4:
+        ctx->fourcc        = MKTAG('A', 'T', 'I', '1');
+        ctx->dxgi          = DXGI_FORMAT_BC4_UNORM;
+        ctx->enc.tex_ratio = 8;
+        ctx->enc.tex_funct = dxtc.rgtc1u_gray_block;
+        break;
+    case DDS_FMT_BC7: {
+        BC7EncContext bc7;
+        ff_bc7enc_init(&bc7, BC7ENC_TRUE, BC7ENC_MAX_PARTITIONS1, ctx->opt_bc7_uber_level,
+                       BC7ENC_TRUE, BC7ENC_TRUE);
+        /* BC7 has no legacy FourCC. */
+        ctx->use_dx10      = 1;
+        ctx->dxgi          = DXGI_FORMAT_BC7_UNORM;
+        ctx->enc.tex_ratio = 16;
+        ctx->enc.tex_funct = bc7.bc7enc_block;
+        break;
+    }
+    default:
+        av_log(avctx, AV_LOG_ERROR, "Invalid format %02X\n", ctx->opt_tex_fmt);
+        return AVERROR_INVALIDDATA;
+    }
+    ctx->enc.raw_ratio = 16;
+
+    /* A full chain goes down to a 1x1 level. */
+    max_levels = av_log2(FFMAX(avctx->width, avctx->height)) + 1;
+    max_levels = FFMIN(max_levels, DDS_MAX_MIPMAPS);
+    ctx->mip_count = ctx->opt_mipmaps ? FFMIN(ctx->opt_mipmaps, max_levels) : max_levels;
+
+    w = avctx->width;
+    h = avctx->height;
+    ctx->tex_size = 0;
+    for (i = 0; i < ctx->mip_count; i++) {
+        DDSMipLevel *level = &ctx->mip[i];
+
+        level->width        = w;
+        level->height       = h;
+        level->coded_width  = FFALIGN(w, TEXTURE_BLOCK_W);
+        level->coded_height = FFALIGN(h, TEXTURE_BLOCK_H);
+
+        if (i > 0 || level->coded_width != w || level->coded_height != h) {
+            level->linesize = level->coded_width * 4;
+            level->buf = av_malloc(level->linesize * level->coded_height);
+            if (!level->buf)
+                return AVERROR(ENOMEM);
+            level->data = level->buf;
+        }
+
+        ctx->tex_size += level_tex_size(ctx, level);
+
+        w = FFMAX(w >> 1, 1);
+        h = FFMAX(h >> 1, 1);
+    }
+
+    return 0;
+}
+
+static av_cold int dds_close(AVCodecContext *avctx)
+{
+    DDSEncContext *ctx = avctx->priv_data;
+    int i;
+
+    for (i = 0; i < DDS_MAX_MIPMAPS; i++)
+        av_freep(&ctx->mip[i].buf);
+
+    return 0;
+}
+
+#define OFFSET(x) offsetof(DDSEncContext, x)
+#define FLAGS     AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_ENCODING_PARAM
+static const AVOption options[] = {
+    { "format", "Texture format", OFFSET(opt_tex_fmt), AV_OPT_TYPE_INT, { .i64 = DDS_FMT_BC3 }, DDS_FMT_BC1, DDS_FMT_BC7, FLAGS, .unit = "format" },
+        { "bc1",  "BC1 (DXT1) texture",  0, AV_OPT_TYPE_CONST, { .i64 = DDS_FMT_BC1 }, 0, 0, FLAGS, .unit = "format" },
+        { "dxt1", "BC1 (DXT1) texture",  0, AV_OPT_TYPE_CONST, { .i64 = DDS_FMT_BC1 }, 0, 0, FLAGS, .unit = "format" },
+        { "bc3",  "BC3 (DXT5) texture",  0, AV_OPT_TYPE_CONST, { .i64 = DDS_FMT_BC3 }, 0, 0, FLAGS, .unit = "format" },
+        { "dxt5", "BC3 (DXT5) texture",  0, AV_OPT_TYPE_CONST, { .i64 = DDS_FMT_BC3 }, 0, 0, FLAGS, .unit = "format" },
+        { "bc4",  "BC4 (RGTC1) texture, red channel only", 0, AV_OPT_TYPE_CONST, { .i64 = DDS_FMT_BC4 }, 0, 0, FLAGS, .unit = "format" },
+        { "bc7",  "BC7 (BPTC) texture",  0, AV_OPT_TYPE_CONST, { .i64 = DDS_FMT_BC7 }, 0, 0, FLAGS, .unit = "format" },
+    { "mipmaps", "number of mipmap levels, 0 for a full chain", OFFSET(opt_mipmaps), AV_OPT_TYPE_INT, { .i64 = 1 }, 0, DDS_MAX_MIPMAPS, FLAGS },
+    { "dx10", "always write the DX10 extended header", OFFSET(opt_dx10), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
+    { "bc7_uber", "BC7 quality level", OFFSET(opt_bc7_uber_level), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, BC7ENC_MAX_UBER_LEVEL, FLAGS },
+    { NULL },
+};
+
+static const AVClass ddsenc_class = {
+    .class_name = "DDS encoder",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+const FFCodec ff_dds_encoder = {
+    .p.name         = "dds",
+    CODEC_LONG_NAME("DirectDraw Surface image"),
+    .p.type         = AVMEDIA_TYPE_VIDEO,
+    .p.id           = AV_CODEC_ID_DDS,
+    .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS |
+                      AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE,
+    .p.priv_class   = &ddsenc_class,
+    .priv_data_size = sizeof(DDSEncContext),
+    .init           = dds_init,
+    FF_CODEC_ENCODE_CB(dds_encode),
+    .close          = dds_close,
+    CODEC_PIXFMTS(AV_PIX_FMT_RGBA),
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP,
+};
@@ -62,6 +62,13 @@ static void frame_pool_free(AVRefStructOpaque unused, void *obj)
         av_buffer_pool_uninit(&pool->pools[i]);
 }
 
+static AVBufferPool *buffer_pool_init(const AVCodecContext *avctx, size_t size)
+{
+    if (avctx->buffer_pool_flags)
+        return av_buffer_pool_init_flags(size, avctx->buffer_pool_flags);
+    return av_buffer_pool_init(size, CONFIG_MEMORY_POISONING ? NULL : av_buffer_allocz);
+}
+
 static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
 {
     FramePool *pool = avctx->internal->pool;
@@ -119,10 +126,7 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
                     ret = AVERROR(EINVAL);
                     goto fail;
                 }
-                pool->pools[i] = av_buffer_pool_init(size[i] + 16 + STRIDE_ALIGN - 1,
-                                                     CONFIG_MEMORY_POISONING ?
-                                                        NULL :
-                                                        av_buffer_allocz);
+                pool->pools[i] = buffer_pool_init(avctx, size[i] + 16 + STRIDE_ALIGN - 1);
                 if (!pool->pools[i]) {
                     ret = AVERROR(ENOMEM);
                     goto fail;
@@ -142,10 +146,7 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
         if (ret < 0)
             goto fail;
 
-        pool->pools[0] = av_buffer_pool_init(pool->linesize[0],
-                                             CONFIG_MEMORY_POISONING ?
-                                                NULL :
-                                                av_buffer_allocz);
+        pool->pools[0] = buffer_pool_init(avctx, pool->linesize[0]);
         if (!pool->pools[0]) {
             ret = AVERROR(ENOMEM);
             goto fail;
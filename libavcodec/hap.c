@@ -23,8 +23,19 @@
  * @file
  * Hap utilities
  */
+#include <string.h>
+
+#include "config.h"
+
+#if CONFIG_LIBSNAPPY
+#include "snappy-c.h"
+#endif
+
+#include "libavutil/error.h"
+#include "libavutil/log.h"
 #include "libavutil/mem.h"
 #include "hap.h"
+#include "snappy.h"
 
 int ff_hap_set_chunk_count(HapContext *ctx, int count, int first_in_frame)
 {
@@ -77,3 +88,428 @@ int ff_hap_parse_section_header(GetByteContext *gbc, int *section_size,
     else
         return 0;
 }
+
+void ff_hap_write_section_header(PutByteContext *pbc,
+                                 enum HapHeaderLength header_length,
+                                 int section_length,
+                                 enum HapSectionType section_type)
+{
+    /* The first three bytes are the length of the section (not including the
+     * header) or zero if using an eight-byte header.
+     * For an eight-byte header, the length is in the last four bytes.
+     * The fourth byte stores the section type. */
+    bytestream2_put_le24(pbc, header_length == HAP_HDR_LONG ? 0 : section_length);
+    bytestream2_put_byte(pbc, section_type);
+
+    if (header_length == HAP_HDR_LONG) {
+        bytestream2_put_le32(pbc, section_length);
+    }
+}
+
+static int hap_decode_instructions_length(int chunk_count)
+{
+    /*    Second-Stage Compressor Table (one byte per entry)
+     *  + Chunk Size Table (four bytes per entry)
+     *  + headers for both sections (short versions)
+     *  = chunk_count + (4 * chunk_count) + 4 + 4 */
+    return (5 * chunk_count) + 8;
+}
+
+enum HapHeaderLength ff_hap_section_header_length(size_t section_length)
+{
+    return section_length > HAP_UINT24_MAX ? HAP_HDR_LONG : HAP_HDR_SHORT;
+}
+
+size_t ff_hap_texture_section_length(int chunk_count, size_t payload_size)
+{
+    size_t length = payload_size;
+
+    if (chunk_count > 1)
+        length += HAP_HDR_SHORT + hap_decode_instructions_length(chunk_count);
+
+    return length;
+}
+
+int ff_hap_texture_section_header_length(int chunk_count,
+                                         enum HapHeaderLength header_length)
+{
+    int length = header_length;
+
+    if (chunk_count > 1)
+        length += HAP_HDR_SHORT + hap_decode_instructions_length(chunk_count);
+
+    return length;
+}
+
+void ff_hap_write_texture_header(HapContext *ctx, uint8_t *dst,
+                                 enum HapTextureFormat tex_fmt,
+                                 int chunk_count, int frame_length,
+                                 enum HapHeaderLength header_length)
+{
+    PutByteContext pbc;
+    int i;
+
+    bytestream2_init_writer(&pbc, dst, frame_length);
+
+    if (chunk_count == 1) {
+        /* Write a simple header */
+        ff_hap_write_section_header(&pbc, header_length, frame_length - header_length,
+                                    ctx->chunks[0].compressor | tex_fmt);
+    } else {
+        /* Write a complex header with Decode Instructions Container */
+        ff_hap_write_section_header(&pbc, header_length, frame_length - header_length,
+                                    HAP_COMP_COMPLEX | tex_fmt);
+        ff_hap_write_section_header(&pbc, HAP_HDR_SHORT, hap_decode_instructions_length(chunk_count),
+                                    HAP_ST_DECODE_INSTRUCTIONS);
+        ff_hap_write_section_header(&pbc, HAP_HDR_SHORT, chunk_count,
+                                    HAP_ST_COMPRESSOR_TABLE);
+
+        for (i = 0; i < chunk_count; i++) {
+            bytestream2_put_byte(&pbc, ctx->chunks[i].compressor >> 4);
+        }
+
+        ff_hap_write_section_header(&pbc, HAP_HDR_SHORT, chunk_count * 4,
+                                    HAP_ST_SIZE_TABLE);
+
+        for (i = 0; i < chunk_count; i++) {
+            bytestream2_put_le32(&pbc, ctx->chunks[i].compressed_size);
+        }
+    }
+}
+
+int ff_hap_texture_ratio(enum HapTextureFormat tex_fmt)
+{
+    return tex_fmt == HAP_FMT_RGBDXT1 || tex_fmt == HAP_FMT_RGTC1 ? 8 : 16;
+}
+
+int ff_hap_chunk_count(int requested, int block_count)
+{
+    /* Round the chunk count to divide evenly on DXT block edges */
+    int count = av_clip(requested, 1, HAP_MAX_CHUNKS);
+
+    while (block_count % count != 0)
+        count--;
+
+    return count;
+}
+
+int ff_hap_compress_chunk(void *logctx, HapChunk *chunk,
+                          const uint8_t *src, uint8_t *dst)
+{
+#if CONFIG_LIBSNAPPY
+    int ret = snappy_compress(src, chunk->uncompressed_size,
+                              dst, &chunk->compressed_size);
+    if (ret != SNAPPY_OK) {
+        av_log(logctx, AV_LOG_ERROR, "Snappy compress error.\n");
+        return AVERROR_BUG;
+    }
+
+    /* If there is no gain from snappy, just use the raw texture. */
+    if (chunk->compressed_size >= chunk->uncompressed_size) {
+        av_log(logctx, AV_LOG_VERBOSE,
+               "Snappy buffer bigger than uncompressed (%"SIZE_SPECIFIER" >= %"SIZE_SPECIFIER" bytes).\n",
+               chunk->compressed_size, chunk->uncompressed_size);
+        memcpy(dst, src, chunk->uncompressed_size);
+        chunk->compressor = HAP_COMP_NONE;
+        chunk->compressed_size = chunk->uncompressed_size;
+    } else {
+        chunk->compressor = HAP_COMP_SNAPPY;
+    }
+
+    return 0;
+#else
+    av_log(logctx, AV_LOG_ERROR, "Snappy compression requires libsnappy.\n");
+    return AVERROR(ENOSYS);
+#endif
+}
+
+static int hap_parse_decode_instructions(HapContext *ctx, GetByteContext *gbc,
+                                         int size)
+{
+    int section_size;
+    enum HapSectionType section_type;
+    int is_first_table = 1, had_offsets = 0, had_compressors = 0, had_sizes = 0;
+    int i, ret;
+
+    while (size > 0) {
+        int stream_remaining = bytestream2_get_bytes_left(gbc);
+        ret = ff_hap_parse_section_header(gbc, &section_size, &section_type);
+        if (ret != 0)
+            return ret;
+
+        size -= stream_remaining - bytestream2_get_bytes_left(gbc);
+
+        switch (section_type) {
+            case HAP_ST_COMPRESSOR_TABLE:
+                ret = ff_hap_set_chunk_count(ctx, section_size, is_first_table);
+                if (ret != 0)
+                    return ret;
+                for (i = 0; i < section_size; i++) {
+                    ctx->chunks[i].compressor = bytestream2_get_byte(gbc) << 4;
+                }
+                had_compressors = 1;
+                is_first_table = 0;
+                break;
+            case HAP_ST_SIZE_TABLE:
+                ret = ff_hap_set_chunk_count(ctx, section_size / 4, is_first_table);
+                if (ret != 0)
+                    return ret;
+                for (i = 0; i < section_size / 4; i++) {
+                    ctx->chunks[i].compressed_size = bytestream2_get_le32(gbc);
+                }
+                had_sizes = 1;
+                is_first_table = 0;
+                break;
+            case HAP_ST_OFFSET_TABLE:
+                ret = ff_hap_set_chunk_count(ctx, section_size / 4, is_first_table);
+                if (ret != 0)
+                    return ret;
+                for (i = 0; i < section_size / 4; i++) {
+                    ctx->chunks[i].compressed_offset = bytestream2_get_le32(gbc);
+                }
+                had_offsets = 1;
+                is_first_table = 0;
+                break;
+            default:
+                break;
+        }
+        size -= section_size;
+    }
+
+    if (!had_sizes || !had_compressors)
+        return AVERROR_INVALIDDATA;
+
+    /* The offsets table is optional. If not present than calculate offsets by
+     * summing the sizes of preceding chunks. */
+    if (!had_offsets) {
+        size_t running_size = 0;
+        for (i = 0; i < ctx->chunk_count; i++) {
+            ctx->chunks[i].compressed_offset = running_size;
+            if (ctx->chunks[i].compressed_size > UINT32_MAX - running_size)
+                return AVERROR_INVALIDDATA;
+            running_size += ctx->chunks[i].compressed_size;
+        }
+    }
+
+    return 0;
+}
+
+int ff_hap_parse_texture_header(HapContext *ctx, void *logctx,
+                                GetByteContext *gbc,
+                                enum HapTextureFormat *tex_fmt)
+{
+    int section_size;
+    enum HapSectionType section_type;
+    const char *compressorstr;
+    int i, ret;
+
+    ret = ff_hap_parse_section_header(gbc, &ctx->texture_section_size, &section_type);
+    if (ret != 0)
+        return ret;
+
+    *tex_fmt = section_type & 0x0F;
+
+    switch (section_type & 0xF0) {
+        case HAP_COMP_NONE:
+        case HAP_COMP_SNAPPY:
+            ret = ff_hap_set_chunk_count(ctx, 1, 1);
+            if (ret == 0) {
+                ctx->chunks[0].compressor = section_type & 0xF0;
+                ctx->chunks[0].compressed_offset = 0;
+                ctx->chunks[0].compressed_size = ctx->texture_section_size;
+            }
+            if (ctx->chunks[0].compressor == HAP_COMP_NONE) {
+                compressorstr = "none";
+            } else {
+                compressorstr = "snappy";
+            }
+            break;
+        case HAP_COMP_COMPLEX:
+            ret = ff_hap_parse_section_header(gbc, &section_size, &section_type);
+            if (ret == 0 && section_type != HAP_ST_DECODE_INSTRUCTIONS)
+                ret = AVERROR_INVALIDDATA;
+            if (ret == 0)
+                ret = hap_parse_decode_instructions(ctx, gbc, section_size);
+            compressorstr = "complex";
+            break;
+        default:
+            ret = AVERROR_INVALIDDATA;
+            break;
+    }
+
+    if (ret != 0)
+        return ret;
+
+    /* Check the frame is valid and read the uncompressed chunk sizes */
+    ctx->tex_size = 0;
+    for (i = 0; i < ctx->chunk_count; i++) {
+        HapChunk *chunk = &ctx->chunks[i];
+
+        /* Check the compressed buffer is valid */
+        if (chunk->compressed_offset + (uint64_t)chunk->compressed_size > bytestream2_get_bytes_left(gbc))
+            return AVERROR_INVALIDDATA;
+
+        /* Chunks are unpacked sequentially, ctx->tex_size is the uncompressed
+         * size thus far */
+        chunk->uncompressed_offset = ctx->tex_size;
+
+        /* Fill out uncompressed size */
+        if (chunk->compressor == HAP_COMP_SNAPPY) {
+            GetByteContext gbc_tmp;
+            int64_t uncompressed_size;
+            bytestream2_init(&gbc_tmp, gbc->buffer + chunk->compressed_offset,
+                             chunk->compressed_size);
+            uncompressed_size = ff_snappy_peek_uncompressed_length(&gbc_tmp);
+            if (uncompressed_size < 0) {
+                return uncompressed_size;
+            }
+            chunk->uncompressed_size = uncompressed_size;
+        } else if (chunk->compressor == HAP_COMP_NONE) {
+            chunk->uncompressed_size = chunk->compressed_size;
+        } else {
+            return AVERROR_INVALIDDATA;
+        }
+        if (chunk->uncompressed_size > INT_MAX - ctx->tex_size)
+            return AVERROR_INVALIDDATA;
+        ctx->tex_size += chunk->uncompressed_size;
+    }
+
+    av_log(logctx, AV_LOG_DEBUG, "%s compressor\n", compressorstr);
+
+    return ret;
+}
+
+int ff_hap_can_use_tex_in_place(HapContext *ctx)
+{
+    int i;
+    size_t running_offset = 0;
+    for (i = 0; i < ctx->chunk_count; i++) {
+        if (ctx->chunks[i].compressed_offset != running_offset
+            || ctx->chunks[i].compressor != HAP_COMP_NONE)
+            return 0;
+        running_offset += ctx->chunks[i].compressed_size;
+    }
+    return 1;
+}
+
+int ff_hap_decompress_chunk(const HapChunk *chunk, const uint8_t *src,
+                            uint8_t *tex)
+{
+    GetByteContext gbc;
+    uint8_t *dst = tex + chunk->uncompressed_offset;
+
+    bytestream2_init(&gbc, src + chunk->compressed_offset, chunk->compressed_size);
+
+    if (chunk->compressor == HAP_COMP_SNAPPY) {
+        int64_t uncompressed_size = chunk->uncompressed_size;
+
+        /* Uncompress the frame */
+        return ff_snappy_uncompress(&gbc, dst, &uncompressed_size);
+    } else if (chunk->compressor == HAP_COMP_NONE) {
+        bytestream2_get_buffer(&gbc, dst, chunk->compressed_size);
+    }
+
+    return 0;
+}
+
+int ff_hap_unpack_texture(HapContext *ctx, void *logctx, GetByteContext *gbc,
+                          enum HapTextureFormat *tex_fmt, const uint8_t **tex)
+{
+    int start = bytestream2_tell(gbc);
+    int header_length = bytestream2_peek_le24(gbc) ? HAP_HDR_SHORT : HAP_HDR_LONG;
+    int i, ret;
+
+    ret = ff_hap_parse_texture_header(ctx, logctx, gbc, tex_fmt);
+    if (ret < 0)
+        return ret;
+
+    if (ff_hap_can_use_tex_in_place(ctx)) {
+        *tex = gbc->buffer;
+    } else {
+        ret = av_reallocp(&ctx->tex_buf, ctx->tex_size);
+        if (ret < 0)
+            return ret;
+
+        for (i = 0; i < ctx->chunk_count; i++) {
+            ret = ff_hap_decompress_chunk(&ctx->chunks[i], gbc->buffer, ctx->tex_buf);
+            if (ret < 0) {
+                av_log(logctx, AV_LOG_ERROR, "Snappy uncompress error\n");
+                return ret;
+            }
+        }
+        *tex = ctx->tex_buf;
+    }
+
+    bytestream2_seek(gbc, start + header_length + ctx->texture_section_size, SEEK_SET);
+
+    return 0;
+}
+
+size_t ff_hap_max_chunk_size(enum HapCompressor compressor, size_t chunk_size)
+{
+#if CONFIG_LIBSNAPPY
+    if (compressor == HAP_COMP_SNAPPY)
+        return snappy_max_compressed_length(chunk_size);
+#endif
+    return chunk_size;
+}
+
+static size_t hap_max_payload(int chunk_count, enum HapCompressor compressor,
+                              size_t tex_size)
+{
+    return chunk_count * ff_hap_max_chunk_size(compressor, tex_size / chunk_count);
+}
+
+size_t ff_hap_max_texture_section_size(int chunk_count,
+                                       enum HapCompressor compressor,
+                                       size_t tex_size)
+{
+    size_t max_payload = hap_max_payload(chunk_count, compressor, tex_size);
+
+    return ff_hap_texture_section_length(chunk_count, max_payload) + HAP_HDR_LONG;
+}
+
+int ff_hap_pack_texture(HapContext *ctx, void *logctx, uint8_t *dst,
+                        enum HapTextureFormat tex_fmt,
+                        enum HapCompressor compressor,
+                        const uint8_t *tex, size_t tex_size)
+{
+    size_t max_payload = hap_max_payload(ctx->chunk_count, compressor, tex_size);
+    size_t section_length = ff_hap_texture_section_length(ctx->chunk_count, max_payload);
+    enum HapHeaderLength header_length = ff_hap_section_header_length(section_length);
+    int tex_header_len = ff_hap_texture_section_header_length(ctx->chunk_count, header_length);
+    size_t final_size = 0;
+    int i, ret;
+
+    if (compressor == HAP_COMP_NONE && ctx->chunk_count > 1)
+        return AVERROR(EINVAL);
+    if (max_payload + tex_header_len > INT_MAX)
+        return AVERROR(ERANGE);
+
+    for (i = 0; i < ctx->chunk_count; i++) {
+        HapChunk *chunk = &ctx->chunks[i];
+        uint8_t *chunk_dst = dst + tex_header_len + final_size;
+
+        chunk->compressed_offset = final_size;
+        chunk->uncompressed_size = tex_size / ctx->chunk_count;
+        chunk->uncompressed_offset = i * chunk->uncompressed_size;
+
+        if (compressor == HAP_COMP_SNAPPY) {
+            chunk->compressed_size = max_payload / ctx->chunk_count;
+            ret = ff_hap_compress_chunk(logctx, chunk,
+                                        tex + chunk->uncompressed_offset, chunk_dst);
+            if (ret < 0)
+                return ret;
+        } else {
+            memcpy(chunk_dst, tex, tex_size);
+            chunk->compressor = HAP_COMP_NONE;
+            chunk->compressed_size = tex_size;
+        }
+        final_size += chunk->compressed_size;
+    }
+
+    ff_hap_write_texture_header(ctx, dst, tex_fmt, ctx->chunk_count,
+                                final_size + tex_header_len, header_length);
+
+    return final_size + tex_header_len;
+}
@@ -29,6 +29,17 @@
 #include "bytestream.h"
 #include "texturedsp.h"
 
+#define HAP_MAX_CHUNKS 64
+
+enum HapHeaderLength {
+    /* Short header: four bytes with a 24 bit size value */
+    HAP_HDR_SHORT = 4,
+    /* Long header: eight bytes with a 32 bit size value */
+    HAP_HDR_LONG = 8,
+};
+
+#define HAP_UINT24_MAX 0x00FFFFFF
+
 enum HapTextureFormat {
     HAP_FMT_RGBDXT1   = 0x0B,
     HAP_FMT_BPTC      = 0x0C,  /* RGBA BPTC (BC7) */
@@ -68,6 +79,7 @@ typedef struct HapContext {
     int opt_chunk_count; /* User-requested chunk count (encoder only) */
     int opt_compressor; /* User-requested compressor (encoder only) */
     int opt_bc7_uber_level; /* BC7 encoder quality level (encoder only) */
+    int opt_reuse_blocks; /* Reuse blocks unchanged since the previous frame (encoder only) */
 
     int chunk_count;
     HapChunk *chunks;
@@ -86,6 +98,13 @@ typedef struct HapContext {
     size_t tex_size_alpha;   /* Size of alpha texture in HapM encoding */
 
     TextureDSPThreadContext enc[2];  /* Encoder contexts for multi-texture */
+    struct AVFrame *prev_frame; /* Source of the blocks in tex_buf (block reuse) */
+    int *reused_blocks;      /* Per-slice count of reused blocks */
+    int64_t total_reused, total_blocks;
+
+    int opt_stats_side_data; /* Export per-frame statistics as packet side data */
+    char *opt_stats_file;    /* Write per-frame statistics to this file */
+    struct HapEncStats *stats;
     TextureDSPThreadContext dec[2];  /* Decoder contexts for multi-texture */
 } HapContext;
 
@@ -107,4 +126,111 @@ av_cold void ff_hap_free_context(HapContext *ctx);
 int ff_hap_parse_section_header(GetByteContext *gbc, int *section_size,
                                 enum HapSectionType *section_type);
 
+/*
+ * Write a section header, section_length does not include the header
+ */
+void ff_hap_write_section_header(PutByteContext *pbc,
+                                 enum HapHeaderLength header_length,
+                                 int section_length,
+                                 enum HapSectionType section_type);
+
+/*
+ * Header length needed for a section of section_length bytes
+ */
+enum HapHeaderLength ff_hap_section_header_length(size_t section_length);
+
+/*
+ * Length of a texture section without its own header, for chunk_count chunks
+ * holding payload_size bytes
+ */
+size_t ff_hap_texture_section_length(int chunk_count, size_t payload_size);
+
+/*
+ * Length of the headers in front of the chunk data of a texture section
+ */
+int ff_hap_texture_section_header_length(int chunk_count,
+                                         enum HapHeaderLength header_length);
+
+/*
+ * Write the headers of a texture section described by ctx->chunks,
+ * frame_length includes the headers
+ */
+void ff_hap_write_texture_header(HapContext *ctx, uint8_t *dst,
+                                 enum HapTextureFormat tex_fmt,
+                                 int chunk_count, int frame_length,
+                                 enum HapHeaderLength header_length);
+
+/*
+ * Bytes per 4x4 block of a texture format
+ */
+int ff_hap_texture_ratio(enum HapTextureFormat tex_fmt);
+
+/*
+ * Largest chunk count up to requested that splits block_count blocks
+ * into equal chunks
+ */
+int ff_hap_chunk_count(int requested, int block_count);
+
+/*
+ * Snappy compress chunk->uncompressed_size bytes from src to dst, falling
+ * back to a plain copy if that does not make the chunk smaller. On input
+ * chunk->compressed_size is the space available in dst; the stored size
+ * and the compressor used are set on output.
+ */
+int ff_hap_compress_chunk(void *logctx, HapChunk *chunk,
+                          const uint8_t *src, uint8_t *dst);
+
+/*
+ * Parse the headers of the texture section at the start of gbc into
+ * ctx->chunks, ctx->tex_size and ctx->texture_section_size. On success
+ * gbc points at the chunk data, which the chunk offsets are relative to.
+ */
+int ff_hap_parse_texture_header(HapContext *ctx, void *logctx,
+                                GetByteContext *gbc,
+                                enum HapTextureFormat *tex_fmt);
+
+/*
+ * Whether the chunks parsed by ff_hap_parse_texture_header() can be used
+ * as texture without second-stage decompression
+ */
+int ff_hap_can_use_tex_in_place(HapContext *ctx);
+
+/*
+ * Undo the second-stage compression of a chunk, src is the chunk data
+ * of the texture section and tex the texture the chunk is written into
+ */
+int ff_hap_decompress_chunk(const HapChunk *chunk, const uint8_t *src,
+                            uint8_t *tex);
+
+/*
+ * Parse the texture section at the start of gbc and undo its second-stage
+ * compression. On success *tex points to ctx->tex_size bytes of texture,
+ * either in the input or in ctx->tex_buf, and gbc is positioned past the
+ * section.
+ */
+int ff_hap_unpack_texture(HapContext *ctx, void *logctx, GetByteContext *gbc,
+                          enum HapTextureFormat *tex_fmt, const uint8_t **tex);
+
+/*
+ * Largest size of a chunk of chunk_size bytes after second-stage compression
+ */
+size_t ff_hap_max_chunk_size(enum HapCompressor compressor, size_t chunk_size);
+
+/*
+ * Largest texture section ff_hap_pack_texture() can write
+ */
+size_t ff_hap_max_texture_section_size(int chunk_count,
+                                       enum HapCompressor compressor,
+                                       size_t tex_size);
+
+/*
+ * Write tex_size bytes of texture as a texture section, split into
+ * ctx->chunk_count chunks compressed with compressor.
+ * Returns the number of bytes written or a negative error code.
+ */
+int ff_hap_pack_texture(HapContext *ctx, void *logctx, uint8_t *dst,
+                        enum HapTextureFormat tex_fmt,
+                        enum HapCompressor compressor,
+                        const uint8_t *tex, size_t tex_size);
+
 #endif /* AVCODEC_HAP_H */
@@ -41,210 +41,76 @@
 #include "bc7dec.h"
 #include "codec_internal.h"
 #include "hap.h"
-#include "snappy.h"
 #include "texturedsp.h"
 #include "thread.h"
 
-static int hap_parse_decode_instructions(HapContext *ctx, int size)
-{
-    GetByteContext *gbc = &ctx->gbc;
-    int section_size;
-    enum HapSectionType section_type;
-    int is_first_table = 1, had_offsets = 0, had_compressors = 0, had_sizes = 0;
-    int i, ret;
-
-    while (size > 0) {
-        int stream_remaining = bytestream2_get_bytes_left(gbc);
-        ret = ff_hap_parse_section_header(gbc, &section_size, &section_type);
-        if (ret != 0)
-            return ret;
-
-        size -= stream_remaining - bytestream2_get_bytes_left(gbc);
-
-        switch (section_type) {
-            case HAP_ST_COMPRESSOR_TABLE:
-                ret = ff_hap_set_chunk_count(ctx, section_size, is_first_table);
-                if (ret != 0)
-                    return ret;
-                for (i = 0; i < section_size; i++) {
-                    ctx->chunks[i].compressor = bytestream2_get_byte(gbc) << 4;
-                }
-                had_compressors = 1;
-                is_first_table = 0;
-                break;
-            case HAP_ST_SIZE_TABLE:
-                ret = ff_hap_set_chunk_count(ctx, section_size / 4, is_first_table);
-                if (ret != 0)
-                    return ret;
-                for (i = 0; i < section_size / 4; i++) {
-                    ctx->chunks[i].compressed_size = bytestream2_get_le32(gbc);
-                }
-                had_sizes = 1;
-                is_first_table = 0;
-                break;
-            case HAP_ST_OFFSET_TABLE:
-                ret = ff_hap_set_chunk_count(ctx, section_size / 4, is_first_table);
-                if (ret != 0)
-                    return ret;
-                for (i = 0; i < section_size / 4; i++) {
-                    ctx->chunks[i].compressed_offset = bytestream2_get_le32(gbc);
-                }
-                had_offsets = 1;
-                is_first_table = 0;
-                break;
-            default:
-                break;
-        }
-        size -= section_size;
-    }
-
-    if (!had_sizes || !had_compressors)
-        return AVERROR_INVALIDDATA;
-
-    /* The offsets table is optional. If not present than calculate offsets by
-     * summing the sizes of preceding chunks. */
-    if (!had_offsets) {
-        size_t running_size = 0;
-        for (i = 0; i < ctx->chunk_count; i++) {
-            ctx->chunks[i].compressed_offset = running_size;
-            if (ctx->chunks[i].compressed_size > UINT32_MAX - running_size)
-                return AVERROR_INVALIDDATA;
-            running_size += ctx->chunks[i].compressed_size;
-        }
-    }
-
-    return 0;
-}
-
-static int hap_can_use_tex_in_place(HapContext *ctx)
-{
-    int i;
-    size_t running_offset = 0;
-    for (i = 0; i < ctx->chunk_count; i++) {
-        if (ctx->chunks[i].compressed_offset != running_offset
-            || ctx->chunks[i].compressor != HAP_COMP_NONE)
-            return 0;
-        running_offset += ctx->chunks[i].compressed_size;
-    }
-    return 1;
-}
-
 static int hap_parse_frame_header(AVCodecContext *avctx)
 {
     HapContext *ctx = avctx->priv_data;
-    GetByteContext *gbc = &ctx->gbc;
-    int section_size;
-    enum HapSectionType section_type;
-    const char *compressorstr;
-    int i, ret;
+    enum HapTextureFormat tex_fmt;
+    int ret;
 
-    ret = ff_hap_parse_section_header(gbc, &ctx->texture_section_size, &section_type);
+    ret = ff_hap_parse_texture_header(ctx, avctx, &ctx->gbc, &tex_fmt);
     if (ret != 0)
         return ret;
 
-    if ((avctx->codec_tag == MKTAG('H','a','p','1') && (section_type & 0x0F) != HAP_FMT_RGBDXT1) ||
-        (avctx->codec_tag == MKTAG('H','a','p','5') && (section_type & 0x0F) != HAP_FMT_RGBADXT5) ||
-        (avctx->codec_tag == MKTAG('H','a','p','Y') && (section_type & 0x0F) != HAP_FMT_YCOCGDXT5) ||
-        (avctx->codec_tag == MKTAG('H','a','p','A') && (section_type & 0x0F) != HAP_FMT_RGTC1) ||
-        (avctx->codec_tag == MKTAG('H','a','p','7') && (section_type & 0x0F) != HAP_FMT_BPTC) ||
-        ((avctx->codec_tag == MKTAG('H','a','p','M') && (section_type & 0x0F) != HAP_FMT_RGTC1) &&
-                                                        (section_type & 0x0F) != HAP_FMT_YCOCGDXT5)) {
+    if ((avctx->codec_tag == MKTAG('H','a','p','1') && tex_fmt != HAP_FMT_RGBDXT1) ||
+        (avctx->codec_tag == MKTAG('H','a','p','5') && tex_fmt != HAP_FMT_RGBADXT5) ||
+        (avctx->codec_tag == MKTAG('H','a','p','Y') && tex_fmt != HAP_FMT_YCOCGDXT5) ||
+        (avctx->codec_tag == MKTAG('H','a','p','A') && tex_fmt != HAP_FMT_RGTC1) ||
+        (avctx->codec_tag == MKTAG('H','a','p','7') && tex_fmt != HAP_FMT_BPTC) ||
+        ((avctx->codec_tag == MKTAG('H','a','p','M') && tex_fmt != HAP_FMT_RGTC1) &&
+                                                        tex_fmt != HAP_FMT_YCOCGDXT5)) {
         av_log(avctx, AV_LOG_ERROR,
-               "Invalid texture format %#04x.\n", section_type & 0x0F);
+               "Invalid texture format %#04x.\n", tex_fmt);
         return AVERROR_INVALIDDATA;
     }
 
-    switch (section_type & 0xF0) {
-        case HAP_COMP_NONE:
-        case HAP_COMP_SNAPPY:
-            ret = ff_hap_set_chunk_count(ctx, 1, 1);
-            if (ret == 0) {
-                ctx->chunks[0].compressor = section_type & 0xF0;
-                ctx->chunks[0].compressed_offset = 0;
-                ctx->chunks[0].compressed_size = ctx->texture_section_size;
-            }
-            if (ctx->chunks[0].compressor == HAP_COMP_NONE) {
-                compressorstr = "none";
-            } else {
-                compressorstr = "snappy";
-            }
-            break;
-        case HAP_COMP_COMPLEX:
-            ret = ff_hap_parse_section_header(gbc, &section_size, &section_type);
-            if (ret == 0 && section_type != HAP_ST_DECODE_INSTRUCTIONS)
-                ret = AVERROR_INVALIDDATA;
-            if (ret == 0)
-                ret = hap_parse_decode_instructions(ctx, section_size);
-            compressorstr = "complex";
-            break;
-        default:
-            ret = AVERROR_INVALIDDATA;
-            break;
-    }
-
-    if (ret != 0)
-        return ret;
-
-    /* Check the frame is valid and read the uncompressed chunk sizes */
-    ctx->tex_size = 0;
-    for (i = 0; i < ctx->chunk_count; i++) {
-        HapChunk *chunk = &ctx->chunks[i];
+    return 0;
+}
 
-        /* Check the compressed buffer is valid */
-        if (chunk->compressed_offset + (uint64_t)chunk->compressed_size > bytestream2_get_bytes_left(gbc))
-            return AVERROR_INVALIDDATA;
+static int decompress_chunks_thread(AVCodecContext *avctx, void *arg,
+                                    int chunk_nb, int thread_nb)
+{
+    HapContext *ctx = avctx->priv_data;
+    int ret;
 
-        /* Chunks are unpacked sequentially, ctx->tex_size is the uncompressed
-         * size thus far */
-        chunk->uncompressed_offset = ctx->tex_size;
-
-        /* Fill out uncompressed size */
-        if (chunk->compressor == HAP_COMP_SNAPPY) {
-            GetByteContext gbc_tmp;
-            int64_t uncompressed_size;
-            bytestream2_init(&gbc_tmp, gbc->buffer + chunk->compressed_offset,
-                             chunk->compressed_size);
-            uncompressed_size = ff_snappy_peek_uncompressed_length(&gbc_tmp);
-            if (uncompressed_size < 0) {
-                return uncompressed_size;
-            }
-            chunk->uncompressed_size = uncompressed_size;
-        } else if (chunk->compressor == HAP_COMP_NONE) {
-            chunk->uncompressed_size = chunk->compressed_size;
-        } else {
-            return AVERROR_INVALIDDATA;
-        }
-        ctx->tex_size += chunk->uncompressed_size;
+    ret = ff_hap_decompress_chunk(&ctx->chunks[chunk_nb], ctx->gbc.buffer,
+                                  ctx->tex_buf);
+    if (ret < 0) {
+         av_log(avctx, AV_LOG_ERROR, "Snappy uncompress error\n");
+         return ret;
     }
 
-    av_log(avctx, AV_LOG_DEBUG, "%s compressor\n", compressorstr);
-
-    return ret;
+    return 0;
 }
 
-static int decompress_chunks_thread(AVCodecContext *avctx, void *arg,
-                                    int chunk_nb, int thread_nb)
+/* Check the header and size of a texture, leaving the context set up to
+ * decompress it. */
+static int hap_parse_texture(AVCodecContext *avctx, int t, int section_start)
 {
     HapContext *ctx = avctx->priv_data;
+    const int tex_size = (avctx->coded_width  / TEXTURE_BLOCK_W) *
+                         (avctx->coded_height / TEXTURE_BLOCK_H) *
+                         ctx->dec[t].tex_ratio;
+    int ret;
 
-    HapChunk *chunk = &ctx->chunks[chunk_nb];
-    GetByteContext gbc;
-    uint8_t *dst = ctx->tex_buf + chunk->uncompressed_offset;
-
-    bytestream2_init(&gbc, ctx->gbc.buffer + chunk->compressed_offset, chunk->compressed_size);
+    bytestream2_seek(&ctx->gbc, section_start, SEEK_SET);
+    ret = hap_parse_frame_header(avctx);
+    if (ret < 0)
+        return ret;
 
-    if (chunk->compressor == HAP_COMP_SNAPPY) {
-        int ret;
-        int64_t uncompressed_size = ctx->tex_size;
+    if (ctx->tex_size != tex_size) {
+        av_log(avctx, AV_LOG_ERROR, "uncompressed size mismatches\n");
+        return AVERROR_INVALIDDATA;
+    }
 
-        /* Uncompress the frame */
-        ret = ff_snappy_uncompress(&gbc, dst, &uncompressed_size);
-        if (ret < 0) {
-             av_log(avctx, AV_LOG_ERROR, "Snappy uncompress error\n");
-             return ret;
-        }
-    } else if (chunk->compressor == HAP_COMP_NONE) {
-        bytestream2_get_buffer(&gbc, dst, chunk->compressed_size);
+    /* Only DXTC texture compression in a contiguous block */
+    if (ff_hap_can_use_tex_in_place(ctx) &&
+        FFMIN(ctx->texture_section_size,
+              bytestream2_get_bytes_left(&ctx->gbc)) < tex_size) {
+        av_log(avctx, AV_LOG_ERROR, "Insufficient data\n");
+        return AVERROR_INVALIDDATA;
     }
 
     return 0;
@@ -273,51 +139,46 @@ static int hap_decode(AVCodecContext *avctx, AVFrame *frame,
         start_texture_section = 4;
     }
 
+    /* Check all textures before the frame is allocated: with
+     * draw_horiz_band, the caller may already be using it and waits for
+     * every row to be reported. */
+    for (t = 0, i = start_texture_section; t < ctx->texture_count; t++) {
+        ret = hap_parse_texture(avctx, t, i);
+        if (ret < 0)
+            return ret;
+        i += ctx->texture_section_size + 4;
+    }
+
     /* Get the output frame ready to receive data */
     ret = ff_thread_get_buffer(avctx, frame, 0);
     if (ret < 0)
         return ret;
 
     for (t = 0; t < ctx->texture_count; t++) {
-        bytestream2_seek(&ctx->gbc, start_texture_section, SEEK_SET);
-        ret = hap_parse_frame_header(avctx);
+        ret = hap_parse_texture(avctx, t, start_texture_section);
         if (ret < 0)
-            return ret;
-
-        if (ctx->tex_size != (avctx->coded_width  / TEXTURE_BLOCK_W)
-            *(avctx->coded_height / TEXTURE_BLOCK_H)
-            *ctx->dec[t].tex_ratio) {
-            av_log(avctx, AV_LOG_ERROR, "uncompressed size mismatches\n");
-            return AVERROR_INVALIDDATA;
-        }
+            goto fail;
 
         start_texture_section += ctx->texture_section_size + 4;
 
         /* Unpack the DXT texture */
-        if (hap_can_use_tex_in_place(ctx)) {
-            int tex_size;
-            /* Only DXTC texture compression in a contiguous block */
+        if (ff_hap_can_use_tex_in_place(ctx)) {
             ctx->dec[t].tex_data.in = ctx->gbc.buffer;
-            tex_size = FFMIN(ctx->texture_section_size, bytestream2_get_bytes_left(&ctx->gbc));
-            if (tex_size < (avctx->coded_width  / TEXTURE_BLOCK_W)
-                *(avctx->coded_height / TEXTURE_BLOCK_H)
-                *ctx->dec[t].tex_ratio) {
-                av_log(avctx, AV_LOG_ERROR, "Insufficient data\n");
-                return AVERROR_INVALIDDATA;
-            }
         } else {
             /* Perform the second-stage decompression */
             ret = av_reallocp(&ctx->tex_buf, ctx->tex_size);
             if (ret < 0)
-                return ret;
+                goto fail;
             memset(ctx->tex_buf, 0, ctx->tex_size);
 
             avctx->execute2(avctx, decompress_chunks_thread, NULL,
                             ctx->chunk_results, ctx->chunk_count);
 
             for (i = 0; i < ctx->chunk_count; i++) {
-                if (ctx->chunk_results[i] < 0)
-                    return ctx->chunk_results[i];
+                if (ctx->chunk_results[i] < 0) {
+                    ret = ctx->chunk_results[i];
+                    goto fail;
+                }
             }
 
             ctx->dec[t].tex_data.in = ctx->tex_buf;
@@ -327,6 +188,9 @@ static int hap_decode(AVCodecContext *avctx, AVFrame *frame,
         ctx->dec[t].stride = frame->linesize[0];
         ctx->dec[t].width  = avctx->coded_width;
         ctx->dec[t].height = avctx->coded_height;
+        /* Rows are only complete once the last texture is decompressed */
+        ctx->dec[t].band_frame = avctx->draw_horiz_band &&
+                                 t == ctx->texture_count - 1 ? frame : NULL;
         ff_texturedsp_exec_decompress_threads(avctx, &ctx->dec[t]);
     }
 
@@ -334,6 +198,16 @@ static int hap_decode(AVCodecContext *avctx, AVFrame *frame,
     *got_frame = 1;
 
     return avpkt->size;
+
+fail:
+    /* No row has been reported yet, as that only happens while decoding
+     * the last texture. Report them all, the caller must not wait for
+     * rows that will never be written. */
+    if (avctx->draw_horiz_band) {
+        int offset[AV_NUM_DATA_POINTERS] = { 0 };
+        avctx->draw_horiz_band(avctx, frame, offset, 0, 3, frame->height);
+    }
+    return ret;
 }
 
 static av_cold int hap_init(AVCodecContext *avctx)
@@ -349,14 +223,22 @@ static av_cold int hap_init(AVCodecContext *avctx)
         return ret;
     }
 
-    /* Since codec is based on 4x4 blocks, size is aligned to 4 */
-    avctx->coded_width  = FFALIGN(avctx->width,  TEXTURE_BLOCK_W);
-    avctx->coded_height = FFALIGN(avctx->height, TEXTURE_BLOCK_H);
+    /* Since codec is based on 4x4 blocks, size is aligned to 4. With lowres
+     * the output size is already reduced, the texture size is the coded one. */
+    if (avctx->lowres) {
+        avctx->coded_width  = FFALIGN(avctx->coded_width,  TEXTURE_BLOCK_W);
+        avctx->coded_height = FFALIGN(avctx->coded_height, TEXTURE_BLOCK_H);
+    } else {
+        avctx->coded_width  = FFALIGN(avctx->width,  TEXTURE_BLOCK_W);
+        avctx->coded_height = FFALIGN(avctx->height, TEXTURE_BLOCK_H);
+    }
 
     ff_texturedsp_init(&dxtc);
 
     ctx->texture_count  = 1;
     ctx->dec[0].raw_ratio = 16;
+    ctx->dec[0].lowres    = avctx->lowres;
+    ctx->dec[1].lowres    = avctx->lowres;
     ctx->dec[0].slice_count = av_clip(avctx->thread_count, 1,
                                       avctx->coded_height / TEXTURE_BLOCK_H);
 
@@ -431,8 +313,9 @@ const FFCodec ff_hap_decoder = {
     FF_CODEC_DECODE_CB(hap_decode),
     .close          = hap_close,
     .priv_data_size = sizeof(HapContext),
+    .p.max_lowres   = 2,
     .p.capabilities = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS |
-                      AV_CODEC_CAP_DR1,
+                      AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DRAW_HORIZ_BAND,
     .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP,
     .codec_tags     = (const uint32_t []){
         MKTAG('H','a','p','1'),
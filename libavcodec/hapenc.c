@@ -29,13 +29,19 @@
  * https://github.com/Vidvox/hap/blob/master/documentation/HapVideoDRAFT.md
  */
 
+#include <errno.h>
 #include <stdint.h>
+#include <stdio.h>
 #include "snappy-c.h"
 
+#include "libavutil/bprint.h"
+#include "libavutil/dict.h"
+#include "libavutil/file_open.h"
 #include "libavutil/frame.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
+#include "libavutil/time.h"
 
 #include "avcodec.h"
 #include "bytestream.h"
@@ -45,20 +51,77 @@
 #include "hap.h"
 #include "texturedsp.h"
 
-#define HAP_MAX_CHUNKS 64
+/* Per-frame statistics, exported when stats_side_data or stats_file is set */
+typedef struct HapEncStats {
+    FILE *file;
+    int64_t frame_num;
+    int64_t block_time;                       /* microseconds */
+    int64_t snappy_time;                      /* microseconds */
+    int chunk_count[2];
+    uint32_t chunk_size[2][HAP_MAX_CHUNKS];   /* stored size of each chunk */
+    uint8_t chunk_raw[2][HAP_MAX_CHUNKS];     /* chunk fell back to HAP_COMP_NONE */
+    uint32_t bc7_modes[9];                    /* 8 counts blocks with no valid mode */
+} HapEncStats;
+
+/* Same slicing as texturedsp_template.c, but blocks whose source pixels
+ * match the previous frame keep the compressed data already in the
+ * texture buffer. Block compression only depends on the block itself,
+ * so the output is identical to compressing every block. */
+static int compress_reuse_slice(AVCodecContext *avctx, void *arg,
+                                int slice, int thread_nb)
+{
+    HapContext *ctx = avctx->priv_data;
+    const TextureDSPThreadContext *enc = arg;
+    const AVFrame *prev = ctx->prev_frame;
+    uint8_t *d = enc->tex_data.out;
+    int w_block = enc->width  / TEXTURE_BLOCK_W;
+    int h_block = enc->height / TEXTURE_BLOCK_H;
+    int base_blocks_per_slice = h_block / enc->slice_count;
+    int remainder_blocks = h_block % enc->slice_count;
+    int start_slice, end_slice;
+    int x, y, i, reused = 0;
+
+    start_slice = slice * base_blocks_per_slice + FFMIN(slice, remainder_blocks);
+    end_slice   = start_slice + base_blocks_per_slice + (slice < remainder_blocks);
+
+    for (y = start_slice; y < end_slice; y++) {
+        const uint8_t *p = enc->frame_data.in + y * enc->stride * TEXTURE_BLOCK_H;
+        const uint8_t *q = prev->data[0] + y * prev->linesize[0] * TEXTURE_BLOCK_H;
+        int off = y * w_block;
+        for (x = 0; x < w_block; x++) {
+            const uint8_t *src = p + x * enc->raw_ratio;
+            const uint8_t *ref = q + x * enc->raw_ratio;
+
+            for (i = 0; i < TEXTURE_BLOCK_H; i++)
+                if (memcmp(src + i * enc->stride, ref + i * prev->linesize[0],
+                           enc->raw_ratio))
+                    break;
+            if (i == TEXTURE_BLOCK_H) {
+                reused++;
+                continue;
+            }
+            enc->tex_funct(d + (off + x) * enc->tex_ratio, enc->stride, src);
+        }
+    }
+    ctx->reused_blocks[slice] += reused;
 
-enum HapHeaderLength {
-    /* Short header: four bytes with a 24 bit size value */
-    HAP_HDR_SHORT = 4,
-    /* Long header: eight bytes with a 32 bit size value */
-    HAP_HDR_LONG = 8,
-};
+    return 0;
+}
+
+static int exec_compress_threads(AVCodecContext *avctx, TextureDSPThreadContext *enc)
+{
+    HapContext *ctx = avctx->priv_data;
 
-#define HAP_UINT24_MAX 0x00FFFFFF
+    if (!ctx->opt_reuse_blocks || !ctx->prev_frame->buf[0])
+        return ff_texturedsp_exec_compress_threads(avctx, enc);
+
+    return avctx->execute2(avctx, compress_reuse_slice, enc, NULL, enc->slice_count);
+}
 
 static int compress_texture(AVCodecContext *avctx, uint8_t *out, int out_length, const AVFrame *f)
 {
     HapContext *ctx = avctx->priv_data;
+    int64_t start = ctx->stats ? av_gettime_relative() : 0;
     int t;
 
     if (ctx->texture_count == 2) {
@@ -77,7 +140,7 @@ static int compress_texture(AVCodecContext *avctx, uint8_t *out, int out_length,
         ctx->enc[0].stride = f->linesize[0];
         ctx->enc[0].width  = avctx->width;
         ctx->enc[0].height = avctx->height;
-        ff_texturedsp_exec_compress_threads(avctx, &ctx->enc[0]);
+        exec_compress_threads(avctx, &ctx->enc[0]);
 
         /* Encode RGTC1 alpha texture */
         ctx->enc[1].tex_data.out = out + tex_size_ycocg;
@@ -85,7 +148,7 @@ static int compress_texture(AVCodecContext *avctx, uint8_t *out, int out_length,
         ctx->enc[1].stride = f->linesize[0];
         ctx->enc[1].width  = avctx->width;
         ctx->enc[1].height = avctx->height;
-        ff_texturedsp_exec_compress_threads(avctx, &ctx->enc[1]);
+        exec_compress_threads(avctx, &ctx->enc[1]);
 
         ctx->tex_size_alpha = tex_size_alpha;
     } else {
@@ -98,33 +161,19 @@ static int compress_texture(AVCodecContext *avctx, uint8_t *out, int out_length,
         ctx->enc[0].stride = f->linesize[0];
         ctx->enc[0].width  = avctx->width;
         ctx->enc[0].height = avctx->height;
-        ff_texturedsp_exec_compress_threads(avctx, &ctx->enc[0]);
+        exec_compress_threads(avctx, &ctx->enc[0]);
     }
 
-    return 0;
-}
+    if (ctx->stats)
+        ctx->stats->block_time += av_gettime_relative() - start;
 
-/* section_length does not include the header */
-static void hap_write_section_header(PutByteContext *pbc,
-                                     enum HapHeaderLength header_length,
-                                     int section_length,
-                                     enum HapSectionType section_type)
-{
-    /* The first three bytes are the length of the section (not including the
-     * header) or zero if using an eight-byte header.
-     * For an eight-byte header, the length is in the last four bytes.
-     * The fourth byte stores the section type. */
-    bytestream2_put_le24(pbc, header_length == HAP_HDR_LONG ? 0 : section_length);
-    bytestream2_put_byte(pbc, section_type);
-
-    if (header_length == HAP_HDR_LONG) {
-        bytestream2_put_le32(pbc, section_length);
-    }
+    return 0;
 }
 
 static int hap_compress_frame(AVCodecContext *avctx, uint8_t *dst)
 {
     HapContext *ctx = avctx->priv_data;
+    int64_t start = ctx->stats ? av_gettime_relative() : 0;
     int i, final_size = 0;
 
     for (i = 0; i < ctx->chunk_count; i++) {
@@ -145,104 +194,167 @@ static int hap_compress_frame(AVCodecContext *avctx, uint8_t *dst)
         chunk_dst = dst + chunk->compressed_offset;
 
         /* Compress with snappy too, write directly on packet buffer. */
-        ret = snappy_compress(chunk_src, chunk->uncompressed_size,
-                              chunk_dst, &chunk->compressed_size);
-        if (ret != SNAPPY_OK) {
-            av_log(avctx, AV_LOG_ERROR, "Snappy compress error.\n");
-            return AVERROR_BUG;
-        }
-
-        /* If there is no gain from snappy, just use the raw texture. */
-        if (chunk->compressed_size >= chunk->uncompressed_size) {
-            av_log(avctx, AV_LOG_VERBOSE,
-                   "Snappy buffer bigger than uncompressed (%"SIZE_SPECIFIER" >= %"SIZE_SPECIFIER" bytes).\n",
-                   chunk->compressed_size, chunk->uncompressed_size);
-            memcpy(chunk_dst, chunk_src, chunk->uncompressed_size);
-            chunk->compressor = HAP_COMP_NONE;
-            chunk->compressed_size = chunk->uncompressed_size;
-        } else {
-            chunk->compressor = HAP_COMP_SNAPPY;
-        }
+        ret = ff_hap_compress_chunk(avctx, chunk, chunk_src, chunk_dst);
+        if (ret < 0)
+            return ret;
 
         final_size += chunk->compressed_size;
     }
 
+    if (ctx->stats)
+        ctx->stats->snappy_time += av_gettime_relative() - start;
+
     return final_size;
 }
 
-static int hap_decode_instructions_length(int chunk_count)
+static void stats_record_texture(HapContext *ctx, int t, const uint8_t *tex,
+                                 size_t tex_size)
 {
-    /*    Second-Stage Compressor Table (one byte per entry)
-     *  + Chunk Size Table (four bytes per entry)
-     *  + headers for both sections (short versions)
-     *  = chunk_count + (4 * chunk_count) + 4 + 4 */
-    return (5 * chunk_count) + 8;
-}
+    HapEncStats *stats = ctx->stats;
+    int i;
 
-static enum HapHeaderLength hap_section_header_length(size_t section_length)
-{
-    return section_length > HAP_UINT24_MAX ? HAP_HDR_LONG : HAP_HDR_SHORT;
+    if (!stats)
+        return;
+
+    stats->chunk_count[t] = ctx->chunk_count;
+    for (i = 0; i < ctx->chunk_count; i++) {
+        stats->chunk_size[t][i] = ctx->chunks[i].compressed_size;
+        stats->chunk_raw[t][i]  = ctx->chunks[i].compressor == HAP_COMP_NONE &&
+                                  ctx->opt_compressor != HAP_COMP_NONE;
+    }
+
+    /* The BC7 mode is given by the position of the lowest set bit of the
+     * first byte of each block. */
+    if (ctx->opt_tex_fmt == HAP_FMT_BPTC) {
+        for (i = 0; i < tex_size; i += 16) {
+            int b = tex[i];
+            stats->bc7_modes[b ? ff_ctz(b) : 8]++;
+        }
+    }
 }
 
-static size_t hap_texture_section_length(int chunk_count, size_t payload_size)
+static int stats_export(AVCodecContext *avctx, AVPacket *pkt)
 {
-    size_t length = payload_size;
+    HapContext *ctx = avctx->priv_data;
+    HapEncStats *stats = ctx->stats;
+    static const char *const names[2] = { "", "_alpha" };
+    AVDictionary *dict = NULL;
+    AVBPrint sizes, raw;
+    char key[32];
+    int64_t block_us, snappy_us;
+    int i, t, ret = 0;
+
+    if (!stats)
+        return 0;
 
-    if (chunk_count > 1)
-        length += HAP_HDR_SHORT + hap_decode_instructions_length(chunk_count);
+    /* Timings are never reproducible */
+    block_us  = avctx->flags & AV_CODEC_FLAG_BITEXACT ? 0 : stats->block_time;
+    snappy_us = avctx->flags & AV_CODEC_FLAG_BITEXACT ? 0 : stats->snappy_time;
 
-    return length;
-}
+    av_bprint_init(&sizes, 0, AV_BPRINT_SIZE_AUTOMATIC);
+    av_bprint_init(&raw,   0, AV_BPRINT_SIZE_AUTOMATIC);
 
-static int hap_texture_section_header_length(int chunk_count,
-                                             enum HapHeaderLength header_length)
-{
-    int length = header_length;
+    if (stats->file)
+        fprintf(stats->file, "n:%"PRId64" size:%d block_us:%"PRId64" snappy_us:%"PRId64,
+                stats->frame_num, pkt->size, block_us, snappy_us);
 
-    if (chunk_count > 1)
-        length += HAP_HDR_SHORT + hap_decode_instructions_length(chunk_count);
+    if ((ret = av_dict_set_int(&dict, "hap.block_us",  block_us,  0)) < 0 ||
+        (ret = av_dict_set_int(&dict, "hap.snappy_us", snappy_us, 0)) < 0)
+        goto end;
 
-    return length;
-}
+    for (t = 0; t < ctx->texture_count; t++) {
+        av_bprint_clear(&sizes);
+        av_bprint_clear(&raw);
+        for (i = 0; i < stats->chunk_count[t]; i++) {
+            av_bprintf(&sizes, "%s%"PRIu32, i ? "," : "", stats->chunk_size[t][i]);
+            if (stats->chunk_raw[t][i])
+                av_bprintf(&raw, "%s%d", raw.len ? "," : "", i);
+        }
+        if (!av_bprint_is_complete(&sizes) || !av_bprint_is_complete(&raw)) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
 
-static void hap_write_texture_header(HapContext *ctx, uint8_t *dst,
-                                     enum HapTextureFormat tex_fmt,
-                                     int chunk_count, int frame_length,
-                                     enum HapHeaderLength header_length)
-{
-    PutByteContext pbc;
-    int i;
+        snprintf(key, sizeof(key), "hap.chunk_sizes%s", names[t]);
+        ret = av_dict_set(&dict, key, sizes.str, 0);
+        if (ret < 0)
+            goto end;
+        snprintf(key, sizeof(key), "hap.raw_chunks%s", names[t]);
+        ret = av_dict_set(&dict, key, raw.str, 0);
+        if (ret < 0)
+            goto end;
 
-    bytestream2_init_writer(&pbc, dst, frame_length);
+        if (stats->file)
+            fprintf(stats->file, " chunk_sizes%s:%s raw_chunks%s:%s",
+                    names[t], sizes.str, names[t], raw.len ? raw.str : "-");
+    }
 
-    if (chunk_count == 1) {
-        /* Write a simple header */
-        hap_write_section_header(&pbc, header_length, frame_length - header_length,
-                                 ctx->chunks[0].compressor | tex_fmt);
-    } else {
-        /* Write a complex header with Decode Instructions Container */
-        hap_write_section_header(&pbc, header_length, frame_length - header_length,
-                                 HAP_COMP_COMPLEX | tex_fmt);
-        hap_write_section_header(&pbc, HAP_HDR_SHORT, hap_decode_instructions_length(chunk_count),
-                                 HAP_ST_DECODE_INSTRUCTIONS);
-        hap_write_section_header(&pbc, HAP_HDR_SHORT, chunk_count,
-                                 HAP_ST_COMPRESSOR_TABLE);
-
-        for (i = 0; i < chunk_count; i++) {
-            bytestream2_put_byte(&pbc, ctx->chunks[i].compressor >> 4);
+    if (ctx->opt_tex_fmt == HAP_FMT_BPTC) {
+        av_bprint_clear(&sizes);
+        for (i = 0; i < FF_ARRAY_ELEMS(stats->bc7_modes); i++)
+            av_bprintf(&sizes, "%s%"PRIu32, i ? "," : "", stats->bc7_modes[i]);
+        if (!av_bprint_is_complete(&sizes)) {
+            ret = AVERROR(ENOMEM);
+            goto end;
         }
+        ret = av_dict_set(&dict, "hap.bc7_modes", sizes.str, 0);
+        if (ret < 0)
+            goto end;
+        if (stats->file)
+            fprintf(stats->file, " bc7_modes:%s", sizes.str);
+    }
 
-        hap_write_section_header(&pbc, HAP_HDR_SHORT, chunk_count * 4,
-                                 HAP_ST_SIZE_TABLE);
+    if (stats->file)
+        fprintf(stats->file, "\n");
 
-        for (i = 0; i < chunk_count; i++) {
-            bytestream2_put_le32(&pbc, ctx->chunks[i].compressed_size);
+    if (ctx->opt_stats_side_data) {
+        size_t size;
+        uint8_t *data = av_packet_pack_dictionary(dict, &size);
+        if (!data) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        ret = av_packet_add_side_data(pkt, AV_PKT_DATA_STRINGS_METADATA, data, size);
+        if (ret < 0) {
+            av_free(data);
+            goto end;
         }
     }
+
+end:
+    stats->frame_num++;
+    stats->block_time = stats->snappy_time = 0;
+    memset(stats->bc7_modes, 0, sizeof(stats->bc7_modes));
+    av_dict_free(&dict);
+    av_bprint_finalize(&sizes, NULL);
+    av_bprint_finalize(&raw, NULL);
+    return ret;
 }
 
-static int hap_encode(AVCodecContext *avctx, AVPacket *pkt,
-                      const AVFrame *frame, int *got_packet)
+static int update_prev_frame(AVCodecContext *avctx, const AVFrame *frame)
+{
+    HapContext *ctx = avctx->priv_data;
+    int i;
+
+    if (!ctx->opt_reuse_blocks)
+        return 0;
+
+    for (i = 0; i < ctx->enc[0].slice_count; i++) {
+        ctx->total_reused += ctx->reused_blocks[i];
+        ctx->reused_blocks[i] = 0;
+    }
+    ctx->total_blocks += (int64_t)ctx->texture_count *
+                         (avctx->width  / TEXTURE_BLOCK_W) *
+                         (avctx->height / TEXTURE_BLOCK_H);
+
+    /* Keep a reference rather than a copy, the blocks of this frame are
+     * what the texture buffers now hold. */
+    av_frame_unref(ctx->prev_frame);
+    return av_frame_ref(ctx->prev_frame, frame);
+}
+
+static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
+                        const AVFrame *frame, int *got_packet)
 {
     HapContext *ctx = avctx->priv_data;
     int ret;
@@ -260,9 +372,9 @@ static int hap_encode(AVCodecContext *avctx, AVPacket *pkt,
         else
             max_payload = ctx->tex_size;
 
-        section_length = hap_texture_section_length(ctx->chunk_count, max_payload);
-        header_length = hap_section_header_length(section_length);
-        tex_header_len = hap_texture_section_header_length(ctx->chunk_count, header_length);
+        section_length = ff_hap_texture_section_length(ctx->chunk_count, max_payload);
+        header_length = ff_hap_section_header_length(section_length);
+        tex_header_len = ff_hap_texture_section_header_length(ctx->chunk_count, header_length);
         pktsize = (int)(max_payload + tex_header_len);
 
         /* Allocate maximum size packet, shrink later. */
@@ -270,7 +382,18 @@ static int hap_encode(AVCodecContext *avctx, AVPacket *pkt,
         if (ret < 0)
             return ret;
 
-        if (ctx->opt_compressor == HAP_COMP_NONE) {
+        if (ctx->opt_compressor == HAP_COMP_NONE && ctx->opt_reuse_blocks) {
+            /* Reused blocks are kept in tex_buf, compress there and copy. */
+            ret = compress_texture(avctx, ctx->tex_buf, ctx->tex_size, frame);
+            if (ret < 0)
+                return ret;
+            memcpy(pkt->data + tex_header_len, ctx->tex_buf, ctx->tex_size);
+
+            ctx->chunks[0].compressor = HAP_COMP_NONE;
+            ctx->chunks[0].compressed_offset = 0;
+            ctx->chunks[0].compressed_size = ctx->tex_size;
+            final_data_size = ctx->tex_size;
+        } else if (ctx->opt_compressor == HAP_COMP_NONE) {
             /* DXTC compression directly to the packet buffer. */
             ret = compress_texture(avctx, pkt->data + tex_header_len, pkt->size - tex_header_len, frame);
             if (ret < 0)
@@ -291,14 +414,21 @@ static int hap_encode(AVCodecContext *avctx, AVPacket *pkt,
             if (final_data_size < 0)
                 return final_data_size;
         }
+        stats_record_texture(ctx, 0,
+                             ctx->opt_compressor == HAP_COMP_NONE && !ctx->opt_reuse_blocks ?
+                             pkt->data + tex_header_len : ctx->tex_buf, ctx->tex_size);
 
         /* Write header at the start. */
-        hap_write_texture_header(ctx, pkt->data, ctx->opt_tex_fmt, ctx->chunk_count,
-                                 final_data_size + tex_header_len, header_length);
+        ff_hap_write_texture_header(ctx, pkt->data, ctx->opt_tex_fmt, ctx->chunk_count,
+                                    final_data_size + tex_header_len, header_length);
 
         av_shrink_packet(pkt, final_data_size + tex_header_len);
         *got_packet = 1;
-        return 0;
+
+        ret = stats_export(avctx, pkt);
+        if (ret < 0)
+            return ret;
+        return update_prev_frame(avctx, frame);
     } else {
         int chunk_count = ctx->chunk_count;
         size_t max_payload[2];
@@ -318,6 +448,7 @@ static int hap_encode(AVCodecContext *avctx, AVPacket *pkt,
         uint8_t *tex_buf_main = ctx->tex_buf;
         PutByteContext pbc;
         enum HapTextureFormat tex_formats[2] = { HAP_FMT_YCOCGDXT5, HAP_FMT_RGTC1 };
+        int64_t start;
 
         if (ctx->opt_compressor == HAP_COMP_SNAPPY) {
             max_payload[0] = ctx->max_snappy * chunk_count;
@@ -328,13 +459,13 @@ static int hap_encode(AVCodecContext *avctx, AVPacket *pkt,
         }
 
         for (int t = 0; t < ctx->texture_count; t++) {
-            section_length[t] = hap_texture_section_length(chunk_count, max_payload[t]);
-            tex_header_type[t] = hap_section_header_length(section_length[t]);
-            tex_header_len[t] = hap_texture_section_header_length(chunk_count, tex_header_type[t]);
+            section_length[t] = ff_hap_texture_section_length(chunk_count, max_payload[t]);
+            tex_header_type[t] = ff_hap_section_header_length(section_length[t]);
+            tex_header_len[t] = ff_hap_texture_section_header_length(chunk_count, tex_header_type[t]);
             top_section_length += tex_header_len[t] + max_payload[t];
         }
 
-        top_header_type = hap_section_header_length(top_section_length);
+        top_header_type = ff_hap_section_header_length(top_section_length);
         top_header_len = top_header_type;
         pktsize = top_header_len + top_section_length;
 
@@ -350,16 +481,22 @@ static int hap_encode(AVCodecContext *avctx, AVPacket *pkt,
             uint8_t *texture_dst = pkt->data + data_offset;
             size_t tex_size = t == 0 ? tex_size_main : tex_size_alpha;
 
-            enc->tex_data.out = (ctx->opt_compressor == HAP_COMP_NONE) ?
+            enc->tex_data.out = (ctx->opt_compressor == HAP_COMP_NONE &&
+                                 !ctx->opt_reuse_blocks) ?
                                 texture_dst :
                                 (t == 0 ? tex_buf_main : ctx->tex_buf_alpha);
             enc->frame_data.in = frame->data[0];
             enc->stride = frame->linesize[0];
             enc->width  = avctx->width;
             enc->height = avctx->height;
-            ff_texturedsp_exec_compress_threads(avctx, enc);
+            start = ctx->stats ? av_gettime_relative() : 0;
+            exec_compress_threads(avctx, enc);
+            if (ctx->stats)
+                ctx->stats->block_time += av_gettime_relative() - start;
 
             if (ctx->opt_compressor == HAP_COMP_NONE) {
+                if (ctx->opt_reuse_blocks)
+                    memcpy(texture_dst, enc->tex_data.out, tex_size);
                 ctx->chunks[0].compressor = HAP_COMP_NONE;
                 ctx->chunks[0].compressed_offset = 0;
                 ctx->chunks[0].compressed_size = tex_size;
@@ -370,22 +507,27 @@ static int hap_encode(AVCodecContext *avctx, AVPacket *pkt,
                 ctx->tex_buf = (t == 0) ? tex_buf_main : ctx->tex_buf_alpha;
 
                 compressed_size[t] = hap_compress_frame(avctx, texture_dst);
-                if (compressed_size[t] < 0)
+                if (compressed_size[t] < 0) {
+                    ctx->tex_size   = tex_size_main;
+                    ctx->max_snappy = max_snappy_main;
+                    ctx->tex_buf    = tex_buf_main;
                     return compressed_size[t];
+                }
             }
+            stats_record_texture(ctx, t, enc->tex_data.out, tex_size);
 
             if (tex_header_type[t] == HAP_HDR_SHORT &&
-                hap_texture_section_length(chunk_count, (size_t)compressed_size[t]) > HAP_UINT24_MAX) {
+                ff_hap_texture_section_length(chunk_count, (size_t)compressed_size[t]) > HAP_UINT24_MAX) {
                 av_log(avctx, AV_LOG_ERROR, "HapM texture section too large for short header.\n");
                 return AVERROR_INVALIDDATA;
             }
 
-            hap_write_texture_header(ctx,
-                                     pkt->data + header_offset,
-                                     tex_formats[t],
-                                     chunk_count,
-                                     compressed_size[t] + tex_header_len[t],
-                                     tex_header_type[t]);
+            ff_hap_write_texture_header(ctx,
+                                        pkt->data + header_offset,
+                                        tex_formats[t],
+                                        chunk_count,
+                                        compressed_size[t] + tex_header_len[t],
+                                        tex_header_type[t]);
 
             offset = data_offset + compressed_size[t];
         }
@@ -401,16 +543,34 @@ static int hap_encode(AVCodecContext *avctx, AVPacket *pkt,
         }
 
         bytestream2_init_writer(&pbc, pkt->data, offset);
-        hap_write_section_header(&pbc, top_header_type,
-                                 offset - top_header_len,
-                                 HAP_FMT_HAPM);
+        ff_hap_write_section_header(&pbc, top_header_type,
+                                    offset - top_header_len,
+                                    HAP_FMT_HAPM);
 
         av_shrink_packet(pkt, offset);
         *got_packet = 1;
-        return 0;
+
+        ret = stats_export(avctx, pkt);
+        if (ret < 0)
+            return ret;
+        return update_prev_frame(avctx, frame);
     }
 }
 
+static int hap_encode(AVCodecContext *avctx, AVPacket *pkt,
+                      const AVFrame *frame, int *got_packet)
+{
+    HapContext *ctx = avctx->priv_data;
+    int ret = encode_frame(avctx, pkt, frame, got_packet);
+
+    /* The texture buffers may have been partly overwritten, so they no
+     * longer hold the blocks of prev_frame: compress all of the next one. */
+    if (ret < 0 && ctx->prev_frame)
+        av_frame_unref(ctx->prev_frame);
+
+    return ret;
+}
+
 static av_cold int hap_init(AVCodecContext *avctx)
 {
     HapContext *ctx = avctx->priv_data;
@@ -431,9 +591,15 @@ static av_cold int hap_init(AVCodecContext *avctx)
         return AVERROR_INVALIDDATA;
     }
 
+    if (avctx->pix_fmt == AV_PIX_FMT_GRAY8 && ctx->opt_tex_fmt != HAP_FMT_RGTC1) {
+        av_log(avctx, AV_LOG_ERROR, "Gray input is only supported by Hap Alpha-Only.\n");
+        return AVERROR(EINVAL);
+    }
+
     ff_texturedspenc_init(&dxtc);
 
     ctx->texture_count = 1;  /* Default to single texture */
+    ctx->enc[0].raw_ratio = 16;
 
     switch (ctx->opt_tex_fmt) {
     case HAP_FMT_RGBDXT1:
@@ -468,7 +634,12 @@ static av_cold int hap_init(AVCodecContext *avctx)
         ctx->enc[0].tex_ratio = 8;
         avctx->codec_tag = MKTAG('H', 'a', 'p', 'A');
         avctx->bits_per_coded_sample = 8;
-        ctx->enc[0].tex_funct = dxtc.rgtc1u_gray_block;
+        if (avctx->pix_fmt == AV_PIX_FMT_GRAY8) {
+            ctx->enc[0].tex_funct = dxtc.rgtc1u_gray8_block;
+            ctx->enc[0].raw_ratio = 4;
+        } else {
+            ctx->enc[0].tex_funct = dxtc.rgtc1u_gray_block;
+        }
         break;
     case HAP_FMT_HAPM:
         /* HapM uses two textures: DXT5-YCoCg (16 bytes) + RGTC1 alpha (8 bytes) */
@@ -486,7 +657,6 @@ static av_cold int hap_init(AVCodecContext *avctx)
         av_log(avctx, AV_LOG_ERROR, "Invalid format %02X\n", ctx->opt_tex_fmt);
         return AVERROR_INVALIDDATA;
     }
-    ctx->enc[0].raw_ratio = 16;
     ctx->enc[0].slice_count = av_clip(avctx->thread_count, 1, avctx->height / TEXTURE_BLOCK_H);
 
     block_count = (avctx->width  / TEXTURE_BLOCK_W) *
@@ -509,13 +679,20 @@ static av_cold int hap_init(AVCodecContext *avctx)
         ctx->max_snappy_alpha = ctx->tex_size_alpha;
         ctx->tex_buf = NULL;
         ctx->tex_buf_alpha = NULL;
+        /* Block reuse needs the previous textures kept around */
+        if (ctx->opt_reuse_blocks) {
+            ctx->tex_buf = av_malloc(ctx->tex_size);
+            if (!ctx->tex_buf)
+                return AVERROR(ENOMEM);
+            if (ctx->texture_count == 2) {
+                ctx->tex_buf_alpha = av_malloc(ctx->tex_size_alpha);
+                if (!ctx->tex_buf_alpha)
+                    return AVERROR(ENOMEM);
+            }
+        }
         break;
     case HAP_COMP_SNAPPY:
-        /* Round the chunk count to divide evenly on DXT block edges */
-        corrected_chunk_count = av_clip(ctx->opt_chunk_count, 1, HAP_MAX_CHUNKS);
-        while (block_count % corrected_chunk_count != 0) {
-            corrected_chunk_count--;
-        }
+        corrected_chunk_count = ff_hap_chunk_count(ctx->opt_chunk_count, block_count);
 
         ctx->max_snappy = snappy_max_compressed_length(ctx->tex_size / corrected_chunk_count);
         ctx->tex_buf = av_malloc(ctx->tex_size);
@@ -543,6 +720,33 @@ static av_cold int hap_init(AVCodecContext *avctx)
     if (ret != 0)
         return ret;
 
+    if (ctx->opt_stats_side_data || ctx->opt_stats_file) {
+        ctx->stats = av_mallocz(sizeof(*ctx->stats));
+        if (!ctx->stats)
+            return AVERROR(ENOMEM);
+        if (ctx->opt_stats_file) {
+            if (!strcmp(ctx->opt_stats_file, "-")) {
+                ctx->stats->file = stdout;
+            } else {
+                ctx->stats->file = avpriv_fopen_utf8(ctx->opt_stats_file, "w");
+                if (!ctx->stats->file) {
+                    ret = AVERROR(errno);
+                    av_log(avctx, AV_LOG_ERROR, "Could not open stats file %s: %s\n",
+                           ctx->opt_stats_file, av_err2str(ret));
+                    return ret;
+                }
+            }
+        }
+    }
+
+    if (ctx->opt_reuse_blocks) {
+        ctx->prev_frame    = av_frame_alloc();
+        ctx->reused_blocks = av_calloc(ctx->enc[0].slice_count,
+                                       sizeof(*ctx->reused_blocks));
+        if (!ctx->prev_frame || !ctx->reused_blocks)
+            return AVERROR(ENOMEM);
+    }
+
     return 0;
 }
 
@@ -550,6 +754,15 @@ static av_cold int hap_close(AVCodecContext *avctx)
 {
     HapContext *ctx = avctx->priv_data;
 
+    if (ctx->total_blocks)
+        av_log(avctx, AV_LOG_VERBOSE, "Reused %"PRId64" of %"PRId64" blocks (%.1f%%).\n",
+               ctx->total_reused, ctx->total_blocks,
+               100.0 * ctx->total_reused / ctx->total_blocks);
+    av_frame_free(&ctx->prev_frame);
+    av_freep(&ctx->reused_blocks);
+    if (ctx->stats && ctx->stats->file && ctx->stats->file != stdout)
+        fclose(ctx->stats->file);
+    av_freep(&ctx->stats);
     ff_hap_free_context(ctx);
 
     return 0;
@@ -567,6 +780,9 @@ static const AVOption options[] = {
         { "hap_m",     "Hap M (DXT5-YCoCg + RGTC1 alpha)", 0, AV_OPT_TYPE_CONST, { .i64 = HAP_FMT_HAPM }, 0, 0, FLAGS, .unit = "format" },
     { "bc7_uber", "BC7 quality level (Hap R only)", OFFSET(opt_bc7_uber_level), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, BC7ENC_MAX_UBER_LEVEL, FLAGS },
     { "chunks", "chunk count", OFFSET(opt_chunk_count), AV_OPT_TYPE_INT, {.i64 = 1 }, 1, HAP_MAX_CHUNKS, FLAGS, },
+    { "reuse_blocks", "reuse the compressed data of blocks unchanged since the previous frame", OFFSET(opt_reuse_blocks), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
+    { "stats_side_data", "export per-frame statistics as packet side data", OFFSET(opt_stats_side_data), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
+    { "stats_file", "write per-frame statistics to a file", OFFSET(opt_stats_file), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, FLAGS },
     { "compressor", "second-stage compressor", OFFSET(opt_compressor), AV_OPT_TYPE_INT, { .i64 = HAP_COMP_SNAPPY }, HAP_COMP_NONE, HAP_COMP_SNAPPY, FLAGS, .unit = "compressor" },
         { "none",       "None", 0, AV_OPT_TYPE_CONST, { .i64 = HAP_COMP_NONE }, 0, 0, FLAGS, .unit = "compressor" },
         { "snappy",     "Snappy", 0, AV_OPT_TYPE_CONST, { .i64 = HAP_COMP_SNAPPY }, 0, 0, FLAGS, .unit = "compressor" },
@@ -28,6 +28,7 @@
 #include <limits.h>
 #include <stdint.h>
 
+#include "libavutil/buffer.h"
 #include "libavutil/opt.h"
 #include "avcodec.h"
 #include "version_major.h"
@@ -406,6 +407,11 @@ static const AVOption avcodec_options[] = {
     {"mastering_display_metadata",  .default_val.i64 = AV_PKT_DATA_MASTERING_DISPLAY_METADATA,  .type = AV_OPT_TYPE_CONST, .flags = A|D, .unit = "side_data_pkt" },
     {"content_light_level",         .default_val.i64 = AV_PKT_DATA_CONTENT_LIGHT_LEVEL,         .type = AV_OPT_TYPE_CONST, .flags = A|D, .unit = "side_data_pkt" },
     {"icc_profile",                 .default_val.i64 = AV_PKT_DATA_ICC_PROFILE,                 .type = AV_OPT_TYPE_CONST, .flags = A|D, .unit = "side_data_pkt" },
+{"buffer_pool_flags", "allocation flags for the default frame buffer pools", OFFSET(buffer_pool_flags), AV_OPT_TYPE_FLAGS, {.i64 = 0 }, 0, INT_MAX, V|A|D, .unit = "buffer_pool_flags"},
+{"prefault",   "fault the pages of a buffer in when it is allocated", 0, AV_OPT_TYPE_CONST, {.i64 = AV_BUFFER_POOL_FLAG_PREFAULT },   INT_MIN, INT_MAX, V|A|D, .unit = "buffer_pool_flags"},
+{"hugepages",  "use transparent huge pages",                          0, AV_OPT_TYPE_CONST, {.i64 = AV_BUFFER_POOL_FLAG_HUGEPAGES },  INT_MIN, INT_MAX, V|A|D, .unit = "buffer_pool_flags"},
+{"hugetlb",    "use reserved huge pages",                             0, AV_OPT_TYPE_CONST, {.i64 = AV_BUFFER_POOL_FLAG_HUGETLB },    INT_MIN, INT_MAX, V|A|D, .unit = "buffer_pool_flags"},
+{"numa_local", "prefer the NUMA node of the allocating thread",       0, AV_OPT_TYPE_CONST, {.i64 = AV_BUFFER_POOL_FLAG_NUMA_LOCAL }, INT_MIN, INT_MAX, V|A|D, .unit = "buffer_pool_flags"},
 {NULL},
 };
 
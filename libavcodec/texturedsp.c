@@ -24,12 +24,15 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "libavutil/attributes.h"
 #include "libavutil/common.h"
+#include "libavutil/frame.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/libm.h"
 
+#include "avcodec.h"
 #include "texturedsp.h"
 
 #define RGBA(r, g, b, a) (((uint8_t)(r) <<  0) | \
@@ -656,6 +659,70 @@ av_cold void ff_texturedsp_init(TextureDSPContext *c)
     c->dxn3dc_block       = dxn3dc_block;
 }
 
+/**
+ * Decompress a row of blocks at reduced resolution, averaging each 4x4
+ * block down to (4 >> lowres)^2 pixels in the output.
+ */
+static void decompress_row_lowres(const TextureDSPThreadContext *ctx,
+                                  uint8_t *dst, const uint8_t *src, int w_block)
+{
+    const int lowres  = ctx->lowres;
+    const int bpp     = ctx->raw_ratio / TEXTURE_BLOCK_W;
+    const int out_w   = TEXTURE_BLOCK_W >> lowres;
+    const int out_h   = TEXTURE_BLOCK_H >> lowres;
+    const int shift   = 2 * lowres;
+    const ptrdiff_t stride = ctx->stride;
+    uint8_t block[TEXTURE_BLOCK_H * TEXTURE_BLOCK_W * 4];
+
+    for (int x = 0; x < w_block; x++) {
+        uint8_t *p = dst + x * out_w * bpp;
+
+        /* Some functions only write a single channel (e.g. the alpha plane
+         * of HapM), so the other ones have to keep the current values. */
+        for (int i = 0; i < TEXTURE_BLOCK_H; i++)
+            for (int j = 0; j < TEXTURE_BLOCK_W; j++)
+                memcpy(block + i * ctx->raw_ratio + j * bpp,
+                       p + (i >> lowres) * stride + (j >> lowres) * bpp, bpp);
+
+        ctx->tex_funct(block, ctx->raw_ratio, src + x * ctx->tex_ratio);
+
+        for (int i = 0; i < out_h; i++) {
+            for (int j = 0; j < out_w * bpp; j++) {
+                const uint8_t *b = block + (i << lowres) * ctx->raw_ratio +
+                                   (j / bpp << lowres) * bpp + j % bpp;
+                int sum = 0;
+                for (int k = 0; k < 1 << lowres; k++)
+                    for (int l = 0; l < 1 << lowres; l++)
+                        sum += b[k * ctx->raw_ratio + l * bpp];
+                p[i * stride + j] = (sum + (1 << shift >> 1)) >> shift;
+            }
+        }
+    }
+}
+
+/**
+ * Report a decompressed row of blocks, clipped to the frame height, as
+ * ready to the user. Rows are reported from the slice threads, so possibly
+ * out of order, as allowed for draw_horiz_band().
+ */
+static void draw_band(AVCodecContext *avctx, const TextureDSPThreadContext *ctx,
+                      int row)
+{
+    const AVFrame *frame = ctx->band_frame;
+    const int block_h = TEXTURE_BLOCK_H >> ctx->lowres;
+    int offset[AV_NUM_DATA_POINTERS] = { 0 };
+    int y = row * block_h;
+    int h = FFMIN(block_h, frame->height - y);
+
+    if (h <= 0)
+        return;
+
+    offset[0] = y * frame->linesize[0];
+    avctx->draw_horiz_band(avctx, frame, offset, y, 3, h);
+}
+
+#define TEXTUREDSP_BAND_FUNC draw_band
+#define TEXTUREDSP_LOWRES_FUNC decompress_row_lowres
 #define TEXTUREDSP_FUNC_NAME ff_texturedsp_exec_decompress_threads
 #define TEXTUREDSP_TEX_FUNC(a, b, c) tex_funct(a, b, c)
 #include "texturedsp_template.c"
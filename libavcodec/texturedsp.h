@@ -65,6 +65,7 @@ typedef struct TextureDSPEncContext {
     int (*dxt5_block)         (uint8_t *dst, ptrdiff_t stride, const uint8_t *block);
     int (*dxt5ys_block)       (uint8_t *dst, ptrdiff_t stride, const uint8_t *block);
     int (*rgtc1u_gray_block)  (uint8_t *dst, ptrdiff_t stride, const uint8_t *block);
+    int (*rgtc1u_gray8_block) (uint8_t *dst, ptrdiff_t stride, const uint8_t *block);
     int (*rgtc1u_alpha_block) (uint8_t *dst, ptrdiff_t stride, const uint8_t *block);
 } TextureDSPEncContext;
 
@@ -82,6 +83,10 @@ typedef struct TextureDSPThreadContext {
     int tex_ratio;               // Number of compressed bytes in a texture block
     int raw_ratio;               // Number bytes in a line of a raw block
     int slice_count;             // Number of slices for threaded operations
+    int lowres;                  // Decompress to 1/2^lowres of the size (0-2)
+    /* If set, every decompressed row of blocks is passed to
+     * avctx->draw_horiz_band() with this frame. */
+    const struct AVFrame *band_frame;
 
     /* Pointer to the selected compress or decompress function. */
     int (*tex_funct)(uint8_t *dst, ptrdiff_t stride, const uint8_t *block);
@@ -49,10 +49,21 @@ static int exec_func(AVCodecContext *avctx, void *arg,
     for (y = start_slice; y < end_slice; y++) {
         uint8_t *p = ctx->frame_data.out + y * ctx->stride * TEXTURE_BLOCK_H;
         int off = y * w_block;
+#ifdef TEXTUREDSP_LOWRES_FUNC
+        if (ctx->lowres) {
+            TEXTUREDSP_LOWRES_FUNC(ctx, ctx->frame_data.out +
+                                   y * ctx->stride * (TEXTURE_BLOCK_H >> ctx->lowres),
+                                   d + off * ctx->tex_ratio, w_block);
+        } else
+#endif
         for (x = 0; x < w_block; x++) {
             ctx->TEXTUREDSP_TEX_FUNC(p + x * ctx->raw_ratio, ctx->stride,
                                      d + (off + x) * ctx->tex_ratio);
         }
+#ifdef TEXTUREDSP_BAND_FUNC
+        if (ctx->band_frame)
+            TEXTUREDSP_BAND_FUNC(avctx, ctx, y);
+#endif
     }
 
     return 0;
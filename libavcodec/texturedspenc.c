@@ -676,6 +676,29 @@ static int rgtc1u_gray_block(uint8_t *dst, ptrdiff_t stride, const uint8_t *bloc
     return 8;
 }
 
+/**
+ * Compress one block of 8-bit grayscale pixels in an RGTC1 texture (BC4)
+ * and store the resulting bytes in 'dst'.
+ *
+ * @param dst    output buffer.
+ * @param stride scanline in bytes.
+ * @param block  block to compress.
+ * @return how much texture data has been written.
+ */
+static int rgtc1u_gray8_block(uint8_t *dst, ptrdiff_t stride, const uint8_t *block)
+{
+    int x, y;
+    uint8_t reorder[64];
+
+    for (y = 0; y < 4; y++)
+        for (x = 0; x < 4; x++)
+            reorder[3 + x * 4 + y * 16] = block[x + y * stride];
+
+    compress_alpha(dst, 16, reorder);
+
+    return 8;
+}
+
 /**
  * Compress one block of alpha channel pixels in an RGTC1 texture (BC4) and store the
  * resulting bytes in 'dst'. This extracts and compresses the alpha channel.
@@ -698,6 +721,7 @@ av_cold void ff_texturedspenc_init(TextureDSPEncContext *c)
     c->dxt5_block         = dxt5_block;
     c->dxt5ys_block       = dxt5ys_block;
     c->rgtc1u_gray_block  = rgtc1u_gray_block;
+    c->rgtc1u_gray8_block = rgtc1u_gray8_block;
     c->rgtc1u_alpha_block = rgtc1u_alpha_block;
 }
 
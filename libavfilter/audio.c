@@ -49,10 +49,11 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
     FilterLinkInternal *const li = ff_link_internal(link);
     int channels = link->ch_layout.nb_channels;
     int align = av_cpu_max_align();
+    int pool_flags = li->l.graph ? li->l.graph->buffer_pool_flags : 0;
 
     if (!li->frame_pool) {
-        li->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, channels,
-                                                  nb_samples, link->format, align);
+        li->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, pool_flags,
+                                                  channels, nb_samples, link->format, align);
         if (!li->frame_pool)
             return NULL;
     } else {
@@ -71,8 +72,8 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
             pool_format != link->format || pool_align != align) {
 
             ff_frame_pool_uninit(&li->frame_pool);
-            li->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, channels,
-                                                      nb_samples, link->format, align);
+            li->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, pool_flags,
+                                                      channels, nb_samples, link->format, align);
             if (!li->frame_pool)
                 return NULL;
         }
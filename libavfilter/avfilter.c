@@ -42,6 +42,7 @@
 #include "formats.h"
 #include "framequeue.h"
 #include "framepool.h"
+#include "frameprogress.h"
 #include "video.h"
 
 static void tlog_ref(void *ctx, AVFrame *ref, int end)
@@ -1496,9 +1497,16 @@ int ff_inlink_check_available_samples(AVFilterLink *link, unsigned min)
     return samples >= min || (li->status_in && samples);
 }
 
-static void consume_update(FilterLinkInternal *li, const AVFrame *frame)
+static int accepts_incomplete_frames(const AVFilterLink *link)
+{
+    return fffilter(link->dst->filter)->flags_internal & FF_FILTER_FLAG_INCOMPLETE_FRAMES;
+}
+
+static void consume_update(FilterLinkInternal *li, AVFrame *frame)
 {
     AVFilterLink *const link = &li->l.pub;
+    if (frame->private_ref && !accepts_incomplete_frames(link))
+        ff_frame_complete(frame);
     update_link_current_pts(li, frame->pts);
     ff_inlink_process_commands(link, frame);
     if (link == link->dst->inputs[0])
@@ -1551,7 +1559,10 @@ int ff_inlink_consume_samples(AVFilterLink *link, unsigned min, unsigned max,
 AVFrame *ff_inlink_peek_frame(AVFilterLink *link, size_t idx)
 {
     FilterLinkInternal * const li = ff_link_internal(link);
-    return ff_framequeue_peek(&li->fifo, idx);
+    AVFrame *frame = ff_framequeue_peek(&li->fifo, idx);
+    if (frame->private_ref && !accepts_incomplete_frames(link))
+        ff_frame_complete(frame);
+    return frame;
 }
 
 int ff_inlink_make_frame_writable(AVFilterLink *link, AVFrame **rframe)
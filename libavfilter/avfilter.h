@@ -637,6 +637,15 @@ typedef struct AVFilterGraph {
      * avfilter_graph_config().
      */
     unsigned max_buffered_frames;
+
+    /**
+     * Allocation flags for the frame buffer pools of the links in the graph,
+     * a combination of AV_BUFFER_POOL_FLAG_*. See av_buffer_pool_init_flags().
+     *
+     * This field must be set before the graph allocates frames, i.e. before
+     * the first frame is sent to it.
+     */
+    int buffer_pool_flags;
 } AVFilterGraph;
 
 /**
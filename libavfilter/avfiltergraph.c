@@ -58,6 +58,16 @@ static const AVOption filtergraph_options[] = {
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|A },
     {"max_buffered_frames"  , "maximum number of buffered frames allowed", OFFSET(max_buffered_frames),
         AV_OPT_TYPE_UINT,   {.i64 = 0}, 0, UINT_MAX, F|V|A },
+    {"buffer_pool_flags"    , "allocation flags for the frame buffer pools", OFFSET(buffer_pool_flags),
+        AV_OPT_TYPE_FLAGS,  {.i64 = 0}, 0, INT_MAX, F|V|A, .unit = "buffer_pool_flags" },
+        {"prefault",   "fault the pages of a buffer in when it is allocated", 0, AV_OPT_TYPE_CONST,
+            {.i64 = AV_BUFFER_POOL_FLAG_PREFAULT},   .flags = F|V|A, .unit = "buffer_pool_flags" },
+        {"hugepages",  "use transparent huge pages",                          0, AV_OPT_TYPE_CONST,
+            {.i64 = AV_BUFFER_POOL_FLAG_HUGEPAGES},  .flags = F|V|A, .unit = "buffer_pool_flags" },
+        {"hugetlb",    "use reserved huge pages",                             0, AV_OPT_TYPE_CONST,
+            {.i64 = AV_BUFFER_POOL_FLAG_HUGETLB},    .flags = F|V|A, .unit = "buffer_pool_flags" },
+        {"numa_local", "prefer the NUMA node of the allocating thread",       0, AV_OPT_TYPE_CONST,
+            {.i64 = AV_BUFFER_POOL_FLAG_NUMA_LOCAL}, .flags = F|V|A, .unit = "buffer_pool_flags" },
     { NULL },
 };
 
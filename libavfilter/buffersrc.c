@@ -25,6 +25,8 @@
 
 #include <float.h>
 
+#include "config.h"
+
 #include "libavutil/channel_layout.h"
 #include "libavutil/frame.h"
 #include "libavutil/hwcontext.h"
@@ -32,15 +34,28 @@
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/refstruct.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/thread.h"
 #include "libavutil/timestamp.h"
 #include "avfilter.h"
 #include "avfilter_internal.h"
 #include "buffersrc.h"
 #include "filters.h"
 #include "formats.h"
+#include "frameprogress.h"
 #include "video.h"
 
+/**
+ * A frame that rows have been reported for, or that has been added with
+ * AV_BUFFERSRC_FLAG_INCOMPLETE, and that is not complete yet.
+ */
+typedef struct IncompleteFrame {
+    const AVBuffer  *key;       ///< frame->buf[0]->buffer
+    FFFrameProgress *progress;
+    int              added;
+} IncompleteFrame;
+
 typedef struct BufferSourceContext {
     const AVClass    *class;
     AVRational        time_base;     ///< time_base to set in the output link
@@ -56,6 +71,11 @@ typedef struct BufferSourceContext {
 
     AVBufferRef *hw_frames_ctx;
 
+    AVMutex          incomplete_lock;
+    int              incomplete_lock_init;
+    IncompleteFrame *incomplete;
+    int              nb_incomplete;
+
     /* audio only */
     int sample_rate;
     enum AVSampleFormat sample_fmt;
@@ -187,6 +207,95 @@ int attribute_align_arg av_buffersrc_add_frame(AVFilterContext *ctx, AVFrame *fr
     return av_buffersrc_add_frame_flags(ctx, frame, 0);
 }
 
+/**
+ * Find the entry for a frame, creating it if there is none.
+ * Must be called with incomplete_lock held.
+ */
+static IncompleteFrame *get_incomplete_frame(BufferSourceContext *s,
+                                             const AVFrame *frame)
+{
+    const AVBuffer *key = frame->buf[0]->buffer;
+    IncompleteFrame *f;
+
+    for (int i = 0; i < s->nb_incomplete; i++)
+        if (s->incomplete[i].key == key)
+            return &s->incomplete[i];
+
+    f = av_dynarray2_add((void **)&s->incomplete, &s->nb_incomplete,
+                         sizeof(*s->incomplete), NULL);
+    if (!f)
+        return NULL;
+
+    f->key      = key;
+    f->added    = 0;
+    f->progress = ff_frame_progress_alloc(frame->height);
+    if (!f->progress) {
+        s->nb_incomplete--;
+        return NULL;
+    }
+    return f;
+}
+
+static void remove_incomplete_frame(BufferSourceContext *s, IncompleteFrame *f)
+{
+    av_refstruct_unref(&f->progress);
+    *f = s->incomplete[--s->nb_incomplete];
+}
+
+int av_buffersrc_report_slice(AVFilterContext *ctx, const AVFrame *frame,
+                              int y, int height)
+{
+    BufferSourceContext *s = ctx->priv;
+    IncompleteFrame *f;
+    int ret = 0;
+
+    if (ctx->outputs[0]->type != AVMEDIA_TYPE_VIDEO || !frame->buf[0])
+        return AVERROR(EINVAL);
+    if (!HAVE_THREADS)
+        return AVERROR(ENOSYS);
+
+    ff_mutex_lock(&s->incomplete_lock);
+    f = get_incomplete_frame(s, frame);
+    if (f) {
+        ff_frame_progress_report(f->progress, y, height);
+        if (f->added && ff_frame_progress_done(f->progress))
+            remove_incomplete_frame(s, f);
+    } else {
+        ret = AVERROR(ENOMEM);
+    }
+    ff_mutex_unlock(&s->incomplete_lock);
+
+    return ret;
+}
+
+/**
+ * Get a reference to the progress of a frame added with
+ * AV_BUFFERSRC_FLAG_INCOMPLETE, or NULL if all its rows have already
+ * been reported.
+ */
+static int get_progress(BufferSourceContext *s, const AVFrame *frame,
+                        FFFrameProgress **progress)
+{
+    IncompleteFrame *f;
+    int ret = 0;
+
+    *progress = NULL;
+
+    ff_mutex_lock(&s->incomplete_lock);
+    f = get_incomplete_frame(s, frame);
+    if (!f) {
+        ret = AVERROR(ENOMEM);
+    } else if (ff_frame_progress_done(f->progress)) {
+        remove_incomplete_frame(s, f);
+    } else {
+        f->added = 1;
+        *progress = av_refstruct_ref(f->progress);
+    }
+    ff_mutex_unlock(&s->incomplete_lock);
+
+    return ret;
+}
+
 static int push_frame(AVFilterGraph *graph)
 {
     int ret;
@@ -204,6 +313,7 @@ static int push_frame(AVFilterGraph *graph)
 int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFrame *frame, int flags)
 {
     BufferSourceContext *s = ctx->priv;
+    FFFrameProgress *progress = NULL;
     AVFrame *copy;
     int refcounted, ret;
 
@@ -218,6 +328,13 @@ int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFra
 
     refcounted = !!frame->buf[0];
 
+    if (flags & AV_BUFFERSRC_FLAG_INCOMPLETE) {
+        if (ctx->outputs[0]->type != AVMEDIA_TYPE_VIDEO || !refcounted)
+            return AVERROR(EINVAL);
+        if (!HAVE_THREADS)
+            return AVERROR(ENOSYS);
+    }
+
     if (!(flags & AV_BUFFERSRC_FLAG_NO_CHECK_FORMAT)) {
 
         switch (ctx->outputs[0]->type) {
@@ -242,14 +359,24 @@ int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFra
 
     }
 
+    if (flags & AV_BUFFERSRC_FLAG_INCOMPLETE) {
+        ret = get_progress(s, frame, &progress);
+        if (ret < 0)
+            return ret;
+    }
+
     if (refcounted && !(flags & AV_BUFFERSRC_FLAG_KEEP_REF)) {
-        if (!(copy = av_frame_alloc()))
+        if (!(copy = av_frame_alloc())) {
+            av_refstruct_unref(&progress);
             return AVERROR(ENOMEM);
+        }
         av_frame_move_ref(copy, frame);
     } else {
         copy = av_frame_clone(frame);
-        if (!copy)
+        if (!copy) {
+            av_refstruct_unref(&progress);
             return AVERROR(ENOMEM);
+        }
     }
 
     if (copy->colorspace == AVCOL_SPC_UNSPECIFIED)
@@ -257,6 +384,9 @@ int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFra
     if (copy->color_range == AVCOL_RANGE_UNSPECIFIED)
         copy->color_range = ctx->outputs[0]->color_range;
 
+    if (progress)
+        copy->private_ref = progress;
+
     ret = ff_filter_frame(ctx->outputs[0], copy);
     if (ret < 0)
         return ret;
@@ -282,6 +412,12 @@ int av_buffersrc_close(AVFilterContext *ctx, int64_t pts, unsigned flags)
 static av_cold int init_video(AVFilterContext *ctx)
 {
     BufferSourceContext *c = ctx->priv;
+    int ret;
+
+    ret = ff_mutex_init(&c->incomplete_lock, NULL);
+    if (ret)
+        return AVERROR(ret);
+    c->incomplete_lock_init = 1;
 
     if (c->pix_fmt == AV_PIX_FMT_NONE) {
         av_log(ctx, AV_LOG_ERROR, "Unspecified pixel format\n");
@@ -428,6 +564,11 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     BufferSourceContext *s = ctx->priv;
     av_buffer_unref(&s->hw_frames_ctx);
+    while (s->nb_incomplete)
+        remove_incomplete_frame(s, &s->incomplete[0]);
+    av_freep(&s->incomplete);
+    if (s->incomplete_lock_init)
+        ff_mutex_destroy(&s->incomplete_lock);
     av_channel_layout_uninit(&s->ch_layout);
     av_frame_side_data_free(&s->side_data, &s->nb_side_data);
 }
@@ -52,6 +52,14 @@ enum {
      */
     AV_BUFFERSRC_FLAG_KEEP_REF = 8,
 
+    /**
+     * The frame data is still being written, e.g. by a decoder that has
+     * only just allocated it. Filters that support it start working on the
+     * rows made available with av_buffersrc_report_slice(), the others wait
+     * for the whole frame. Only valid for reference-counted video frames.
+     */
+    AV_BUFFERSRC_FLAG_INCOMPLETE = 16,
+
 };
 
 /**
@@ -202,6 +210,31 @@ av_warn_unused_result
 int av_buffersrc_add_frame_flags(AVFilterContext *buffer_src,
                                  AVFrame *frame, int flags);
 
+/**
+ * Mark rows of a frame added or to be added with AV_BUFFERSRC_FLAG_INCOMPLETE
+ * as ready to be read. It is meant to be called from
+ * AVCodecContext.draw_horiz_band().
+ *
+ * This function may be called from any thread, concurrently with the
+ * filtering, with the slices in any order, and before the frame has been
+ * added. The frame is identified by its first buffer, so any reference to
+ * it can be passed.
+ *
+ * Every frame passed to this function must eventually be added with
+ * AV_BUFFERSRC_FLAG_INCOMPLETE, and all rows of every incomplete frame
+ * must eventually be reported, even if writing it failed; otherwise the
+ * filters waiting for it never return.
+ *
+ * @param buffer_src  an instance of the buffersrc filter
+ * @param frame       a reference-counted video frame
+ * @param y           first row of the slice
+ * @param height      number of rows in the slice
+ * @return            >= 0 in case of success, a negative AVERROR code
+ *                    in case of failure
+ */
+int av_buffersrc_report_slice(AVFilterContext *buffer_src, const AVFrame *frame,
+                              int y, int height);
+
 /**
  * Close the buffer source after EOF.
  *
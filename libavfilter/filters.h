@@ -206,6 +206,15 @@ static inline FilterLink* ff_filter_link(AVFilterLink *link)
  */
 #define FF_FILTER_FLAG_HWFRAME_AWARE (1 << 0)
 
+/**
+ * The filter accepts video frames whose rows are still being written, see
+ * frameprogress.h. It must call ff_frame_await_rows() before reading any
+ * part of an input frame, and drop AVFrame.private_ref from output frames
+ * it allocates itself after copying the input properties to them. Input
+ * frames of other filters are waited for when they are taken from the link.
+ */
+#define FF_FILTER_FLAG_INCOMPLETE_FRAMES (1 << 1)
+
 /**
  * Find the index of a link.
  *
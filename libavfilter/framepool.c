@@ -50,6 +50,7 @@ struct FFFramePool {
 };
 
 FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
+                                      int flags,
                                       int width,
                                       int height,
                                       enum AVPixelFormat format,
@@ -100,7 +101,8 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
     for (i = 0; i < 4 && sizes[i]; i++) {
         if (sizes[i] > SIZE_MAX - align)
             goto fail;
-        pool->pools[i] = av_buffer_pool_init(sizes[i] + align, alloc);
+        pool->pools[i] = flags ? av_buffer_pool_init_flags(sizes[i] + align, flags) :
+                                 av_buffer_pool_init(sizes[i] + align, alloc);
         if (!pool->pools[i])
             goto fail;
     }
@@ -113,6 +115,7 @@ fail:
 }
 
 FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(size_t size),
+                                      int flags,
                                       int channels,
                                       int nb_samples,
                                       enum AVSampleFormat format,
@@ -141,7 +144,8 @@ FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(size_t size),
 
     if (pool->linesize[0] > SIZE_MAX - align)
         goto fail;
-    pool->pools[0] = av_buffer_pool_init(pool->linesize[0] + align, NULL);
+    pool->pools[0] = flags ? av_buffer_pool_init_flags(pool->linesize[0] + align, flags) :
+                             av_buffer_pool_init(pool->linesize[0] + align, NULL);
     if (!pool->pools[0])
         goto fail;
 
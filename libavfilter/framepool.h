@@ -38,6 +38,8 @@ typedef struct FFFramePool FFFramePool;
  * @param alloc a function that will be used to allocate new frame buffers when
  * the pool is empty. May be NULL, then the default allocator will be used
  * (av_buffer_alloc()).
+ * @param flags a combination of AV_BUFFER_POOL_FLAG_*. If non-zero, alloc is
+ * ignored and the buffers are allocated by av_buffer_pool_init_flags().
  * @param width width of each frame in this pool
  * @param height height of each frame in this pool
  * @param format format of each frame in this pool
@@ -45,6 +47,7 @@ typedef struct FFFramePool FFFramePool;
  * @return newly created video frame pool on success, NULL on error.
  */
 FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
+                                      int flags,
                                       int width,
                                       int height,
                                       enum AVPixelFormat format,
@@ -56,6 +59,8 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
  * @param alloc a function that will be used to allocate new frame buffers when
  * the pool is empty. May be NULL, then the default allocator will be used
  * (av_buffer_alloc()).
+ * @param flags a combination of AV_BUFFER_POOL_FLAG_*. If non-zero, alloc is
+ * ignored and the buffers are allocated by av_buffer_pool_init_flags().
  * @param channels channels of each frame in this pool
  * @param nb_samples number of samples of each frame in this pool
  * @param format format of each frame in this pool
@@ -63,6 +68,7 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
  * @return newly created audio frame pool on success, NULL on error.
  */
 FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(size_t size),
+                                      int flags,
                                       int channels,
                                       int samples,
                                       enum AVSampleFormat format,
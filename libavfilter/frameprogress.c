@@ -0,0 +1,123 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "libavutil/refstruct.h"
+#include "libavutil/thread.h"
+
+#include "frameprogress.h"
+
+struct FFFrameProgress {
+    atomic_int ready;   ///< number of rows ready from the top of the frame
+    int height;
+    uint8_t *rows;      ///< per row ready flags, protected by mutex
+    AVMutex mutex;
+    AVCond  cond;
+};
+
+static void frame_progress_free(AVRefStructOpaque opaque, void *obj)
+{
+    FFFrameProgress *p = obj;
+
+    ff_mutex_destroy(&p->mutex);
+    ff_cond_destroy(&p->cond);
+    av_freep(&p->rows);
+}
+
+FFFrameProgress *ff_frame_progress_alloc(int height)
+{
+    FFFrameProgress *p;
+
+    if (height <= 0)
+        return NULL;
+
+    p = av_refstruct_alloc_ext(sizeof(*p), 0, NULL, frame_progress_free);
+    if (!p)
+        return NULL;
+
+    p->rows = av_mallocz(height);
+    if (!p->rows || ff_mutex_init(&p->mutex, NULL)) {
+        av_freep(&p->rows);
+        av_refstruct_unref(&p);
+        return NULL;
+    }
+    if (ff_cond_init(&p->cond, NULL)) {
+        ff_mutex_destroy(&p->mutex);
+        av_freep(&p->rows);
+        av_refstruct_unref(&p);
+        return NULL;
+    }
+
+    atomic_init(&p->ready, 0);
+    p->height = height;
+
+    return p;
+}
+
+void ff_frame_progress_report(FFFrameProgress *p, int y, int h)
+{
+    int ready, end = FFMIN(y + h, p->height);
+
+    y = FFMAX(y, 0);
+    if (y >= end)
+        return;
+
+    ff_mutex_lock(&p->mutex);
+    memset(p->rows + y, 1, end - y);
+    ready = atomic_load_explicit(&p->ready, memory_order_relaxed);
+    if (y <= ready && end > ready) {
+        for (ready = end; ready < p->height && p->rows[ready]; ready++);
+        atomic_store_explicit(&p->ready, ready, memory_order_release);
+        ff_cond_broadcast(&p->cond);
+    }
+    ff_mutex_unlock(&p->mutex);
+}
+
+int ff_frame_progress_done(const FFFrameProgress *p)
+{
+    return atomic_load_explicit(&p->ready, memory_order_acquire) >= p->height;
+}
+
+void ff_frame_progress_await(const FFFrameProgress *p_c, int rows)
+{
+    /* Only the synchronization primitives are used mutably */
+    FFFrameProgress *p = (FFFrameProgress *)p_c;
+
+    rows = FFMIN(rows, p->height);
+    if (atomic_load_explicit(&p->ready, memory_order_acquire) >= rows)
+        return;
+
+    ff_mutex_lock(&p->mutex);
+    while (atomic_load_explicit(&p->ready, memory_order_relaxed) < rows)
+        ff_cond_wait(&p->cond, &p->mutex);
+    ff_mutex_unlock(&p->mutex);
+}
+
+void ff_frame_complete(AVFrame *frame)
+{
+    if (!frame->private_ref)
+        return;
+
+    ff_frame_progress_await(frame->private_ref, INT_MAX);
+    av_refstruct_unref(&frame->private_ref);
+}
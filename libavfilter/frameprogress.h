@@ -0,0 +1,77 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_FRAMEPROGRESS_H
+#define AVFILTER_FRAMEPROGRESS_H
+
+/**
+ * FrameProgress tracks which rows of a video frame are ready while the frame
+ * is still being written, e.g. by a slice threaded decoder.
+ *
+ * Rows may be reported in any order and from any thread. Waiters are only
+ * woken up once all the rows above the ones they wait for are ready.
+ *
+ * A FrameProgress is a RefStruct object. While a frame is incomplete, a
+ * reference to it is held in AVFrame.private_ref; frames are completed
+ * (waited for and stripped of it) before they reach a filter without
+ * FF_FILTER_FLAG_INCOMPLETE_FRAMES.
+ */
+
+#include "libavutil/frame.h"
+
+typedef struct FFFrameProgress FFFrameProgress;
+
+/**
+ * Allocate a FrameProgress for a frame with the given number of rows,
+ * none of which are ready.
+ *
+ * @return a new RefStruct reference or NULL on failure
+ */
+FFFrameProgress *ff_frame_progress_alloc(int height);
+
+/**
+ * Mark rows y to y + h - 1 as ready. Rows outside of the frame are ignored.
+ */
+void ff_frame_progress_report(FFFrameProgress *p, int y, int h);
+
+/**
+ * @return nonzero if all rows are ready
+ */
+int ff_frame_progress_done(const FFFrameProgress *p);
+
+/**
+ * Wait until the first rows of the frame are ready.
+ */
+void ff_frame_progress_await(const FFFrameProgress *p, int rows);
+
+/**
+ * Wait until the first rows of the frame are ready. Does not block for
+ * frames without a FrameProgress attached.
+ */
+static inline void ff_frame_await_rows(const AVFrame *frame, int rows)
+{
+    if (frame->private_ref)
+        ff_frame_progress_await(frame->private_ref, rows);
+}
+
+/**
+ * Wait until the whole frame is ready and drop its FrameProgress.
+ */
+void ff_frame_complete(AVFrame *frame);
+
+#endif /* AVFILTER_FRAMEPROGRESS_H */
@@ -49,6 +49,7 @@ static const AVOption framesync_options[] = {
             0, AV_OPT_TYPE_CONST, { .i64 = TS_DEFAULT }, .flags = FLAGS, .unit = "ts_sync_mode" },
         { "nearest", "Frame from secondary input with the absolute nearest timestamp to the primary input frame",
             0, AV_OPT_TYPE_CONST, { .i64 = TS_NEAREST }, .flags = FLAGS, .unit = "ts_sync_mode" },
+    { "lookahead", "wait for the next primary frame to allow in-place processing", OFFSET(opt_lookahead), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
     { NULL }
 };
 const AVClass ff_framesync_class = {
@@ -270,7 +271,7 @@ int ff_framesync_get_frame(FFFrameSync *fs, unsigned in, AVFrame **rframe,
                             unsigned get)
 {
     AVFrame *frame;
-    unsigned need_copy = 0, i;
+    unsigned need_copy = 0, next_known, i;
     int64_t pts_next;
 
     if (!fs->in[in].frame) {
@@ -282,8 +283,14 @@ int ff_framesync_get_frame(FFFrameSync *fs, unsigned in, AVFrame **rframe,
         /* Find out if we need to copy the frame: is there another sync
            stream, and do we know if its current frame will outlast this one? */
         pts_next = fs->in[in].have_next ? fs->in[in].pts_next : INT64_MAX;
+        /* Streams at a lower sync level only generate events once this one
+           has reached EOF, so they cannot reuse its frame if it is known to
+           have another one. */
+        next_known = fs->in[in].have_next ? !!fs->in[in].frame_next :
+                     ff_inlink_queued_frames(fs->parent->inputs[in]) > 0;
         for (i = 0; i < fs->nb_in && !need_copy; i++)
             if (i != in && fs->in[i].sync &&
+                !(next_known && fs->in[i].sync < fs->in[in].sync) &&
                 (!fs->in[i].have_next || fs->in[i].pts_next < pts_next))
                 need_copy = 1;
         if (need_copy) {
@@ -349,6 +356,30 @@ static int consume_from_fifos(FFFrameSync *fs)
     return 1;
 }
 
+/**
+ * Make sure that the next frame or the EOF of the inputs generating the
+ * event is queued, so that their current frame can be given away instead
+ * of being kept for a later event.
+ *
+ * @return  1 if the event can be processed, 0 if a frame was requested
+ */
+static int framesync_lookahead(FFFrameSync *fs)
+{
+    AVFilterContext *ctx = fs->parent;
+    unsigned i;
+
+    for (i = 0; i < fs->nb_in; i++) {
+        if (fs->in[i].sync != fs->sync_level || fs->in[i].have_next ||
+            fs->in[i].state == STATE_EOF ||
+            ff_inlink_queued_frames(ctx->inputs[i]) ||
+            ff_outlink_get_status(ctx->inputs[i]))
+            continue;
+        ff_inlink_request_frame(ctx->inputs[i]);
+        return 0;
+    }
+    return 1;
+}
+
 int ff_framesync_activate(FFFrameSync *fs)
 {
     AVFilterContext *ctx = fs->parent;
@@ -361,6 +392,8 @@ int ff_framesync_activate(FFFrameSync *fs)
         return ret;
     if (fs->eof || !fs->frame_ready)
         return 0;
+    if (fs->opt_lookahead && !framesync_lookahead(fs))
+        return 0;
     ret = fs->on_event(fs);
     if (ret < 0)
         return ret;
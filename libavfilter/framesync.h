@@ -228,6 +228,7 @@ typedef struct FFFrameSync {
     int opt_shortest;
     int opt_eof_action;
     int opt_ts_sync_mode;
+    int opt_lookahead;
 
 } FFFrameSync;
 
@@ -46,6 +46,61 @@ typedef struct AlphaMergeContext {
     FFFrameSync fs;
 } AlphaMergeContext;
 
+typedef struct ThreadData {
+    AVFrame *main, *alpha;
+} ThreadData;
+
+static int merge_packed_rgb(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    AlphaMergeContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *main_buf = td->main, *alpha_buf = td->alpha;
+    const int slice_start = (main_buf->height *  jobnr     ) / nb_jobs;
+    const int slice_end   = (main_buf->height * (jobnr + 1)) / nb_jobs;
+
+    for (int y = slice_start; y < slice_end; y++) {
+        const uint8_t *pin = alpha_buf->data[0] + y * alpha_buf->linesize[0];
+        uint8_t *pout = main_buf->data[0] + y * main_buf->linesize[0] + s->rgba_map[A];
+        for (int x = 0; x < main_buf->width; x++) {
+            *pout = *pin;
+            pin += 1;
+            pout += 4;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Use the alpha luma plane as the alpha plane of the main frame, without
+ * copying it: the main frame gets a reference to the buffer holding it.
+ *
+ * @return 0 on success, AVERROR(ENOSPC) if the frame has no room for
+ *         another buffer reference, another negative error code on failure
+ */
+static int reference_alpha_plane(AVFrame *main_buf, const AVFrame *alpha_buf)
+{
+    AVBufferRef *buf = av_frame_get_plane_buffer(alpha_buf, Y);
+    int i;
+
+    if (!buf)
+        return AVERROR(ENOSPC);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(main_buf->buf) && main_buf->buf[i]; i++)
+        ;
+    if (i == FF_ARRAY_ELEMS(main_buf->buf))
+        return AVERROR(ENOSPC);
+
+    main_buf->buf[i] = av_buffer_ref(buf);
+    if (!main_buf->buf[i])
+        return AVERROR(ENOMEM);
+
+    main_buf->data[A]     = alpha_buf->data[Y];
+    main_buf->linesize[A] = alpha_buf->linesize[Y];
+
+    return 0;
+}
+
 static int do_alphamerge(FFFrameSync *fs)
 {
     AVFilterContext *ctx = fs->parent;
@@ -53,7 +108,7 @@ static int do_alphamerge(FFFrameSync *fs)
     AVFrame *main_buf, *alpha_buf;
     int ret;
 
-    ret = ff_framesync_dualinput_get_writable(fs, &main_buf, &alpha_buf);
+    ret = ff_framesync_dualinput_get(fs, &main_buf, &alpha_buf);
     if (ret < 0)
         return ret;
     if (!alpha_buf)
@@ -65,18 +120,20 @@ static int do_alphamerge(FFFrameSync *fs)
                av_color_range_name(alpha_buf->color_range));
     }
 
+    if (!s->is_packed_rgb) {
+        ret = reference_alpha_plane(main_buf, alpha_buf);
+        if (ret != AVERROR(ENOSPC))
+            goto end;
+    }
+
+    ret = ff_inlink_make_frame_writable(ctx->inputs[0], &main_buf);
+    if (ret < 0)
+        goto end;
+
     if (s->is_packed_rgb) {
-        int x, y;
-        uint8_t *pin, *pout;
-        for (y = 0; y < main_buf->height; y++) {
-            pin = alpha_buf->data[0] + y * alpha_buf->linesize[0];
-            pout = main_buf->data[0] + y * main_buf->linesize[0] + s->rgba_map[A];
-            for (x = 0; x < main_buf->width; x++) {
-                *pout = *pin;
-                pin += 1;
-                pout += 4;
-            }
-        }
+        ThreadData td = { .main = main_buf, .alpha = alpha_buf };
+        ff_filter_execute(ctx, merge_packed_rgb, &td, NULL,
+                          FFMIN(main_buf->height, ff_filter_get_nb_threads(ctx)));
     } else {
         const int main_linesize = main_buf->linesize[A];
         const int alpha_linesize = alpha_buf->linesize[Y];
@@ -85,6 +142,11 @@ static int do_alphamerge(FFFrameSync *fs)
                             FFMIN(main_linesize, alpha_linesize), alpha_buf->height);
     }
 
+end:
+    if (ret < 0) {
+        av_frame_free(&main_buf);
+        return ret;
+    }
     return ff_filter_frame(ctx->outputs[0], main_buf);
 }
 
@@ -203,7 +265,8 @@ const FFFilter ff_vf_alphamerge = {
     .p.description  = NULL_IF_CONFIG_SMALL("Copy the luma value of the second "
                       "input into the alpha channel of the first input."),
     .p.priv_class   = &alphamerge_class,
-    .p.flags        = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .p.flags        = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL |
+                      AVFILTER_FLAG_SLICE_THREADS,
     .preinit        = alphamerge_framesync_preinit,
     .priv_size      = sizeof(AlphaMergeContext),
     .init           = init,
@@ -190,6 +190,7 @@ const FFFilter ff_vf_format = {
     .p.priv_class  = &format_class,
 
     .p.flags       = AVFILTER_FLAG_METADATA_ONLY,
+    .flags_internal = FF_FILTER_FLAG_INCOMPLETE_FRAMES,
 
     .init          = init,
     .uninit        = uninit,
@@ -210,6 +211,7 @@ const FFFilter ff_vf_noformat = {
     .p.priv_class  = &format_class,
 
     .p.flags       = AVFILTER_FLAG_METADATA_ONLY,
+    .flags_internal = FF_FILTER_FLAG_INCOMPLETE_FRAMES,
 
     .init          = init,
     .uninit        = uninit,
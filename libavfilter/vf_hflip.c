@@ -29,6 +29,7 @@
 #include "avfilter.h"
 #include "filters.h"
 #include "formats.h"
+#include "frameprogress.h"
 #include "hflip.h"
 #include "vf_hflip_init.h"
 #include "video.h"
@@ -36,6 +37,7 @@
 #include "libavutil/internal.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/refstruct.h"
 
 static int query_formats(const AVFilterContext *ctx,
                          AVFilterFormatsConfig **cfg_in,
@@ -87,6 +89,7 @@ static int filter_slice(AVFilterContext *ctx, void *arg, int job, int nb_jobs)
     ThreadData *td = arg;
     AVFrame *in = td->in;
     AVFrame *out = td->out;
+    const int vsub = av_pix_fmt_desc_get(in->format)->log2_chroma_h;
     uint8_t *inrow, *outrow;
     int i, plane, step;
 
@@ -98,6 +101,8 @@ static int filter_slice(AVFilterContext *ctx, void *arg, int job, int nb_jobs)
 
         step = s->max_step[plane];
 
+        ff_frame_await_rows(in, plane == 1 || plane == 2 ? end << vsub : end);
+
         outrow = out->data[plane] + start * out->linesize[plane];
         inrow  = in ->data[plane] + start * in->linesize[plane] + (width - 1) * step;
         for (i = start; i < end; i++) {
@@ -124,10 +129,14 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
         return AVERROR(ENOMEM);
     }
     av_frame_copy_props(out, in);
+    /* out is complete once this returns, do not pass on the progress of in */
+    av_refstruct_unref(&out->private_ref);
 
     /* copy palette if required */
-    if (av_pix_fmt_desc_get(inlink->format)->flags & AV_PIX_FMT_FLAG_PAL)
+    if (av_pix_fmt_desc_get(inlink->format)->flags & AV_PIX_FMT_FLAG_PAL) {
+        ff_frame_await_rows(in, inlink->h);
         memcpy(out->data[1], in->data[1], AVPALETTE_SIZE);
+    }
 
     td.in = in, td.out = out;
     ff_filter_execute(ctx, filter_slice, &td, NULL,
@@ -151,6 +160,7 @@ const FFFilter ff_vf_hflip = {
     .p.description = NULL_IF_CONFIG_SMALL("Horizontally flip the input video."),
     .p.flags       = AVFILTER_FLAG_SLICE_THREADS | AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
     .priv_size     = sizeof(FlipContext),
+    .flags_internal = FF_FILTER_FLAG_INCOMPLETE_FRAMES,
     FILTER_INPUTS(avfilter_vf_hflip_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_QUERY_FUNC2(query_formats),
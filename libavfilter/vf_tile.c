@@ -197,6 +197,50 @@ static int end_last_frame(AVFilterContext *ctx)
     return ret;
 }
 
+typedef struct ThreadData {
+    AVFrame *dst, *src;
+    unsigned dst_x, dst_y;
+    unsigned src_x, src_y;
+} ThreadData;
+
+static int copy_tile_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    TileContext *tile    = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    ThreadData *td       = arg;
+    /* keep slices on chroma row boundaries */
+    const unsigned align = (1 << tile->draw.vsub_max) - 1;
+    const unsigned start = (inlink->h *  jobnr     / nb_jobs) & ~align;
+    const unsigned end   = jobnr == nb_jobs - 1 ? inlink->h :
+                           (inlink->h * (jobnr + 1) / nb_jobs) & ~align;
+
+    if (end > start)
+        ff_copy_rectangle2(&tile->draw,
+                           td->dst->data, td->dst->linesize,
+                           td->src->data, td->src->linesize,
+                           td->dst_x, td->dst_y + start,
+                           td->src_x, td->src_y + start,
+                           inlink->w, end - start);
+    return 0;
+}
+
+static void copy_tile(AVFilterContext *ctx, AVFrame *dst, AVFrame *src,
+                      unsigned dst_x, unsigned dst_y,
+                      unsigned src_x, unsigned src_y)
+{
+    TileContext *tile    = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    ThreadData td = {
+        .dst   = dst,   .src   = src,
+        .dst_x = dst_x, .dst_y = dst_y,
+        .src_x = src_x, .src_y = src_y,
+    };
+    int nb_jobs = FFMIN(inlink->h >> tile->draw.vsub_max,
+                        ff_filter_get_nb_threads(ctx));
+
+    ff_filter_execute(ctx, copy_tile_slice, &td, NULL, FFMAX(nb_jobs, 1));
+}
+
 /* Note: direct rendering is not possible since there is no guarantee that
  * buffers are fed to filter_frame in the order they were obtained from
  * get_buffer (think B-frames). */
@@ -233,19 +277,13 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
         for (i = tile->nb_frames - tile->overlap; i < tile->nb_frames; i++) {
             get_tile_pos(ctx, &x1, &y1, i);
             get_tile_pos(ctx, &x0, &y0, i - (tile->nb_frames - tile->overlap));
-            ff_copy_rectangle2(&tile->draw,
-                               tile->out_ref->data, tile->out_ref->linesize,
-                               tile->prev_out_ref->data, tile->prev_out_ref->linesize,
-                               x0, y0, x1, y1, inlink->w, inlink->h);
+            copy_tile(ctx, tile->out_ref, tile->prev_out_ref, x0, y0, x1, y1);
 
         }
     }
 
     get_tile_pos(ctx, &x0, &y0, tile->current);
-    ff_copy_rectangle2(&tile->draw,
-                       tile->out_ref->data, tile->out_ref->linesize,
-                       picref->data, picref->linesize,
-                       x0, y0, 0, 0, inlink->w, inlink->h);
+    copy_tile(ctx, tile->out_ref, picref, x0, y0, 0, 0);
 
     av_frame_free(&picref);
     if (++tile->current == tile->nb_frames)
@@ -296,6 +334,7 @@ const FFFilter ff_vf_tile = {
     .p.name        = "tile",
     .p.description = NULL_IF_CONFIG_SMALL("Tile several successive frames together."),
     .p.priv_class  = &tile_class,
+    .p.flags       = AVFILTER_FLAG_SLICE_THREADS,
     .init          = init,
     .uninit        = uninit,
     .priv_size     = sizeof(TileContext),
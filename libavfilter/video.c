@@ -53,6 +53,7 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
     int pool_width = 0;
     int pool_height = 0;
     int pool_align = 0;
+    int pool_flags = li->l.graph ? li->l.graph->buffer_pool_flags : 0;
     enum AVPixelFormat pool_format = AV_PIX_FMT_NONE;
 
     if (li->l.hw_frames_ctx &&
@@ -74,7 +75,7 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
         li->frame_pool = ff_frame_pool_video_init(CONFIG_MEMORY_POISONING
                                                      ? NULL
                                                      : av_buffer_allocz,
-                                                  w, h, link->format, align);
+                                                  pool_flags, w, h, link->format, align);
         if (!li->frame_pool)
             return NULL;
     } else {
@@ -91,7 +92,7 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
             li->frame_pool = ff_frame_pool_video_init(CONFIG_MEMORY_POISONING
                                                          ? NULL
                                                          : av_buffer_allocz,
-                                                      w, h, link->format, align);
+                                                      pool_flags, w, h, link->format, align);
             if (!li->frame_pool)
                 return NULL;
         }
@@ -115,6 +115,16 @@ URLContext *ffio_geturlcontext(AVIOContext *s)
         return NULL;
 }
 
+int ffio_get_mmap(AVIOContext *s, AVBufferRef **buf)
+{
+    return ffurl_get_mmap(ffio_geturlcontext(s), buf);
+}
+
+int ffio_shift_data(AVIOContext *s, int64_t start, int64_t end, int shift)
+{
+    return ffurl_shift_data(ffio_geturlcontext(s), start, end, shift);
+}
+
 static int url_alloc_for_protocol(URLContext **puc, const URLProtocol *up,
                                   const char *filename, int flags,
                                   const AVIOInterruptCB *int_cb)
@@ -845,6 +855,20 @@ int ffurl_get_short_seek(void *urlcontext)
     return h->prot->url_get_short_seek(h);
 }
 
+int ffurl_get_mmap(URLContext *h, AVBufferRef **buf)
+{
+    if (!h || !h->prot || !h->prot->url_get_mmap)
+        return AVERROR(ENOSYS);
+    return h->prot->url_get_mmap(h, buf);
+}
+
+int ffurl_shift_data(URLContext *h, int64_t start, int64_t end, int shift)
+{
+    if (!h || !h->prot || !h->prot->url_shift_data)
+        return AVERROR(ENOSYS);
+    return h->prot->url_shift_data(h, start, end, shift);
+}
+
 int ffurl_shutdown(URLContext *h, int flags)
 {
     if (!h || !h->prot || !h->prot->url_shutdown)
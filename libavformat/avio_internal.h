@@ -21,6 +21,7 @@
 
 #include "avio.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/log.h"
 
 extern const AVClass ff_avio_class;
@@ -222,6 +223,21 @@ int ffio_open_dyn_packet_buf(AVIOContext **s, int max_packet_size);
  */
 struct URLContext *ffio_geturlcontext(AVIOContext *s);
 
+/**
+ * Return the read-only mapping of the resource underlying an AVIOContext
+ * created with ffio_fdopen(), see ffurl_get_mmap().
+ *
+ * @return 0 on success, a negative AVERROR code if there is no mapping
+ */
+int ffio_get_mmap(AVIOContext *s, AVBufferRef **buf);
+
+/**
+ * Move data within the resource underlying an AVIOContext created with
+ * ffio_fdopen(), see ffurl_shift_data(). Buffered data must have been
+ * flushed with avio_flush() first.
+ */
+int ffio_shift_data(AVIOContext *s, int64_t start, int64_t end, int shift);
+
 /**
  * Create and initialize a AVIOContext for accessing the
  * resource referenced by the URLContext h.
@@ -19,9 +19,15 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+/* for O_DIRECT, copy_file_range() and fallocate() */
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
 #include "config_components.h"
 
 #include "libavutil/avstring.h"
+#include "libavutil/buffer.h"
 #include "libavutil/file_open.h"
 #include "libavutil/internal.h"
 #include "libavutil/mem.h"
@@ -39,6 +45,9 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include "os_support.h"
 #include "url.h"
 
@@ -96,6 +105,14 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int mmap;
+    int direct;
+    AVBufferRef *map;   ///< whole-file mapping, if mmap is enabled
+    uint8_t *dbuf_mem;  ///< allocation holding dbuf
+    uint8_t *dbuf;      ///< aligned bounce buffer for direct I/O
+    int64_t dbuf_pos;   ///< file offset of the data in dbuf
+    int dbuf_len;       ///< bytes of valid data in dbuf
+    int64_t pos;        ///< file offset, if mapped or using direct I/O
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
@@ -106,6 +123,8 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "mmap", "Map the file into memory and read from the mapping", offsetof(FileContext, mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "direct", "Bypass the page cache with O_DIRECT", offsetof(FileContext, direct), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
     { NULL }
 };
 
@@ -136,12 +155,147 @@ static const AVClass fd_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+/* Direct I/O needs file offsets, sizes and memory aligned to the logical
+ * block size of the device, so it goes through an aligned bounce buffer.
+ * 4096 covers all common block sizes. */
+#define DIRECT_ALIGN       4096
+#define DIRECT_BUFFER_SIZE (1 << 20)
+
+static int direct_set(int fd, int enable)
+{
+#if HAVE_FCNTL && defined(O_DIRECT)
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1)
+        return AVERROR(errno);
+    flags = enable ? flags | O_DIRECT : flags & ~O_DIRECT;
+    if (fcntl(fd, F_SETFL, flags) == -1)
+        return AVERROR(errno);
+#endif
+    return 0;
+}
+
+static int direct_pwrite(FileContext *c, const uint8_t *buf, int size, int64_t pos)
+{
+    if (lseek(c->fd, pos, SEEK_SET) < 0)
+        return AVERROR(errno);
+    while (size > 0) {
+        int ret = write(c->fd, buf, size);
+        if (ret == -1)
+            return AVERROR(errno);
+        buf  += ret;
+        size -= ret;
+    }
+    return 0;
+}
+
+/* Write out the bounce buffer. Only the part starting and ending on block
+ * boundaries can be written directly, the unaligned head is written with
+ * O_DIRECT cleared, the unaligned tail too if final is set, otherwise it
+ * is kept for the next call. */
+static int direct_flush(FileContext *c, int final)
+{
+    int64_t pos = c->dbuf_pos;
+    int len = c->dbuf_len;
+    int head, body, ret;
+
+    head = FFMIN(len, (DIRECT_ALIGN - (pos & (DIRECT_ALIGN - 1))) & (DIRECT_ALIGN - 1));
+    if (head) {
+        if ((ret = direct_set(c->fd, 0)) < 0 ||
+            (ret = direct_pwrite(c, c->dbuf, head, pos)) < 0 ||
+            (ret = direct_set(c->fd, 1)) < 0)
+            return ret;
+        pos += head;
+        len -= head;
+        memmove(c->dbuf, c->dbuf + head, len);
+    }
+
+    body = len & ~(DIRECT_ALIGN - 1);
+    if (body) {
+        ret = direct_pwrite(c, c->dbuf, body, pos);
+        if (ret < 0)
+            return ret;
+        pos += body;
+        len -= body;
+        memmove(c->dbuf, c->dbuf + body, len);
+    }
+
+    if (final && len) {
+        if ((ret = direct_set(c->fd, 0)) < 0 ||
+            (ret = direct_pwrite(c, c->dbuf, len, pos)) < 0 ||
+            (ret = direct_set(c->fd, 1)) < 0)
+            return ret;
+        pos += len;
+        len  = 0;
+    }
+
+    c->dbuf_pos = pos;
+    c->dbuf_len = len;
+    return 0;
+}
+
+static int direct_read(FileContext *c, unsigned char *buf, int size)
+{
+    if (c->pos < c->dbuf_pos || c->pos >= c->dbuf_pos + c->dbuf_len) {
+        int64_t pos = c->pos & ~(int64_t)(DIRECT_ALIGN - 1);
+        int ret;
+
+        c->dbuf_len = 0;
+        if (lseek(c->fd, pos, SEEK_SET) < 0)
+            return AVERROR(errno);
+        ret = read(c->fd, c->dbuf, DIRECT_BUFFER_SIZE);
+        if (ret == -1)
+            return AVERROR(errno);
+        c->dbuf_pos = pos;
+        c->dbuf_len = ret;
+        if (c->pos >= pos + ret)
+            return 0;
+    }
+
+    size = FFMIN(size, c->dbuf_pos + c->dbuf_len - c->pos);
+    memcpy(buf, c->dbuf + c->pos - c->dbuf_pos, size);
+    c->pos += size;
+    return size;
+}
+
+static int direct_write(FileContext *c, const unsigned char *buf, int size)
+{
+    int ret;
+
+    if (!c->dbuf_len)
+        c->dbuf_pos = c->pos;
+
+    size = FFMIN(size, DIRECT_BUFFER_SIZE - c->dbuf_len);
+    memcpy(c->dbuf + c->dbuf_len, buf, size);
+    c->dbuf_len += size;
+    c->pos      += size;
+
+    if (c->dbuf_len == DIRECT_BUFFER_SIZE) {
+        ret = direct_flush(c, 0);
+        if (ret < 0)
+            return ret;
+    }
+    return size;
+}
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
-    ret = read(c->fd, buf, size);
+    if (c->map) {
+        size = FFMIN(size, (int64_t)c->map->size - c->pos);
+        if (size <= 0)
+            return AVERROR_EOF;
+        memcpy(buf, c->map->data + c->pos, size);
+        c->pos += size;
+        return size;
+    }
+    if (c->dbuf) {
+        ret = direct_read(c, buf, size);
+        if (ret < 0)
+            return ret;
+    } else
+        ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
     if (ret == 0)
@@ -154,6 +308,8 @@ static int file_write(URLContext *h, const unsigned char *buf, int size)
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+    if (c->dbuf)
+        return direct_write(c, buf, size);
     ret = write(c->fd, buf, size);
     return (ret == -1) ? AVERROR(errno) : ret;
 }
@@ -221,8 +377,18 @@ static int fd_dup(URLContext *h, int oldfd)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
-    int ret = close(c->fd);
-    return (ret == -1) ? AVERROR(errno) : 0;
+    int ret = 0, ret2;
+    /* Packets may still reference the mapping; it is unmapped once the
+     * last of them is gone. */
+    av_buffer_unref(&c->map);
+    if (c->dbuf && (h->flags & AVIO_FLAG_WRITE))
+        ret = direct_flush(c, 1);
+    av_freep(&c->dbuf_mem);
+    c->dbuf = NULL;
+    ret2 = close(c->fd);
+    if (ret2 == -1 && ret >= 0)
+        ret = AVERROR(errno);
+    return ret;
 }
 
 /* XXX: use llseek */
@@ -233,10 +399,36 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 
     if (whence == AVSEEK_SIZE) {
         struct stat st;
+        /* Data still in the bounce buffer is part of the size. */
+        if (c->dbuf && (h->flags & AVIO_FLAG_WRITE)) {
+            ret = direct_flush(c, 1);
+            if (ret < 0)
+                return ret;
+        }
         ret = fstat(c->fd, &st);
         return ret < 0 ? AVERROR(errno) : (S_ISFIFO(st.st_mode) ? 0 : st.st_size);
     }
 
+    if (c->map || c->dbuf) {
+        if (c->dbuf && (h->flags & AVIO_FLAG_WRITE)) {
+            ret = direct_flush(c, 1);
+            if (ret < 0)
+                return ret;
+        }
+        if (whence == SEEK_CUR) {
+            pos += c->pos;
+        } else if (whence == SEEK_END) {
+            struct stat st;
+            if (!c->map && fstat(c->fd, &st) < 0)
+                return AVERROR(errno);
+            pos += c->map ? c->map->size : st.st_size;
+        } else if (whence != SEEK_SET)
+            return AVERROR(EINVAL);
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        return c->pos = pos;
+    }
+
     ret = lseek(c->fd, pos, whence);
 
     return ret < 0 ? AVERROR(errno) : ret;
@@ -244,6 +436,129 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 
 #if CONFIG_FILE_PROTOCOL
 
+#if HAVE_MMAP
+static void file_unmap(void *opaque, uint8_t *data)
+{
+    munmap(data, (size_t)(uintptr_t)opaque);
+}
+
+/* Map a regular file opened for reading in its entirety. Failure is not
+ * fatal, the caller simply keeps using read(). */
+static void file_map(URLContext *h, const struct stat *st)
+{
+    FileContext *c = h->priv_data;
+    void *data;
+
+    if (!S_ISREG(st->st_mode) || st->st_size <= 0 ||
+        (uint64_t)st->st_size > SIZE_MAX) {
+        av_log(h, AV_LOG_VERBOSE, "Not mapping file, unsupported type or size\n");
+        return;
+    }
+
+    data = mmap(NULL, st->st_size, PROT_READ, MAP_PRIVATE, c->fd, 0);
+    if (data == MAP_FAILED) {
+        av_log(h, AV_LOG_VERBOSE, "mmap() failed: %s\n", av_err2str(AVERROR(errno)));
+        return;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(data, st->st_size, MADV_SEQUENTIAL);
+#endif
+
+    c->map = av_buffer_create(data, st->st_size, file_unmap,
+                              (void *)(uintptr_t)st->st_size,
+                              AV_BUFFER_FLAG_READONLY);
+    if (!c->map) {
+        munmap(data, st->st_size);
+        return;
+    }
+    c->pos = 0;
+}
+#endif
+
+static int file_get_mmap(URLContext *h, AVBufferRef **buf)
+{
+    FileContext *c = h->priv_data;
+    if (!c->map)
+        return AVERROR(ENOSYS);
+    *buf = c->map;
+    return 0;
+}
+
+#if HAVE_COPY_FILE_RANGE
+static int copy_range(int rfd, int wfd, int64_t src, int64_t dst, int64_t len)
+{
+    while (len > 0) {
+        off_t in = src, out = dst;
+        ssize_t ret = copy_file_range(rfd, &in, wfd, &out, len, 0);
+        if (ret <= 0)
+            return ret < 0 ? AVERROR(errno) : AVERROR(EIO);
+        src += ret;
+        dst += ret;
+        len -= ret;
+    }
+    return 0;
+}
+#endif
+
+static int file_shift_data(URLContext *h, int64_t start, int64_t end, int shift)
+{
+#if HAVE_COPY_FILE_RANGE
+    FileContext *c = h->priv_data;
+    const char *filename = h->filename;
+    struct stat st;
+    int64_t pos;
+    int rfd, ret;
+
+    if (c->dbuf && (ret = direct_flush(c, 1)) < 0)
+        return ret;
+    if (fstat(c->fd, &st) < 0 || !S_ISREG(st.st_mode))
+        return AVERROR(ENOSYS);
+
+    /* The output is usually open for writing only. */
+    av_strstart(filename, "file:", &filename);
+    rfd = avpriv_open(filename, O_RDONLY);
+    if (rfd == -1)
+        return AVERROR(ENOSYS);
+
+#if HAVE_FALLOCATE && defined(FALLOC_FL_INSERT_RANGE)
+    /* Insert whole filesystem blocks, which moves no data at all, then put
+     * back the part of the first block that precedes start. */
+    if (start < end && end == st.st_size && st.st_blksize > 0 &&
+        !(shift % st.st_blksize)) {
+        int64_t block = start - start % st.st_blksize;
+        if (!fallocate(c->fd, FALLOC_FL_INSERT_RANGE, block, shift)) {
+            av_log(h, AV_LOG_VERBOSE, "Inserted %d bytes at 0x%"PRIx64"\n", shift, block);
+            ret = copy_range(rfd, c->fd, block + shift, block, start - block);
+            goto end;
+        }
+    }
+#endif
+
+    /* Copy back to front in blocks no larger than shift, so that the source
+     * and destination of a copy never overlap. Until the first block is
+     * done the data is unchanged and the caller can still copy it itself. */
+    ret = 0;
+    for (pos = end; pos > start;) {
+        int64_t len = FFMIN(pos - start, shift);
+        pos -= len;
+        ret = copy_range(rfd, c->fd, pos, pos + shift, len);
+        if (ret < 0) {
+            if (pos + len == end)
+                ret = AVERROR(ENOSYS);
+            break;
+        }
+    }
+    if (!ret)
+        av_log(h, AV_LOG_VERBOSE, "Copied %"PRId64" bytes in the kernel\n", end - start);
+
+end:
+    close(rfd);
+    return ret;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
 static int file_delete(URLContext *h)
 {
 #if HAVE_UNISTD_H
@@ -303,11 +618,35 @@ static int file_open(URLContext *h, const char *filename, int flags)
 #ifdef O_BINARY
     access |= O_BINARY;
 #endif
-    fd = avpriv_open(filename, access, 0666);
-    if (fd == -1)
-        return AVERROR(errno);
+    fd = -1;
+#ifdef O_DIRECT
+    /* Direct I/O is only done in one direction at a time. */
+    if (c->direct && (flags & AVIO_FLAG_READ_WRITE) != AVIO_FLAG_READ_WRITE) {
+        fd = avpriv_open(filename, access | O_DIRECT, 0666);
+        if (fd == -1 && errno != EINVAL)
+            return AVERROR(errno);
+        if (fd == -1)
+            av_log(h, AV_LOG_WARNING, "Direct I/O is not supported for this file\n");
+    }
+#endif
+    if (fd == -1) {
+        c->direct = 0;
+        fd = avpriv_open(filename, access, 0666);
+        if (fd == -1)
+            return AVERROR(errno);
+    }
     c->fd = fd;
 
+    if (c->direct) {
+        c->dbuf_mem = av_malloc(DIRECT_BUFFER_SIZE + DIRECT_ALIGN);
+        if (!c->dbuf_mem) {
+            close(fd);
+            return AVERROR(ENOMEM);
+        }
+        c->dbuf = c->dbuf_mem + (-(uintptr_t)c->dbuf_mem & (DIRECT_ALIGN - 1));
+        c->pos  = 0;
+    }
+
     h->is_streamed = !fstat(fd, &st) && S_ISFIFO(st.st_mode);
 
     /* Buffer writes more than the default 32k to improve throughput especially
@@ -318,6 +657,12 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
 
+#if HAVE_MMAP
+    if (c->mmap && !c->direct && !(flags & AVIO_FLAG_WRITE) && !c->follow &&
+        !h->is_streamed && !fstat(fd, &st))
+        file_map(h, &st);
+#endif
+
     return 0;
 }
 
@@ -413,6 +758,8 @@ const URLProtocol ff_file_protocol = {
     .url_seek            = file_seek,
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
+    .url_get_mmap        = file_get_mmap,
+    .url_shift_data      = file_shift_data,
     .url_check           = file_check,
     .url_delete          = file_delete,
     .url_move            = file_move,
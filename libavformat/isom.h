@@ -380,6 +380,11 @@ typedef struct MOVContext {
     int nb_thmb_item;
     int64_t idat_offset;
     int interleaved_read;
+    int prefetch;
+    struct FFPrefetch *prefetch_ctx;
+    int packet_pool;
+    int packet_pool_flags;
+    struct FFPacketPool *packet_pool_ctx;
 } MOVContext;
 
 int ff_mp4_read_descr_len(AVIOContext *pb);
@@ -33,6 +33,7 @@
 #include "libavutil/bprint.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/internal.h"
+#include "libavutil/bswap.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/intfloat.h"
 #include "libavutil/mathematics.h"
@@ -58,6 +59,8 @@
 #include "avformat.h"
 #include "internal.h"
 #include "avio_internal.h"
+#include "packetpool.h"
+#include "prefetch.h"
 #include "demux.h"
 #include "dvdclut.h"
 #include "iamf_parse.h"
@@ -2559,6 +2562,56 @@ static int mov_read_strf(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     return 0;
 }
 
+/**
+ * Read big-endian 32-bit table entries with one read per block, then
+ * byteswap them in place, instead of an avio_rb32() call per entry.
+ *
+ * @return number of entries read, less than count on EOF or error
+ */
+static unsigned int mov_read_be32_table(AVIOContext *pb, uint32_t *dst,
+                                        unsigned int count)
+{
+    unsigned int done = 0;
+
+    while (done < count) {
+        int n = FFMIN(count - done, INT_MAX / 4);
+        int ret = avio_read(pb, (uint8_t *)(dst + done), n * 4);
+        if (ret <= 0)
+            break;
+        n = ret / 4;
+        for (int i = 0; i < n; i++)
+            dst[done + i] = av_be2ne32(dst[done + i]);
+        done += n;
+        if (ret & 3) {
+            pb->eof_reached = 1;
+            break;
+        }
+    }
+    return done;
+}
+
+static unsigned int mov_read_be64_table(AVIOContext *pb, uint64_t *dst,
+                                        unsigned int count)
+{
+    unsigned int done = 0;
+
+    while (done < count) {
+        int n = FFMIN(count - done, INT_MAX / 8);
+        int ret = avio_read(pb, (uint8_t *)(dst + done), n * 8);
+        if (ret <= 0)
+            break;
+        n = ret / 8;
+        for (int i = 0; i < n; i++)
+            dst[done + i] = av_be2ne64(dst[done + i]);
+        done += n;
+        if (ret & 7) {
+            pb->eof_reached = 1;
+            break;
+        }
+    }
+    return done;
+}
+
 static int mov_read_stco(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 {
     AVStream *st;
@@ -2600,19 +2653,28 @@ static int mov_read_stco(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         return AVERROR(ENOMEM);
     sc->chunk_count = entries;
 
-    if      (atom.type == MKTAG('s','t','c','o'))
-        for (i = 0; i < entries && !pb->eof_reached; i++)
-            sc->chunk_offsets[i] = avio_rb32(pb);
-    else if (atom.type == MKTAG('c','o','6','4'))
-        for (i = 0; i < entries && !pb->eof_reached; i++) {
-            sc->chunk_offsets[i] = avio_rb64(pb);
-            if (sc->chunk_offsets[i] < 0) {
+    if (atom.type == MKTAG('s','t','c','o')) {
+        uint32_t offsets32[1024];
+        for (i = 0; i < entries;) {
+            unsigned int n = FFMIN(entries - i, FF_ARRAY_ELEMS(offsets32));
+            unsigned int got = mov_read_be32_table(pb, offsets32, n);
+            for (unsigned int j = 0; j < got; j++)
+                sc->chunk_offsets[i + j] = offsets32[j];
+            i += got;
+            if (got < n)
+                break;
+        }
+    } else if (atom.type == MKTAG('c','o','6','4')) {
+        i = mov_read_be64_table(pb, (uint64_t *)sc->chunk_offsets, entries);
+        for (unsigned int j = 0; j < i; j++)
+            if (sc->chunk_offsets[j] < 0) {
                 av_log(c->fc, AV_LOG_WARNING, "Impossible chunk_offset\n");
-                sc->chunk_offsets[i] = 0;
+                sc->chunk_offsets[j] = 0;
             }
-        }
-    else
+    } else
         return AVERROR_INVALIDDATA;
+    if (i < entries)
+        pb->eof_reached = 1;
 
     sc->chunk_count = i;
 
@@ -3399,9 +3461,9 @@ static int mov_read_stss(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     if (!sc->keyframes)
         return AVERROR(ENOMEM);
 
-    for (i = 0; i < entries && !pb->eof_reached; i++) {
-        sc->keyframes[i] = avio_rb32(pb);
-    }
+    i = mov_read_be32_table(pb, (uint32_t *)sc->keyframes, entries);
+    if (i < entries)
+        pb->eof_reached = 1;
 
     sc->keyframe_count = i;
 
@@ -3487,10 +3549,27 @@ static int mov_read_stsz(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         return 0;
     }
 
-    init_get_bits(&gb, buf, 8*num_bytes);
-
+    /* Byte-aligned fields are converted directly, which the compiler can
+     * vectorize. */
+    switch (field_size) {
+    case 32:
+        for (i = 0; i < entries; i++)
+            sc->sample_sizes[i] = AV_RB32(buf + 4 * i);
+        break;
+    case 16:
+        for (i = 0; i < entries; i++)
+            sc->sample_sizes[i] = AV_RB16(buf + 2 * i);
+        break;
+    case 8:
+        for (i = 0; i < entries; i++)
+            sc->sample_sizes[i] = buf[i];
+        break;
+    default:
+        init_get_bits(&gb, buf, 8*num_bytes);
+        for (i = 0; i < entries; i++)
+            sc->sample_sizes[i] = get_bits(&gb, 4);
+    }
     for (i = 0; i < entries; i++) {
-        sc->sample_sizes[i] = get_bits_long(&gb, field_size);
         if (sc->sample_sizes[i] > INT64_MAX - sc->data_size) {
             av_free(buf);
             av_log(c->fc, AV_LOG_ERROR, "Sample size overflow in STSZ\n");
@@ -4195,6 +4274,69 @@ static void mov_current_sample_set(MOVStreamContext *sc, int current_sample)
     }
 }
 
+/**
+ * Handle the common case of a single edit that starts at the first sample
+ * and covers every sample of a track without composition offsets. The
+ * generic code below would rebuild an identical index and time to sample
+ * table entry by entry, which dominates the open time of files with
+ * millions of samples.
+ *
+ * Returns 1 if the index was left as is, 0 if the generic code must run.
+ */
+static int mov_fix_index_trivial(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *msc = st->priv_data;
+    FFStream *const sti = ffstream(st);
+    const AVIndexEntry *e = sti->index_entries;
+    int nb = sti->nb_index_entries;
+    int64_t edit_list_media_time, edit_list_duration;
+    int64_t tts_samples = 0;
+
+    if (msc->elst_count != 1 || msc->ctts_count || msc->dts_shift)
+        return 0;
+    if (!get_edit_list_entry(mov, msc, 0, &edit_list_media_time,
+                             &edit_list_duration, mov->time_scale) ||
+        edit_list_media_time)
+        return 0;
+
+    if (e[0].timestamp || (nb > 1 && e[1].timestamp <= 0) ||
+        e[nb - 1].timestamp >= edit_list_duration)
+        return 0;
+    for (int i = 1; i < nb - 1; i++)
+        if (e[i + 1].timestamp < e[i].timestamp)
+            return 0;
+
+    for (unsigned i = 0; i < msc->tts_count; i++) {
+        if (!msc->tts_data[i].count)
+            return 0;
+        tts_samples += msc->tts_data[i].count;
+    }
+    if (msc->tts_data && tts_samples != nb)
+        return 0;
+
+    msc->index_ranges = av_malloc_array(2, sizeof(msc->index_ranges[0]));
+    if (!msc->index_ranges)
+        return 0;
+    msc->index_ranges[0].start = 0;
+    msc->index_ranges[0].end   = nb;
+    msc->index_ranges[1].start = 0;
+    msc->index_ranges[1].end   = 0;
+    msc->current_index_range = msc->index_ranges;
+    msc->current_index       = 0;
+
+    msc->tts_index  = 0;
+    msc->tts_sample = 0;
+    msc->min_corrected_pts = 0;
+
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+        sti->skip_samples = 0;
+    msc->start_pad = sti->skip_samples;
+
+    st->start_time = 0;
+    st->duration   = FFMIN(st->duration, edit_list_duration);
+    return 1;
+}
+
 /**
  * Fix ffstream(st)->index_entries, so that it contains only the entries (and the entries
  * which are needed to decode them) that fall in the edit list time ranges.
@@ -4240,6 +4382,9 @@ static void mov_fix_index(MOVContext *mov, AVStream *st)
         return;
     }
 
+    if (mov_fix_index_trivial(mov, st))
+        return;
+
     // allocate the index ranges array
     msc->index_ranges = av_malloc_array(msc->elst_count + 1,
                                         sizeof(msc->index_ranges[0]));
@@ -4647,6 +4792,81 @@ static int mov_merge_tts_data(MOVContext *mov, AVStream *st, int flags)
     return 0;
 }
 
+/**
+ * Merge runs of samples with the same duration and composition offset in
+ * the time to sample table, which is expanded to one entry per sample for
+ * building the index. For constant frame rate tracks without reordering,
+ * e.g. intra-only video, this leaves a single entry.
+ */
+static void mov_compact_tts(MOVStreamContext *sc)
+{
+    MOVTimeToSample *tts_data;
+    unsigned int n = 0;
+
+    if (sc->tts_count < 2 || sc->tts_index || sc->tts_sample)
+        return;
+
+    for (unsigned int i = 1; i < sc->tts_count; i++) {
+        MOVTimeToSample *last = &sc->tts_data[n];
+        const MOVTimeToSample *cur = &sc->tts_data[i];
+        if (cur->duration == last->duration && cur->offset == last->offset &&
+            cur->count <= INT_MAX - last->count)
+            last->count += cur->count;
+        else
+            sc->tts_data[++n] = *cur;
+    }
+    n++;
+    if (n == sc->tts_count)
+        return;
+
+    sc->tts_count = n;
+    tts_data = av_realloc_array(sc->tts_data, n, sizeof(*sc->tts_data));
+    if (tts_data) {
+        sc->tts_data = tts_data;
+        sc->tts_allocated_size = n * sizeof(*sc->tts_data);
+    }
+}
+
+/**
+ * Undo mov_compact_tts(), for code that keeps the time to sample table in
+ * step with the index entries.
+ */
+static int mov_expand_tts(MOVStreamContext *sc)
+{
+    MOVTimeToSample *tts_data;
+    unsigned int allocated_size = 0;
+    uint64_t total = 0;
+    int64_t index = -1;
+    unsigned int k = 0;
+
+    for (unsigned int i = 0; i < sc->tts_count; i++) {
+        if (i == sc->tts_index)
+            index = total + sc->tts_sample;
+        total += sc->tts_data[i].count;
+    }
+    if (total == sc->tts_count)
+        return 0;
+    if (total >= UINT_MAX / sizeof(*sc->tts_data))
+        return AVERROR(ENOMEM);
+
+    tts_data = av_fast_realloc(NULL, &allocated_size, total * sizeof(*tts_data));
+    if (!tts_data)
+        return AVERROR(ENOMEM);
+    for (unsigned int i = 0; i < sc->tts_count; i++)
+        for (unsigned int j = 0; j < sc->tts_data[i].count; j++) {
+            tts_data[k] = sc->tts_data[i];
+            tts_data[k++].count = 1;
+        }
+
+    av_free(sc->tts_data);
+    sc->tts_data           = tts_data;
+    sc->tts_allocated_size = allocated_size;
+    sc->tts_count          = total;
+    sc->tts_index          = index < 0 ? total : index;
+    sc->tts_sample         = 0;
+    return 0;
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -5265,6 +5485,8 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         if (!stts_constant)
             ffstream(st)->need_parsing = AVSTREAM_PARSE_FULL;
     }
+    mov_compact_tts(sc);
+
     /* Do not need those anymore. */
     av_freep(&sc->chunk_offsets);
     av_freep(&sc->sample_sizes);
@@ -5748,7 +5970,7 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     int64_t dts, pts = AV_NOPTS_VALUE;
     int data_offset = 0;
     unsigned entries, first_sample_flags = frag->flags;
-    int flags, distance, i;
+    int flags, distance, i, ret;
     int64_t prev_dts = AV_NOPTS_VALUE;
     int next_frag_index = -1, index_entry_pos;
     size_t requested_size;
@@ -5872,6 +6094,10 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         return AVERROR(ENOMEM);
     sti->index_entries= new_entries;
 
+    ret = mov_expand_tts(sc);
+    if (ret < 0)
+        return ret;
+
     requested_size = (sti->nb_index_entries + entries) * sizeof(*sc->tts_data);
     old_allocated_size = sc->tts_allocated_size;
     tts_data = av_fast_realloc(sc->tts_data, &sc->tts_allocated_size,
@@ -8400,6 +8626,9 @@ static int cenc_filter(MOVContext *mov, AVStream* st, MOVStreamContext *sc, AVPa
         }
 
         if (mov->decryption_key) {
+            ret = av_packet_make_writable(pkt);
+            if (ret < 0)
+                return ret;
             return cenc_decrypt(mov, sc, encrypted_sample, pkt->data, pkt->size);
         } else {
             size_t size;
@@ -9935,6 +10164,9 @@ static int mov_read_close(AVFormatContext *s)
     MOVContext *mov = s->priv_data;
     int i, j;
 
+    ff_prefetch_free(&mov->prefetch_ctx);
+    ff_packet_pool_uninit(&mov->packet_pool_ctx);
+
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *st = s->streams[i];
 
@@ -10587,6 +10819,61 @@ static void fix_stream_ids(AVFormatContext *s)
     }
 }
 
+/**
+ * Set up reading of upcoming samples in the background. Only samples stored
+ * in the main input of unfragmented files are read ahead, as only their
+ * index is complete.
+ */
+static void mov_prefetch_init(AVFormatContext *s)
+{
+    MOVContext *mov = s->priv_data;
+    int64_t max_size = 0;
+    int nb_streams = 0, ret;
+
+    if (mov->frag_index.nb_items || !(s->pb->seekable & AVIO_SEEKABLE_NORMAL))
+        return;
+
+    for (int i = 0; i < s->nb_streams; i++) {
+        const FFStream *sti = ffstream(s->streams[i]);
+        const MOVStreamContext *sc = s->streams[i]->priv_data;
+
+        if (sc->pb != s->pb || !sti->nb_index_entries)
+            continue;
+        for (int j = 0; j < sti->nb_index_entries; j++)
+            max_size = FFMAX(max_size, sti->index_entries[j].size);
+        nb_streams++;
+    }
+    if (!nb_streams || !max_size)
+        return;
+
+    ret = ff_prefetch_init(&mov->prefetch_ctx, s, mov->prefetch * nb_streams, max_size);
+    if (ret < 0)
+        av_log(s, AV_LOG_WARNING, "Could not enable prefetching: %s\n", av_err2str(ret));
+}
+
+/**
+ * Queue the sample about to be read, if it is not yet, and the ones
+ * following it.
+ */
+static void mov_prefetch_schedule(MOVContext *mov, AVStream *st,
+                                  const AVIndexEntry *sample)
+{
+    const FFStream *sti = ffstream(st);
+    const MOVStreamContext *sc = st->priv_data;
+    int end = FFMIN(sti->nb_index_entries, sc->current_sample + mov->prefetch - 1);
+
+    if (sc->pb != mov->fc->pb)
+        return;
+
+    ff_prefetch_schedule(mov->prefetch_ctx, st->index, sample->pos, sample->size);
+    for (int i = sc->current_sample; i < end; i++) {
+        const AVIndexEntry *e = &sti->index_entries[i];
+        if (st->discard == AVDISCARD_NONKEY && !(e->flags & AVINDEX_KEYFRAME))
+            continue;
+        ff_prefetch_schedule(mov->prefetch_ctx, st->index, e->pos, e->size);
+    }
+}
+
 static int mov_read_header(AVFormatContext *s)
 {
     MOVContext *mov = s->priv_data;
@@ -10834,6 +11121,14 @@ static int mov_read_header(AVFormatContext *s)
         if (mov->frag_index.item[i].moof_offset <= mov->fragment.moof_offset)
             mov->frag_index.item[i].headers_read = 1;
 
+    if (mov->prefetch)
+        mov_prefetch_init(s);
+    if (mov->packet_pool) {
+        err = ff_packet_pool_init(&mov->packet_pool_ctx, mov->packet_pool_flags);
+        if (err < 0)
+            return err;
+    }
+
     return 0;
 }
 
@@ -11067,6 +11362,50 @@ static int mov_finalize_packet(AVFormatContext *s, AVStream *st, AVIndexEntry *s
     return 0;
 }
 
+/**
+ * Return a sample as a reference into the memory mapping of the input,
+ * if the protocol provides one, instead of copying it. Unless the codec
+ * is known not to read into the packet padding, this is only done when
+ * the bytes following the sample are zero, as the padding must be.
+ *
+ * @return the sample size, AVERROR(ENOSYS) if the sample has to be read
+ *         normally, or another negative AVERROR code on error
+ */
+static int mov_get_mapped_packet(AVIOContext *pb, AVPacket *pkt,
+                                 enum AVCodecID codec_id,
+                                 int64_t pos, int size)
+{
+    static const uint8_t zero_padding[AV_INPUT_BUFFER_PADDING_SIZE] = { 0 };
+    AVBufferRef *map;
+    int64_t ret;
+
+    if (size <= 0 || pos < 0 || ffio_get_mmap(pb, &map) < 0 ||
+        pos + size + AV_INPUT_BUFFER_PADDING_SIZE > map->size)
+        return AVERROR(ENOSYS);
+
+    /* The padding comes from the file here. Texture codecs never look past
+     * the end of the sample; anything else may read into the padding and
+     * rely on it being zero, so only hand out the mapping if it is. */
+    if (codec_id != AV_CODEC_ID_HAP && codec_id != AV_CODEC_ID_DXV &&
+        memcmp(map->data + pos + size, zero_padding, sizeof(zero_padding)))
+        return AVERROR(ENOSYS);
+
+    pkt->buf = av_buffer_ref(map);
+    if (!pkt->buf)
+        return AVERROR(ENOMEM);
+    pkt->data = map->data + pos;
+    pkt->size = size;
+    pkt->pos  = pos;
+
+    ret = avio_skip(pb, size);
+    if (ret < 0) {
+        av_packet_unref(pkt);
+        return ret;
+    }
+
+    return size;
+}
+
 static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MOVContext *mov = s->priv_data;
@@ -11179,8 +11518,19 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         else if (st->codecpar->codec_id == AV_CODEC_ID_APV && sample->size > 4) {
             const uint32_t au_size = avio_rb32(sc->pb);
             ret = av_get_packet(sc->pb, pkt, au_size);
-        } else
-            ret = av_get_packet(sc->pb, pkt, sample->size);
+        } else {
+            ret = mov_get_mapped_packet(sc->pb, pkt, st->codecpar->codec_id,
+                                        sample->pos, sample->size);
+            if (ret == AVERROR(ENOSYS) && mov->prefetch_ctx) {
+                mov_prefetch_schedule(mov, st, sample);
+                ret = ff_prefetch_get(mov->prefetch_ctx, pkt, st->index,
+                                      sample->pos, sample->size);
+                if (ret >= 0)
+                    avio_skip(sc->pb, sample->size);
+            }
+            if (ret == AVERROR(ENOSYS))
+                ret = ff_packet_pool_read(mov->packet_pool_ctx, sc->pb, pkt, sample->size);
+        }
         if (ret < 0) {
             if (should_retry(sc->pb, ret)) {
                 mov_current_sample_dec(sc);
@@ -11222,8 +11572,12 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
     if (st->discard == AVDISCARD_ALL)
         goto retry;
 
-    if (mov->aax_mode)
+    if (mov->aax_mode) {
+        ret = av_packet_make_writable(pkt);
+        if (ret < 0)
+            return ret;
         aax_filter(pkt->data, pkt->size, mov);
+    }
 
     ret = cenc_filter(mov, st, sc, pkt, current_index);
     if (ret < 0) {
@@ -11401,6 +11755,8 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
     if (sample < 0)
         return sample;
 
+    ff_prefetch_flush(mc->prefetch_ctx);
+
     if (mc->seek_individually) {
         /* adjust seek timestamp to found sample timestamp */
         int64_t seek_timestamp = sti->index_entries[sample].timestamp;
@@ -11491,6 +11847,11 @@ static const AVOption mov_options[] = {
         {.i64 = 0}, 0, 1, FLAGS },
     { "max_stts_delta", "treat offsets above this value as invalid", OFFSET(max_stts_delta), AV_OPT_TYPE_INT, {.i64 = UINT_MAX-48000*10 }, 0, UINT_MAX, .flags = AV_OPT_FLAG_DECODING_PARAM },
     { "interleaved_read", "Interleave packets from multiple tracks at demuxer level", OFFSET(interleaved_read), AV_OPT_TYPE_BOOL, {.i64 = 1 }, 0, 1, .flags = AV_OPT_FLAG_DECODING_PARAM },
+    { "prefetch", "Number of samples per track to read ahead in a background thread", OFFSET(prefetch), AV_OPT_TYPE_INT, {.i64 = 0 }, 0, 256, .flags = AV_OPT_FLAG_DECODING_PARAM },
+    { "packet_pool", "Reuse packet buffers of similar size", OFFSET(packet_pool), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, .flags = AV_OPT_FLAG_DECODING_PARAM },
+    { "packet_pool_flags", "Packet buffer pool flags", OFFSET(packet_pool_flags), AV_OPT_TYPE_FLAGS, {.i64 = 0 }, 0, INT_MAX, .flags = AV_OPT_FLAG_DECODING_PARAM, .unit = "packet_pool_flags" },
+        { "prefault", "Touch buffers when allocating them", 0, AV_OPT_TYPE_CONST, {.i64 = FF_PACKET_POOL_PREFAULT }, 0, 0, .flags = AV_OPT_FLAG_DECODING_PARAM, .unit = "packet_pool_flags" },
+        { "hugepages", "Back large buffers with huge pages", 0, AV_OPT_TYPE_CONST, {.i64 = FF_PACKET_POOL_HUGEPAGES }, 0, 0, .flags = AV_OPT_FLAG_DECODING_PARAM, .unit = "packet_pool_flags" },
 
     { NULL },
 };
@@ -102,6 +102,7 @@ static const AVOption options[] = {
       { "global_sidx", "Write a global sidx index at the start of the file", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_GLOBAL_SIDX}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, .unit = "movflags" },
       { "isml", "Create a live smooth streaming feed (for pushing to a publishing point)", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_ISML}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, .unit = "movflags" },
       { "moov_size", "maximum moov size so it can be placed at the begin", offsetof(MOVMuxContext, reserved_moov_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, .unit = 0 },
+      { "moov_samples", "reserve moov space at the begin for this many samples", offsetof(MOVMuxContext, moov_samples), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, .unit = 0 },
       { "negative_cts_offsets", "Use negative CTS offsets (reducing the need for edit lists)", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_NEGATIVE_CTS_OFFSETS}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, .unit = "movflags" },
       { "omit_tfhd_offset", "Omit the base data offset in tfhd atoms", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_OMIT_TFHD_OFFSET}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, .unit = "movflags" },
       { "prefer_icc", "If writing colr atom prioritise usage of ICC profile if it exists in stream packet side data", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_PREFER_ICC}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, .unit = "movflags" },
@@ -117,6 +118,7 @@ static const AVOption options[] = {
     { "mov_gamma", "gamma value for gama atom", offsetof(MOVMuxContext, gamma), AV_OPT_TYPE_FLOAT, {.dbl = 0.0 }, 0.0, 10, AV_OPT_FLAG_ENCODING_PARAM},
     { "movie_timescale", "set movie timescale", offsetof(MOVMuxContext, movie_timescale), AV_OPT_TYPE_INT, {.i64 = MOV_TIMESCALE}, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM},
     FF_RTP_FLAG_OPTS(MOVMuxContext, rtp_flags),
+    { "sample_align", "Align the start of video samples and audio chunks to this many bytes", offsetof(MOVMuxContext, sample_align), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1 << 24, AV_OPT_FLAG_ENCODING_PARAM},
     { "skip_iods", "Skip writing iods atom.", offsetof(MOVMuxContext, iods_skip), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
     { "use_editlist", "use edit list", offsetof(MOVMuxContext, use_editlist), AV_OPT_TYPE_BOOL, {.i64 = -1}, -1, 1, AV_OPT_FLAG_ENCODING_PARAM},
     { "use_stream_ids_as_track_ids", "use stream ids as track ids", offsetof(MOVMuxContext, use_stream_ids_as_track_ids), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
@@ -6818,6 +6820,19 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
         }
         av_log(s, AV_LOG_WARNING, "aac bitstream error\n");
     }
+
+    /* Start every video sample and every run of samples of other tracks,
+     * i.e. every chunk, on an aligned offset. */
+    if (mov->sample_align && pb == s->pb) {
+        int64_t pos = avio_tell(pb);
+        if (par->codec_type == AVMEDIA_TYPE_VIDEO || !trk->entry ||
+            trk->cluster[trk->entry - 1].pos + trk->cluster[trk->entry - 1].size != pos) {
+            int pad = (mov->sample_align - pos % mov->sample_align) % mov->sample_align;
+            ffio_fill(pb, 0, pad);
+            mov->mdat_size += pad;
+        }
+    }
+
     if (par->codec_id == AV_CODEC_ID_H264 && trk->extradata_size[trk->last_stsd_index] > 0 &&
         *(uint8_t *)trk->extradata[trk->last_stsd_index] != 1 && !TAG_IS_AVCI(trk->tag)) {
         /* from x264 or from bytestream H.264 */
@@ -7884,6 +7899,11 @@ static int mov_init(AVFormatContext *s)
         mov->reserved_moov_size = -1;
     }
 
+    if (mov->sample_align && mov->flags & FF_MOV_FLAG_FRAGMENT) {
+        av_log(s, AV_LOG_WARNING, "sample_align is ignored for fragmented output\n");
+        mov->sample_align = 0;
+    }
+
     if (mov->use_editlist < 0) {
         mov->use_editlist = 1;
         if (mov->flags & FF_MOV_FLAG_FRAGMENT &&
@@ -8301,6 +8321,20 @@ static int mov_init(AVFormatContext *s)
     return 0;
 }
 
+/*
+ * Upper bound of the moov size for nb_samples samples in total: every sample
+ * in its own chunk, with its own stsz, co64, stts, ctts, stsc and stss entry.
+ */
+static int64_t moov_size_estimate(MOVMuxContext *mov, int64_t nb_samples)
+{
+    int64_t size = 4096;
+
+    for (int i = 0; i < mov->nb_tracks; i++)
+        size += 1024 + mov->tracks[i].par->extradata_size;
+
+    return size + nb_samples * (4 + 8 + 8 + 8 + 12 + 4);
+}
+
 static int mov_write_header(AVFormatContext *s)
 {
     AVIOContext *pb = s->pb;
@@ -8384,6 +8418,9 @@ static int mov_write_header(AVFormatContext *s)
             return ret;
     }
 
+    if (mov->moov_samples && !(mov->flags & FF_MOV_FLAG_FRAGMENT))
+        mov->reserved_moov_size = FFMIN(moov_size_estimate(mov, mov->moov_samples), INT_MAX);
+
     if (mov->reserved_moov_size){
         mov->reserved_header_pos = avio_tell(pb);
         if (mov->reserved_moov_size > 0)
@@ -8403,7 +8440,7 @@ static int mov_write_header(AVFormatContext *s)
             mov->mdat_pos = avio_tell(pb);
         }
     } else if (mov->mode != MODE_AVIF) {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && !mov->moov_samples)
             mov->reserved_header_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
@@ -8519,6 +8556,28 @@ static int compute_moov_size(AVFormatContext *s)
         for (i = 0; i < mov->nb_tracks; i++)
             mov->tracks[i].data_offset += moov_size2 - moov_size;
 
+    /* Keep the samples aligned by following the moov with a free atom
+     * that rounds the shift up to a multiple of the alignment. The offsets
+     * only ever grow here, so this ends after at most one co64 switch. */
+    if (mov->sample_align) {
+        int shift = moov_size2, pad;
+        for (;;) {
+            moov_size = get_moov_size(s);
+            if (moov_size < 0)
+                return moov_size;
+            pad = (mov->sample_align - moov_size % mov->sample_align) % mov->sample_align;
+            while ((pad && pad < 8) || moov_size + pad < shift)
+                pad += mov->sample_align;
+            if (moov_size + pad == shift)
+                break;
+            for (i = 0; i < mov->nb_tracks; i++)
+                mov->tracks[i].data_offset += moov_size + pad - shift;
+            shift = moov_size + pad;
+        }
+        mov->sample_align_pad = pad;
+        return shift;
+    }
+
     return moov_size2;
 }
 
@@ -8626,6 +8685,22 @@ static int mov_write_trailer(AVFormatContext *s)
             ffio_wfourcc(pb, "mdat");
             avio_wb64(pb, mov->mdat_size + 16);
         }
+        if (mov->moov_samples && mov->reserved_moov_size > 0) {
+            int64_t size = get_moov_size(s);
+            if (size < 0)
+                return size;
+            if (size + 8 > mov->reserved_moov_size) {
+                av_log(s, AV_LOG_WARNING, "Reserved moov space of %d bytes is too small, "
+                       "%"PRId64" needed\n", mov->reserved_moov_size, size + 8);
+                avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
+                avio_wb32(pb, mov->reserved_moov_size);
+                ffio_wfourcc(pb, "free");
+                mov->reserved_moov_size = 0;
+            } else {
+                mov->flags &= ~FF_MOV_FLAG_FASTSTART;
+            }
+        }
+
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
         if (mov->flags & FF_MOV_FLAG_FASTSTART) {
@@ -8636,6 +8711,11 @@ static int mov_write_trailer(AVFormatContext *s)
             avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
                 return res;
+            if (mov->sample_align_pad) {
+                avio_wb32(pb, mov->sample_align_pad);
+                ffio_wfourcc(pb, "free");
+                ffio_fill(pb, 0, mov->sample_align_pad - 8);
+            }
         } else if (mov->reserved_moov_size > 0) {
             int64_t size;
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
@@ -229,6 +229,7 @@ typedef struct MOVMuxContext {
     int video_track_timescale;
 
     int reserved_moov_size; ///< 0 for disabled, -1 for automatic, size otherwise
+    int moov_samples;       ///< expected number of samples to reserve moov space for
     int64_t reserved_header_pos;
 
     char *major_brand;
@@ -244,6 +245,9 @@ typedef struct MOVMuxContext {
     int frag_interleave;
     int missing_duration_warned;
 
+    int sample_align;
+    int sample_align_pad; ///< size of the free atom written after a moved moov
+
     char *encryption_scheme_str;
     MOVEncryptionScheme encryption_scheme;
     uint8_t *encryption_key;
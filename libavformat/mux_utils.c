@@ -26,6 +26,7 @@
 #include "libavutil/parseutils.h"
 #include "avformat.h"
 #include "avio.h"
+#include "avio_internal.h"
 #include "internal.h"
 #include "mux.h"
 
@@ -87,15 +88,24 @@ int ff_format_shift_data(AVFormatContext *s, int64_t read_start, int shift_size)
      * writing, so we re-open the same output, but for reading. It also avoids
      * a read/seek/write/seek back and forth. */
     avio_flush(s->pb);
+    pos_end = avio_tell(s->pb);
+
+    /* Let the protocol move the data itself if it can. */
+    ret = ffio_shift_data(s->pb, read_start, pos_end, shift_size);
+    if (ret != AVERROR(ENOSYS)) {
+        if (ret >= 0)
+            avio_seek(s->pb, pos_end + shift_size, SEEK_SET);
+        goto end;
+    }
+
     ret = s->io_open(s, &read_pb, s->url, AVIO_FLAG_READ, NULL);
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Unable to re-open %s output file for shifting data\n", s->url);
         goto end;
     }
 
-    /* mark the end of the shift to up to the last data we wrote, and get ready
-     * for writing */
-    pos_end = avio_tell(s->pb);
+    /* the end of the shift is the last data we wrote, get ready for
+     * writing */
     avio_seek(s->pb, read_start + shift_size, SEEK_SET);
 
     avio_seek(read_pb, read_start, SEEK_SET);
@@ -0,0 +1,158 @@
+/*
+ * Size class pools for demuxed packets
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "libavcodec/defs.h"
+#include "avformat.h"
+#include "avio_internal.h"
+#include "packetpool.h"
+
+/* Sizes are rounded up to one of four steps per power of two, which wastes
+ * at most a fifth of a buffer while letting packets whose size varies a bit
+ * from one to the next share buffers. */
+#define CLASS_STEPS    4
+#define MIN_CLASS_BITS 12
+#define MAX_CLASS_BITS 28
+#define NB_CLASSES     ((MAX_CLASS_BITS - MIN_CLASS_BITS + 1) * CLASS_STEPS)
+
+/* same as in av_get_packet(), larger reads are checked against the input size */
+#define SANE_READ_SIZE (50000000 / 10)
+
+struct FFPacketPool {
+    int flags;
+    AVBufferPool *pools[NB_CLASSES];
+};
+
+static int size_class(size_t size, size_t *class_size)
+{
+    int bits = size > 1 ? av_log2(size - 1) : 0;
+    size_t step;
+    int idx;
+
+    if (bits < MIN_CLASS_BITS) {
+        *class_size = ((size_t)1 << MIN_CLASS_BITS) / CLASS_STEPS * (CLASS_STEPS + 1);
+        return 0;
+    }
+    if (bits > MAX_CLASS_BITS)
+        return -1;
+
+    step = ((size_t)1 << bits) / CLASS_STEPS;
+    idx  = (size - ((size_t)1 << bits) + step - 1) / step;
+    *class_size = ((size_t)1 << bits) + idx * step;
+    return (bits - MIN_CLASS_BITS) * CLASS_STEPS + idx - 1;
+}
+
+int ff_packet_pool_init(FFPacketPool **ppp, int flags)
+{
+    FFPacketPool *pp = av_mallocz(sizeof(*pp));
+
+    *ppp = pp;
+    if (!pp)
+        return AVERROR(ENOMEM);
+    pp->flags = flags;
+    return 0;
+}
+
+AVBufferRef *ff_packet_pool_get_buffer(FFPacketPool *pp, int size)
+{
+    size_t class_size;
+    int idx;
+
+    if (size < 0 || size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return NULL;
+
+    idx = size_class((size_t)size + AV_INPUT_BUFFER_PADDING_SIZE, &class_size);
+    if (idx < 0)
+        return av_buffer_alloc((size_t)size + AV_INPUT_BUFFER_PADDING_SIZE);
+
+    if (!pp->pools[idx]) {
+        pp->pools[idx] = pp->flags ? av_buffer_pool_init_flags(class_size, pp->flags) :
+                                     av_buffer_pool_init(class_size, NULL);
+        if (!pp->pools[idx])
+            return NULL;
+    }
+    return av_buffer_pool_get(pp->pools[idx]);
+}
+
+int ff_packet_pool_get(FFPacketPool *pp, AVPacket *pkt, int size)
+{
+    AVBufferRef *buf;
+
+    if (size < 0 || size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return AVERROR(EINVAL);
+
+    buf = ff_packet_pool_get_buffer(pp, size);
+    if (!buf)
+        return AVERROR(ENOMEM);
+
+    av_packet_unref(pkt);
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    pkt->size = size;
+    memset(pkt->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    return 0;
+}
+
+int ff_packet_pool_read(FFPacketPool *pp, AVIOContext *pb, AVPacket *pkt, int size)
+{
+    int64_t pos = avio_tell(pb);
+    int ret;
+
+    if (size > SANE_READ_SIZE) {
+        size = ffio_limit(pb, size);
+        if (ffiocontext(pb)->maxsize < 0)
+            return av_get_packet(pb, pkt, size);
+    }
+    if (!pp || size <= 0)
+        return av_get_packet(pb, pkt, size);
+
+    ret = ff_packet_pool_get(pp, pkt, size);
+    if (ret < 0)
+        return ret;
+    pkt->pos = pos;
+
+    ret = avio_read(pb, pkt->data, size);
+    if (ret != size) {
+        if (ret <= 0) {
+            av_packet_unref(pkt);
+            return ret;
+        }
+        av_shrink_packet(pkt, ret);
+        pkt->flags |= AV_PKT_FLAG_CORRUPT;
+    }
+    return ret;
+}
+
+void ff_packet_pool_uninit(FFPacketPool **ppp)
+{
+    FFPacketPool *pp = *ppp;
+
+    if (!pp)
+        return;
+    for (int i = 0; i < NB_CLASSES; i++)
+        av_buffer_pool_uninit(&pp->pools[i]);
+    av_freep(ppp);
+}
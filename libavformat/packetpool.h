@@ -0,0 +1,74 @@
+/*
+ * Size class pools for demuxed packets
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_PACKETPOOL_H
+#define AVFORMAT_PACKETPOOL_H
+
+#include "libavutil/buffer.h"
+#include "libavcodec/packet.h"
+#include "avio.h"
+
+/**
+ * Hands out packet buffers from a set of AVBufferPools, one per size class,
+ * so that demuxers of codecs with large packets of similar size, e.g.
+ * intra-only video, do not allocate and fault in fresh memory for every
+ * packet. Buffers return to their pool when the last reference to them is
+ * dropped, wherever that happens, and stay valid after the pool itself is
+ * uninitialized.
+ */
+typedef struct FFPacketPool FFPacketPool;
+
+/**
+ * Touch every page of a buffer when it is allocated, so that packets read
+ * into it do not page fault.
+ */
+#define FF_PACKET_POOL_PREFAULT  AV_BUFFER_POOL_FLAG_PREFAULT
+/**
+ * Back large buffers with transparent huge pages where available.
+ */
+#define FF_PACKET_POOL_HUGEPAGES AV_BUFFER_POOL_FLAG_HUGEPAGES
+
+/**
+ * @param flags a combination of FF_PACKET_POOL_* flags
+ */
+int ff_packet_pool_init(FFPacketPool **ppp, int flags);
+
+/**
+ * Like av_new_packet(), but take the buffer from the pool. Sizes beyond the
+ * largest size class are allocated normally.
+ */
+int ff_packet_pool_get(FFPacketPool *pp, AVPacket *pkt, int size);
+
+/**
+ * Return a buffer with room for size bytes plus padding, taken from the pool
+ * like in ff_packet_pool_get(). Neither the data nor the padding is zeroed.
+ *
+ * @return the buffer, or NULL on failure
+ */
+AVBufferRef *ff_packet_pool_get_buffer(FFPacketPool *pp, int size);
+
+/**
+ * Like av_get_packet(), but with the buffer taken from the pool.
+ */
+int ff_packet_pool_read(FFPacketPool *pp, AVIOContext *pb, AVPacket *pkt, int size);
+
+void ff_packet_pool_uninit(FFPacketPool **ppp);
+
+#endif /* AVFORMAT_PACKETPOOL_H */
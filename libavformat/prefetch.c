@@ -0,0 +1,365 @@
+/*
+ * Background read-ahead of known byte ranges
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "config.h"
+
+#include "libavutil/buffer.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavcodec/defs.h"
+#include "avio.h"
+#include "internal.h"
+#include "packetpool.h"
+#include "prefetch.h"
+
+#if HAVE_THREADS
+
+enum SlotState {
+    SLOT_FREE,
+    SLOT_QUEUED,
+    SLOT_READING,
+    SLOT_DONE,
+    SLOT_CANCELLED,     ///< flushed while being read, freed by the thread
+};
+
+typedef struct PrefetchSlot {
+    enum SlotState state;
+    int            stream;
+    int64_t        seq;
+    int64_t        pos;
+    int            size;
+    AVBufferRef   *buf;
+} PrefetchSlot;
+
+struct FFPrefetch {
+    AVFormatContext *s;
+    AVIOContext     *pb;
+    FFPacketPool    *pool;      ///< only used by the thread
+    size_t           max_size;
+
+    PrefetchSlot    *slots;
+    int              nb_slots;
+    int64_t          next_seq;
+
+    pthread_mutex_t  mutex;
+    pthread_cond_t   cond;
+    pthread_t        thread;
+    int              abort_request;
+};
+
+static PrefetchSlot *find_slot(FFPrefetch *pf, int stream, int64_t pos, int size)
+{
+    for (int i = 0; i < pf->nb_slots; i++) {
+        PrefetchSlot *slot = &pf->slots[i];
+        if (slot->state != SLOT_FREE && slot->state != SLOT_CANCELLED &&
+            slot->stream == stream && slot->pos == pos && slot->size == size)
+            return slot;
+    }
+    return NULL;
+}
+
+static void drop_slot(PrefetchSlot *slot)
+{
+    if (slot->state == SLOT_READING) {
+        slot->state = SLOT_CANCELLED;
+    } else if (slot->state != SLOT_CANCELLED) {
+        av_buffer_unref(&slot->buf);
+        slot->state = SLOT_FREE;
+    }
+}
+
+/* Drop ranges of a stream that were queued before seq, i.e. were skipped
+ * by the demuxer and would otherwise hold their slot forever. */
+static void drop_stale(FFPrefetch *pf, int stream, int64_t seq)
+{
+    for (int i = 0; i < pf->nb_slots; i++) {
+        PrefetchSlot *slot = &pf->slots[i];
+        if (slot->stream == stream && slot->seq < seq)
+            drop_slot(slot);
+    }
+}
+
+static PrefetchSlot *next_queued(FFPrefetch *pf)
+{
+    PrefetchSlot *next = NULL;
+    for (int i = 0; i < pf->nb_slots; i++) {
+        PrefetchSlot *slot = &pf->slots[i];
+        if (slot->state == SLOT_QUEUED && (!next || slot->seq < next->seq))
+            next = slot;
+    }
+    return next;
+}
+
+static int read_range(FFPrefetch *pf, AVBufferRef **pbuf, int64_t pos, int size)
+{
+    AVBufferRef *buf;
+    int64_t ret;
+
+    buf = ff_packet_pool_get_buffer(pf->pool, size);
+    if (!buf)
+        return AVERROR(ENOMEM);
+
+    ret = avio_seek(pf->pb, pos, SEEK_SET);
+    if (ret >= 0)
+        ret = avio_read(pf->pb, buf->data, size);
+    if (ret != size) {
+        av_buffer_unref(&buf);
+        return ret < 0 ? ret : AVERROR_INVALIDDATA;
+    }
+    memset(buf->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    *pbuf = buf;
+    return 0;
+}
+
+static void *prefetch_thread(void *arg)
+{
+    FFPrefetch *pf = arg;
+
+    pthread_mutex_lock(&pf->mutex);
+    while (!pf->abort_request) {
+        PrefetchSlot *slot = next_queued(pf);
+        AVBufferRef *buf = NULL;
+        int64_t pos;
+        int size, ret;
+
+        if (!slot) {
+            pthread_cond_wait(&pf->cond, &pf->mutex);
+            continue;
+        }
+
+        slot->state = SLOT_READING;
+        pos  = slot->pos;
+        size = slot->size;
+        pthread_mutex_unlock(&pf->mutex);
+
+        ret = read_range(pf, &buf, pos, size);
+
+        pthread_mutex_lock(&pf->mutex);
+        if (ret < 0 && ret != AVERROR_EXIT)
+            av_log(pf->s, AV_LOG_DEBUG, "Prefetching %d bytes at 0x%"PRIx64" failed: %s\n",
+                   size, pos, av_err2str(ret));
+        if (slot->state == SLOT_CANCELLED) {
+            av_buffer_unref(&buf);
+            slot->state = SLOT_FREE;
+        } else {
+            /* A failed read leaves buf NULL, the demuxer then reads the
+             * range itself and reports the error. */
+            slot->buf   = buf;
+            slot->state = SLOT_DONE;
+        }
+        pthread_cond_broadcast(&pf->cond);
+    }
+    pthread_mutex_unlock(&pf->mutex);
+
+    return NULL;
+}
+
+int ff_prefetch_init(FFPrefetch **ppf, AVFormatContext *s,
+                     int nb_slots, size_t max_size)
+{
+    FFPrefetch *pf;
+    int ret;
+
+    *ppf = NULL;
+
+    if (nb_slots <= 0 || !max_size || max_size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return AVERROR(EINVAL);
+    if (s->flags & AVFMT_FLAG_CUSTOM_IO)
+        return AVERROR(ENOSYS);
+
+    pf = av_mallocz(sizeof(*pf));
+    if (!pf)
+        return AVERROR(ENOMEM);
+    pf->s        = s;
+    pf->max_size = max_size;
+    pf->nb_slots = nb_slots;
+
+    pf->slots = av_calloc(nb_slots, sizeof(*pf->slots));
+    if (!pf->slots) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    /* Sized per range, so that small samples of one stream do not take
+     * buffers as large as the largest sample of another. */
+    ret = ff_packet_pool_init(&pf->pool, 0);
+    if (ret < 0)
+        goto fail;
+
+    ret = s->io_open(s, &pf->pb, s->url, AVIO_FLAG_READ, NULL);
+    if (ret < 0)
+        goto fail;
+
+    ret = pthread_mutex_init(&pf->mutex, NULL);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    ret = pthread_cond_init(&pf->cond, NULL);
+    if (ret) {
+        pthread_mutex_destroy(&pf->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    ret = pthread_create(&pf->thread, NULL, prefetch_thread, pf);
+    if (ret) {
+        pthread_cond_destroy(&pf->cond);
+        pthread_mutex_destroy(&pf->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    *ppf = pf;
+    return 0;
+fail:
+    ff_format_io_close(s, &pf->pb);
+    ff_packet_pool_uninit(&pf->pool);
+    av_freep(&pf->slots);
+    av_freep(&pf);
+    return ret;
+}
+
+void ff_prefetch_schedule(FFPrefetch *pf, int stream, int64_t pos, int size)
+{
+    if (!pf || pos < 0 || size <= 0 || size > pf->max_size)
+        return;
+
+    pthread_mutex_lock(&pf->mutex);
+    if (!find_slot(pf, stream, pos, size)) {
+        for (int i = 0; i < pf->nb_slots; i++) {
+            PrefetchSlot *slot = &pf->slots[i];
+            if (slot->state != SLOT_FREE)
+                continue;
+            slot->state  = SLOT_QUEUED;
+            slot->stream = stream;
+            slot->seq    = pf->next_seq++;
+            slot->pos    = pos;
+            slot->size   = size;
+            pthread_cond_broadcast(&pf->cond);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pf->mutex);
+}
+
+int ff_prefetch_get(FFPrefetch *pf, AVPacket *pkt, int stream,
+                    int64_t pos, int size)
+{
+    PrefetchSlot *slot;
+    AVBufferRef *buf;
+
+    if (!pf)
+        return AVERROR(ENOSYS);
+
+    pthread_mutex_lock(&pf->mutex);
+    slot = find_slot(pf, stream, pos, size);
+    if (!slot) {
+        drop_stale(pf, stream, INT64_MAX);
+        pthread_mutex_unlock(&pf->mutex);
+        return AVERROR(ENOSYS);
+    }
+    drop_stale(pf, stream, slot->seq);
+    /* This range is needed before anything else that is queued, so have
+     * it read next. */
+    if (slot->state == SLOT_QUEUED)
+        slot->seq = -1;
+    while (slot->state != SLOT_DONE)
+        pthread_cond_wait(&pf->cond, &pf->mutex);
+    buf         = slot->buf;
+    slot->buf   = NULL;
+    slot->state = SLOT_FREE;
+    pthread_mutex_unlock(&pf->mutex);
+
+    if (!buf)
+        return AVERROR(ENOSYS);
+
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    pkt->size = size;
+    pkt->pos  = pos;
+    return size;
+}
+
+void ff_prefetch_flush(FFPrefetch *pf)
+{
+    if (!pf)
+        return;
+
+    pthread_mutex_lock(&pf->mutex);
+    for (int i = 0; i < pf->nb_slots; i++)
+        drop_slot(&pf->slots[i]);
+    pthread_mutex_unlock(&pf->mutex);
+}
+
+void ff_prefetch_free(FFPrefetch **ppf)
+{
+    FFPrefetch *pf = *ppf;
+
+    if (!pf)
+        return;
+
+    pthread_mutex_lock(&pf->mutex);
+    pf->abort_request = 1;
+    pthread_cond_broadcast(&pf->cond);
+    pthread_mutex_unlock(&pf->mutex);
+    pthread_join(pf->thread, NULL);
+
+    for (int i = 0; i < pf->nb_slots; i++)
+        av_buffer_unref(&pf->slots[i].buf);
+    pthread_cond_destroy(&pf->cond);
+    pthread_mutex_destroy(&pf->mutex);
+    ff_format_io_close(pf->s, &pf->pb);
+    ff_packet_pool_uninit(&pf->pool);
+    av_freep(&pf->slots);
+    av_freep(ppf);
+}
+
+#else
+
+int ff_prefetch_init(FFPrefetch **ppf, AVFormatContext *s,
+                     int nb_slots, size_t max_size)
+{
+    *ppf = NULL;
+    return AVERROR(ENOSYS);
+}
+
+void ff_prefetch_schedule(FFPrefetch *pf, int stream, int64_t pos, int size)
+{
+}
+
+int ff_prefetch_get(FFPrefetch *pf, AVPacket *pkt, int stream,
+                    int64_t pos, int size)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_prefetch_flush(FFPrefetch *pf)
+{
+}
+
+void ff_prefetch_free(FFPrefetch **ppf)
+{
+}
+
+#endif /* HAVE_THREADS */
@@ -0,0 +1,78 @@
+/*
+ * Background read-ahead of known byte ranges
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_PREFETCH_H
+#define AVFORMAT_PREFETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libavcodec/packet.h"
+#include "avformat.h"
+
+/**
+ * Reads byte ranges that a demuxer knows it will need soon, e.g. from its
+ * sample index, on a separate I/O handle in a background thread, so that
+ * the demuxer does not block on them when it gets there.
+ */
+typedef struct FFPrefetch FFPrefetch;
+
+/**
+ * Open a second handle on the input of s and start the read-ahead thread.
+ *
+ * @param nb_slots number of ranges that can be queued or held at once
+ * @param max_size size of the largest range that will be requested
+ * @return 0 on success, a negative AVERROR code on failure, in which case
+ *         the caller should simply read everything itself
+ */
+int ff_prefetch_init(FFPrefetch **ppf, AVFormatContext *s,
+                     int nb_slots, size_t max_size);
+
+/**
+ * Queue a range for reading, unless it is already queued or there is no
+ * free slot. Ranges are read in the order they were queued.
+ *
+ * @param stream identifies the sequence the range belongs to; ranges of one
+ *               stream are expected to be retrieved in the order queued
+ */
+void ff_prefetch_schedule(FFPrefetch *pf, int stream, int64_t pos, int size);
+
+/**
+ * Return a queued range as a packet, waiting for it to be read if needed.
+ * pkt->pos is set, padding is zeroed. Ranges of the same stream queued
+ * before this one, or all of them if it was not queued, are dropped.
+ *
+ * @return size on success, AVERROR(ENOSYS) if the range was not queued or
+ *         could not be read, in which case the caller reads it itself
+ */
+int ff_prefetch_get(FFPrefetch *pf, AVPacket *pkt, int stream,
+                    int64_t pos, int size);
+
+/**
+ * Drop all queued ranges, e.g. after a seek.
+ */
+void ff_prefetch_flush(FFPrefetch *pf);
+
+/**
+ * Stop the thread, close the handle and free the context.
+ */
+void ff_prefetch_free(FFPrefetch **ppf);
+
+#endif /* AVFORMAT_PREFETCH_H */
@@ -0,0 +1,206 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Demuxes MOV files written by the muxer and then altered in ways the muxer
+ * never produces, checking that they open and read the same as they used to.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+
+#include "libavformat/avformat.h"
+
+#define NB_SAMPLES 4
+
+typedef struct MemFile {
+    uint8_t *data;
+    int      size;
+    int      pos;
+} MemFile;
+
+static int mem_read(void *opaque, uint8_t *buf, int size)
+{
+    MemFile *f = opaque;
+
+    size = FFMIN(size, f->size - f->pos);
+    if (size <= 0)
+        return AVERROR_EOF;
+    memcpy(buf, f->data + f->pos, size);
+    f->pos += size;
+    return size;
+}
+
+static int64_t mem_seek(void *opaque, int64_t offset, int whence)
+{
+    MemFile *f = opaque;
+
+    whence &= ~AVSEEK_FORCE;
+    if (whence == AVSEEK_SIZE)
+        return f->size;
+    if (whence == SEEK_CUR)
+        offset += f->pos;
+    else if (whence == SEEK_END)
+        offset += f->size;
+    if (offset < 0 || offset > f->size)
+        return AVERROR(EINVAL);
+    return f->pos = offset;
+}
+
+/* Write a video track with NB_SAMPLES samples of different sizes. */
+static int write_file(MemFile *f)
+{
+    AVFormatContext *s;
+    AVPacket *pkt;
+    AVStream *st;
+    int ret;
+
+    ret = avformat_alloc_output_context2(&s, NULL, "mov", NULL);
+    if (ret < 0)
+        return ret;
+    pkt = av_packet_alloc();
+    st  = avformat_new_stream(s, NULL);
+    if (!pkt || !st) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    st->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    st->codecpar->codec_id   = AV_CODEC_ID_HAP;
+    st->codecpar->width      = 16;
+    st->codecpar->height     = 16;
+    st->time_base            = (AVRational){ 1, 25 };
+
+    if ((ret = avio_open_dyn_buf(&s->pb)) < 0 ||
+        (ret = avformat_write_header(s, NULL)) < 0)
+        goto end;
+
+    for (int i = 0; i < NB_SAMPLES; i++) {
+        if ((ret = av_new_packet(pkt, 100 * (i + 1))) < 0)
+            goto end;
+        memset(pkt->data, i + 1, pkt->size);
+        pkt->pts = pkt->dts = i;
+        pkt->duration = 1;
+        pkt->flags = AV_PKT_FLAG_KEY;
+        if ((ret = av_write_frame(s, pkt)) < 0)
+            goto end;
+    }
+    ret = av_write_trailer(s);
+
+end:
+    if (s->pb)
+        f->size = avio_close_dyn_buf(s->pb, &f->data);
+    s->pb = NULL;
+    av_packet_free(&pkt);
+    avformat_free_context(s);
+    return ret;
+}
+
+/* Replace the size of a sample in the sample size table. */
+static int set_sample_size(MemFile *f, int sample, uint32_t size)
+{
+    for (int i = 4; i + 16 + 4 * NB_SAMPLES <= f->size; i++) {
+        if (memcmp(f->data + i, "stsz", 4))
+            continue;
+        if (AV_RB32(f->data + i + 8) || AV_RB32(f->data + i + 12) != NB_SAMPLES)
+            return AVERROR_INVALIDDATA;
+        AV_WB32(f->data + i + 16 + 4 * sample, size);
+        return 0;
+    }
+    return AVERROR_INVALIDDATA;
+}
+
+static void read_file(MemFile *f, const char *name)
+{
+    AVFormatContext *s = NULL;
+    AVIOContext *pb = NULL;
+    uint8_t *iobuf;
+    AVPacket *pkt;
+    int ret;
+
+    printf("%s\n", name);
+
+    pkt   = av_packet_alloc();
+    iobuf = av_malloc(4096);
+    if (iobuf)
+        pb = avio_alloc_context(iobuf, 4096, 0, f, mem_read, NULL, mem_seek);
+    if (pb)
+        s = avformat_alloc_context();
+    if (!pkt || !s) {
+        printf("open: %s\n", av_err2str(AVERROR(ENOMEM)));
+        avformat_free_context(s);
+        goto end;
+    }
+    f->pos = 0;
+    s->pb  = pb;
+
+    ret = avformat_open_input(&s, NULL, NULL, NULL);
+    if (ret < 0) {
+        printf("open: %s\n", av_err2str(ret));
+        goto end;
+    }
+    while ((ret = av_read_frame(s, pkt)) >= 0) {
+        printf("packet: pts %"PRId64" size %d\n", pkt->pts, pkt->size);
+        av_packet_unref(pkt);
+    }
+    if (ret != AVERROR_EOF)
+        printf("read: %s\n", av_err2str(ret));
+    avformat_close_input(&s);
+
+end:
+    if (pb)
+        av_freep(&pb->buffer);
+    else
+        av_free(iobuf);
+    avio_context_free(&pb);
+    av_packet_free(&pkt);
+}
+
+int main(void)
+{
+    MemFile f = { 0 };
+    int ret;
+
+    av_log_set_level(AV_LOG_QUIET);
+
+    ret = write_file(&f);
+    if (ret < 0) {
+        fprintf(stderr, "Writing the file failed: %s\n", av_err2str(ret));
+        goto end;
+    }
+    read_file(&f, "unaltered");
+
+    /* Sizes not fitting in an int are kept as read, not rejected. */
+    ret = set_sample_size(&f, 1, 0x80000000);
+    if (ret < 0) {
+        fprintf(stderr, "No sample size table found\n");
+        goto end;
+    }
+    read_file(&f, "stsz entry 0x80000000");
+
+    ret = set_sample_size(&f, 1, 0xFFFFFFFF);
+    if (ret >= 0)
+        read_file(&f, "stsz entry 0xFFFFFFFF");
+
+end:
+    av_free(f.data);
+    return ret < 0;
+}
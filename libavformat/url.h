@@ -26,6 +26,7 @@
 
 #include "avio.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
 
@@ -83,6 +84,8 @@ typedef struct URLProtocol {
     int (*url_get_multi_file_handle)(URLContext *h, int **handles,
                                      int *numhandles);
     int (*url_get_short_seek)(URLContext *h);
+    int (*url_get_mmap)(URLContext *h, AVBufferRef **buf);
+    int (*url_shift_data)(URLContext *h, int64_t start, int64_t end, int shift);
     int (*url_shutdown)(URLContext *h, int flags);
     const AVClass *priv_data_class;
     int priv_data_size;
@@ -263,6 +266,28 @@ int ffurl_get_multi_file_handle(URLContext *h, int **handles, int *numhandles);
  */
 int ffurl_get_short_seek(void *urlcontext);
 
+/**
+ * Return a read-only mapping of the whole resource, if the protocol
+ * provides one. Offsets in the mapping are resource offsets.
+ *
+ * @param buf set to the mapping on success; no new reference is taken,
+ *            call av_buffer_ref() to keep data past ffurl_close()
+ * @return 0 on success, a negative AVERROR code if there is no mapping
+ */
+int ffurl_get_mmap(URLContext *h, AVBufferRef **buf);
+
+/**
+ * Move the data in [start, end) of the resource by shift bytes towards its
+ * end without passing it through user space, if the protocol supports it.
+ * The data after end may be overwritten. The position is undefined after
+ * the call.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if it is not supported, in which
+ *         case the resource is unchanged, another negative AVERROR code
+ *         on failure
+ */
+int ffurl_shift_data(URLContext *h, int64_t start, int64_t end, int shift);
+
 /**
  * Signal the URLContext that we are done reading or writing the stream.
  *
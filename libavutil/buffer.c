@@ -16,10 +16,25 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+/* for MAP_ANONYMOUS, MAP_HUGETLB, MADV_HUGEPAGE and syscall() */
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
 #include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
 
+#include "config.h"
+
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#if HAVE_MMAP && defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include "avassert.h"
 #include "buffer_internal.h"
 #include "common.h"
@@ -299,6 +314,137 @@ AVBufferPool *av_buffer_pool_init(size_t size, AVBufferRef* (*alloc)(size_t size
     return pool;
 }
 
+#define POOL_HUGEPAGE_SIZE (2 << 20)
+
+#if HAVE_MMAP && defined(MAP_ANONYMOUS)
+#define POOL_USE_MMAP 1
+#else
+#define POOL_USE_MMAP 0
+#endif
+
+#if POOL_USE_MMAP && defined(SYS_getcpu) && defined(SYS_mbind)
+#define POOL_USE_MBIND 1
+#define POOL_MPOL_PREFERRED 1 // MPOL_PREFERRED from linux/mempolicy.h
+#else
+#define POOL_USE_MBIND 0
+#endif
+
+#if POOL_USE_MMAP
+static void pool_free_mapping(void *opaque, uint8_t *data)
+{
+    munmap(data, (size_t)(uintptr_t)opaque);
+}
+
+/* Huge pages can only back aligned ranges, so map one more than needed and
+ * trim the mapping to an aligned start. */
+static uint8_t *pool_map_hugepages(size_t map_size)
+{
+    uint8_t *map, *data;
+
+    map = mmap(NULL, map_size + POOL_HUGEPAGE_SIZE, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return NULL;
+    data = (uint8_t *)FFALIGN((uintptr_t)map, POOL_HUGEPAGE_SIZE);
+    if (data > map)
+        munmap(map, data - map);
+    munmap(data + map_size, map + POOL_HUGEPAGE_SIZE - data);
+#ifdef MADV_HUGEPAGE
+    madvise(data, map_size, MADV_HUGEPAGE);
+#endif
+    return data;
+}
+
+static uint8_t *pool_map(int flags, size_t size, size_t *map_size)
+{
+    uint8_t *data;
+
+    if ((flags & (AV_BUFFER_POOL_FLAG_HUGEPAGES | AV_BUFFER_POOL_FLAG_HUGETLB)) &&
+        size >= POOL_HUGEPAGE_SIZE) {
+        *map_size = FFALIGN(size, POOL_HUGEPAGE_SIZE);
+#ifdef MAP_HUGETLB
+        if (flags & AV_BUFFER_POOL_FLAG_HUGETLB) {
+            data = mmap(NULL, *map_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (data != MAP_FAILED)
+                return data;
+        }
+#endif
+        return pool_map_hugepages(*map_size);
+    }
+
+    *map_size = size;
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return data == MAP_FAILED ? NULL : data;
+}
+#endif
+
+#if POOL_USE_MBIND
+/* Must be called before the pages are touched, as the policy only applies
+ * to pages faulted in afterwards. */
+static void pool_bind_local_node(uint8_t *data, size_t size)
+{
+    unsigned long nodemask[16] = { 0 };
+    const unsigned bits = 8 * sizeof(*nodemask);
+    unsigned node;
+
+    if (syscall(SYS_getcpu, NULL, &node, NULL) < 0 ||
+        node >= FF_ARRAY_ELEMS(nodemask) * bits)
+        return;
+    nodemask[node / bits] = 1UL << node % bits;
+    syscall(SYS_mbind, data, size, POOL_MPOL_PREFERRED, nodemask,
+            FF_ARRAY_ELEMS(nodemask) * bits + 1, 0);
+}
+#endif
+
+static AVBufferRef *pool_alloc_flags(void *opaque, size_t size)
+{
+    AVBufferPool *pool = opaque;
+    AVBufferRef *buf = NULL;
+
+#if POOL_USE_MMAP
+    if (pool->flags & (AV_BUFFER_POOL_FLAG_HUGEPAGES | AV_BUFFER_POOL_FLAG_HUGETLB |
+                       AV_BUFFER_POOL_FLAG_NUMA_LOCAL)) {
+        size_t map_size;
+        uint8_t *data = pool_map(pool->flags, size, &map_size);
+
+        if (data) {
+#if POOL_USE_MBIND
+            if (pool->flags & AV_BUFFER_POOL_FLAG_NUMA_LOCAL)
+                pool_bind_local_node(data, map_size);
+#endif
+            /* anonymous mappings are zeroed, writing one byte per page is
+             * enough to fault them in */
+            if (pool->flags & AV_BUFFER_POOL_FLAG_PREFAULT)
+                for (size_t i = 0; i < size; i += 4096)
+                    data[i] = 0;
+
+            buf = av_buffer_create(data, size, pool_free_mapping,
+                                   (void *)(uintptr_t)map_size, 0);
+            if (!buf)
+                munmap(data, map_size);
+        }
+    }
+#endif
+    /* zeroing the buffer also prefaults it */
+    if (!buf)
+        buf = av_buffer_allocz(size);
+    return buf;
+}
+
+AVBufferPool *av_buffer_pool_init_flags(size_t size, int flags)
+{
+    AVBufferPool *pool = av_buffer_pool_init2(size, NULL, pool_alloc_flags, NULL);
+    if (!pool)
+        return NULL;
+
+    pool->opaque = pool;
+    pool->flags  = flags;
+
+    return pool;
+}
+
 static void buffer_pool_flush(AVBufferPool *pool)
 {
     while (pool->pool) {
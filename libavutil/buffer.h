@@ -284,6 +284,49 @@ AVBufferPool *av_buffer_pool_init2(size_t size, void *opaque,
                                    AVBufferRef* (*alloc)(void *opaque, size_t size),
                                    void (*pool_free)(void *opaque));
 
+/**
+ * @defgroup lavu_bufferpool_flags Buffer pool flags
+ * Flags controlling how av_buffer_pool_init_flags() allocates new buffers.
+ * They are hints: a flag the system does not support is silently ignored.
+ * @{
+ */
+/**
+ * Touch every page of a buffer when it is allocated, so that the page faults
+ * are taken once when the pool grows instead of on first use.
+ */
+#define AV_BUFFER_POOL_FLAG_PREFAULT   (1 << 0)
+/**
+ * Align buffers spanning at least one huge page to the huge page size and
+ * ask the system to back them with transparent huge pages.
+ */
+#define AV_BUFFER_POOL_FLAG_HUGEPAGES  (1 << 1)
+/**
+ * Allocate buffers from the explicitly reserved huge pages of the system,
+ * e.g. Linux hugetlbfs. When none are available, behave as
+ * AV_BUFFER_POOL_FLAG_HUGEPAGES.
+ */
+#define AV_BUFFER_POOL_FLAG_HUGETLB    (1 << 2)
+/**
+ * Prefer placing the memory of a buffer on the NUMA node of the CPU the
+ * thread allocating it runs on, instead of the node of the thread that first
+ * writes to it.
+ */
+#define AV_BUFFER_POOL_FLAG_NUMA_LOCAL (1 << 3)
+/**
+ * @}
+ */
+
+/**
+ * Allocate and initialize a buffer pool using the built-in allocator with
+ * the given allocation flags. The buffers are zero-initialized when they are
+ * first allocated.
+ *
+ * @param size size of each buffer in this pool
+ * @param flags a combination of AV_BUFFER_POOL_FLAG_*
+ * @return newly created buffer pool on success, NULL on error.
+ */
+AVBufferPool *av_buffer_pool_init_flags(size_t size, int flags);
+
 /**
  * Mark the pool as being available for freeing. It will actually be freed only
  * once all the allocated buffers associated with the pool are released. Thus it
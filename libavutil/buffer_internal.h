@@ -101,6 +101,7 @@ struct AVBufferPool {
     atomic_uint refcount;
 
     size_t size;
+    int flags;      ///< AV_BUFFER_POOL_FLAG_*, for the built-in allocator
     void *opaque;
     AVBufferRef* (*alloc)(size_t size);
     AVBufferRef* (*alloc2)(void *opaque, size_t size);
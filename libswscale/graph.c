@@ -19,6 +19,7 @@
  */
 
 #include "libavutil/avassert.h"
+#include "libavutil/csp.h"
 #include "libavutil/error.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/macros.h"
@@ -62,12 +63,6 @@ SwsPass *ff_sws_graph_add_pass(SwsGraph *graph, enum AVPixelFormat fmt,
     pass->input  = input;
     pass->output.fmt = AV_PIX_FMT_NONE;
 
-    ret = pass_alloc_output(input);
-    if (ret < 0) {
-        av_free(pass);
-        return NULL;
-    }
-
     if (!align) {
         pass->slice_h = pass->height;
         pass->num_slices = 1;
@@ -83,13 +78,15 @@ SwsPass *ff_sws_graph_add_pass(SwsGraph *graph, enum AVPixelFormat fmt,
     return pass;
 }
 
-/* Wrapper around ff_sws_graph_add_pass() that chains a pass "in-place" */
+/* Wrapper around ff_sws_graph_add_pass() that chains a row-local pass
+ * "in-place" */
 static int pass_append(SwsGraph *graph, enum AVPixelFormat fmt, int w, int h,
                        SwsPass **pass, int align, void *priv, sws_filter_run_t run)
 {
     SwsPass *new = ff_sws_graph_add_pass(graph, fmt, w, h, *pass, align, priv, run);
     if (!new)
         return AVERROR(ENOMEM);
+    new->row_local = true;
     *pass = new;
     return 0;
 }
@@ -210,14 +207,23 @@ static void run_legacy_unscaled(const SwsImg *out, const SwsImg *in_base,
                         out->data, out->linesize);
 }
 
-static void run_legacy_swscale(const SwsImg *out_base, const SwsImg *in,
+static void run_legacy_swscale(const SwsImg *out_base, const SwsImg *in_base,
                                int y, int h, const SwsPass *pass)
 {
     SwsContext *sws = slice_ctx(pass, y);
     SwsInternal *c = sws_internal(sws);
     const SwsImg out = ff_sws_img_shift(out_base, y);
 
-    ff_swscale(c, (const uint8_t *const *) in->data, in->linesize, 0,
+    if (pass->row_local) {
+        /* The input may only hold this tile, so keep ff_swscale() from
+         * reading ahead */
+        const SwsImg in = ff_sws_img_shift(in_base, y);
+        ff_swscale(c, (const uint8_t *const *) in.data, in.linesize, y, h,
+                   out.data, out.linesize, y, h);
+        return;
+    }
+
+    ff_swscale(c, (const uint8_t *const *) in_base->data, in_base->linesize, 0,
                sws->src_h, out.data, out.linesize, y, h);
 }
 
@@ -337,6 +343,19 @@ static int init_legacy_subpass(SwsGraph *graph, SwsContext *sws,
     pass->setup = setup_legacy_swscale;
     pass->free = free_legacy_swscale;
 
+    /**
+     * Without vertical filtering, output lines only depend on the same input
+     * lines. Of the unscaled converters, Bayer demosaicing and YUV410P chroma
+     * upsampling read neighbouring lines inside of the slice they are given.
+     */
+    if (c->convert_unscaled) {
+        pass->row_local = !isBayer(sws->src_format) &&
+                          sws->src_format != AV_PIX_FMT_YUV410P;
+    } else {
+        pass->row_local = src_h == dst_h && c->vLumFilterSize == 1 &&
+                                            c->vChrFilterSize == 1;
+    }
+
     /**
      * For slice threading, we need to create sub contexts, similar to how
      * swscale normally handles it internally. The most important difference
@@ -544,6 +563,273 @@ static int adapt_colors(SwsGraph *graph, SwsFormat src, SwsFormat dst,
     }
     pass->setup = setup_lut3d;
     pass->free = free_lut3d;
+    pass->row_local = true;
+
+    *output = pass;
+    return 0;
+}
+
+/****************************************
+ * Fused packed RGB(A) to planar YUV(A) *
+ ****************************************/
+
+typedef struct SwsRgb2Yuv {
+    int32_t  y[3], u[3], v[3]; ///< R, G, B weights, scaled by 1 << RGB2YUV_SHIFT
+    int32_t  y_off, c_off;     ///< output offsets, including rounding
+    int      off[4];           ///< byte offsets of R, G, B, A in a pixel
+    int      src_alpha;        ///< source has an alpha channel
+    int      premul;           ///< SwsAlphaPremul
+    int      sub;              ///< 2x2 chroma subsampling
+    int      cosited;          ///< chroma horizontally co-sited with even luma
+    uint32_t unpremul[256];    ///< 255 / alpha, scaled by 1 << 16
+} SwsRgb2Yuv;
+
+/* Load a source pixel, convert its colors to the requested alpha
+ * association, and return its alpha */
+static av_always_inline int rgb2yuv_load(const SwsRgb2Yuv *p, const uint8_t *px,
+                                         int rgb[3])
+{
+    const int a = p->src_alpha ? px[p->off[3]] : 0xFF;
+
+    for (int i = 0; i < 3; i++) {
+        unsigned c = px[p->off[i]];
+        if (p->premul == SWS_ALPHA_PREMUL_PREMULTIPLY) {
+            c = c * a + 128;
+            c = (c + (c >> 8)) >> 8;
+        } else if (p->premul == SWS_ALPHA_PREMUL_UNPREMULTIPLY) {
+            c = FFMIN((c * p->unpremul[a] + (1 << 15)) >> 16, 0xFF);
+        }
+        rgb[i] = c;
+    }
+
+    return a;
+}
+
+static av_always_inline int rgb2yuv_dot(const int32_t k[3], const int rgb[3],
+                                        int32_t offset, int shift)
+{
+    return av_clip_uint8((k[0] * rgb[0] + k[1] * rgb[1] + k[2] * rgb[2] + offset) >> shift);
+}
+
+/* Convert one pixel to luma and alpha, and add its colors to sum[] */
+static av_always_inline void rgb2yuv_px(const SwsRgb2Yuv *p, const uint8_t *px,
+                                        uint8_t *y, uint8_t *a, int sum[3])
+{
+    int rgb[3];
+    const int alpha = rgb2yuv_load(p, px, rgb);
+
+    *y = rgb2yuv_dot(p->y, rgb, p->y_off, RGB2YUV_SHIFT);
+    if (a)
+        *a = alpha;
+    for (int i = 0; i < 3; i++)
+        sum[i] += rgb[i];
+}
+
+static void rgb2yuv_444(const SwsRgb2Yuv *p, const uint8_t *src, uint8_t *dst_y,
+                        uint8_t *dst_u, uint8_t *dst_v, uint8_t *dst_a, int w)
+{
+    for (int x = 0; x < w; x++) {
+        int rgb[3] = {0};
+        rgb2yuv_px(p, src + 4 * x, &dst_y[x], dst_a ? &dst_a[x] : NULL, rgb);
+        dst_u[x] = rgb2yuv_dot(p->u, rgb, p->c_off, RGB2YUV_SHIFT);
+        dst_v[x] = rgb2yuv_dot(p->v, rgb, p->c_off, RGB2YUV_SHIFT);
+    }
+}
+
+/**
+ * Convert a pair of rows. Chroma is filtered with weights that sum up to 8:
+ * [2 2] horizontally for center siting, [1 2 1] for co-sited chroma, and
+ * [1 1] vertically.
+ */
+static void rgb2yuv_420(const SwsRgb2Yuv *p, const uint8_t *src0, const uint8_t *src1,
+                        uint8_t *dst_y0, uint8_t *dst_y1, uint8_t *dst_u,
+                        uint8_t *dst_v, uint8_t *dst_a0, uint8_t *dst_a1, int w)
+{
+    const int32_t c_off = p->c_off << 3;
+    int prev[3];
+
+    for (int x = 0; x < w; x += 2) {
+        const int x1 = FFMIN(x + 1, w - 1);
+        int col0[3] = {0}, col1[3] = {0}, sum[3];
+
+        rgb2yuv_px(p, src0 + 4 * x,  &dst_y0[x],  dst_a0 ? &dst_a0[x]  : NULL, col0);
+        rgb2yuv_px(p, src1 + 4 * x,  &dst_y1[x],  dst_a1 ? &dst_a1[x]  : NULL, col0);
+        rgb2yuv_px(p, src0 + 4 * x1, &dst_y0[x1], dst_a0 ? &dst_a0[x1] : NULL, col1);
+        rgb2yuv_px(p, src1 + 4 * x1, &dst_y1[x1], dst_a1 ? &dst_a1[x1] : NULL, col1);
+
+        for (int i = 0; i < 3; i++) {
+            if (p->cosited) {
+                sum[i]  = (x ? prev[i] : col0[i]) + 2 * col0[i] + col1[i];
+                prev[i] = col1[i];
+            } else {
+                sum[i]  = 2 * (col0[i] + col1[i]);
+            }
+        }
+
+        dst_u[x >> 1] = rgb2yuv_dot(p->u, sum, c_off, RGB2YUV_SHIFT + 3);
+        dst_v[x >> 1] = rgb2yuv_dot(p->v, sum, c_off, RGB2YUV_SHIFT + 3);
+    }
+}
+
+static void run_rgb2yuv(const SwsImg *out_base, const SwsImg *in_base,
+                        int y, int h, const SwsPass *pass)
+{
+    const SwsRgb2Yuv *p = pass->priv;
+    const SwsImg in  = ff_sws_img_shift(in_base,  y);
+    const SwsImg out = ff_sws_img_shift(out_base, y);
+    const int src_stride = in.linesize[0];
+    const uint8_t *src = in.data[0];
+    uint8_t *dst_y = out.data[0], *dst_u = out.data[1], *dst_v = out.data[2];
+    uint8_t *dst_a = out.data[3];
+
+    if (!p->sub) {
+        for (int j = 0; j < h; j++) {
+            rgb2yuv_444(p, src, dst_y, dst_u, dst_v, dst_a, pass->width);
+            src   += src_stride;
+            dst_y += out.linesize[0];
+            dst_u += out.linesize[1];
+            dst_v += out.linesize[2];
+            if (dst_a)
+                dst_a += out.linesize[3];
+        }
+        return;
+    }
+
+    for (int j = 0; j < h; j += 2) {
+        /* An odd last row is paired with itself */
+        const int next = j + 1 < h;
+        rgb2yuv_420(p, src, src + next * src_stride,
+                    dst_y, dst_y + next * out.linesize[0], dst_u, dst_v,
+                    dst_a, dst_a ? dst_a + next * out.linesize[3] : NULL,
+                    pass->width);
+        src   += 2 * src_stride;
+        dst_y += 2 * out.linesize[0];
+        dst_u += out.linesize[1];
+        dst_v += out.linesize[2];
+        if (dst_a)
+            dst_a += 2 * out.linesize[3];
+    }
+}
+
+static int add_rgb2yuv_pass(SwsGraph *graph, SwsFormat src, SwsFormat dst,
+                            SwsPass **output)
+{
+    const SwsContext *ctx = graph->ctx;
+    const AVPixFmtDescriptor *src_desc = src.desc;
+    const AVLumaCoefficients *luma;
+    double kr, kg, kb, y_scale, c_scale, u_scale, v_scale;
+    int sub, cosited, premul;
+    SwsRgb2Yuv *p;
+    SwsPass *pass;
+
+    if (src.width != dst.width || src.height != dst.height || dst.interlaced)
+        return AVERROR(ENOTSUP);
+
+    /* 8-bit packed RGB with 4 bytes per pixel */
+    if (!(src_desc->flags & AV_PIX_FMT_FLAG_RGB) ||
+        (src_desc->flags & (AV_PIX_FMT_FLAG_PLANAR | AV_PIX_FMT_FLAG_BE |
+                            AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_FLOAT)) ||
+        src_desc->nb_components < 3 || src_desc->comp[0].step != 4 ||
+        src_desc->comp[0].depth != 8 || src_desc->comp[0].shift)
+        return AVERROR(ENOTSUP);
+
+    switch (dst.format) {
+    case AV_PIX_FMT_YUV444P:
+    case AV_PIX_FMT_YUVA444P:
+        sub = 0;
+        break;
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVA420P:
+        sub = 1;
+        break;
+    default:
+        return AVERROR(ENOTSUP);
+    }
+
+    switch (sub ? dst.loc : AVCHROMA_LOC_CENTER) {
+    case AVCHROMA_LOC_UNSPECIFIED: /* center, as for the legacy scaler */
+    case AVCHROMA_LOC_CENTER:
+        cosited = 0;
+        break;
+    case AVCHROMA_LOC_LEFT:
+        cosited = 1;
+        break;
+    default:
+        return AVERROR(ENOTSUP);
+    }
+
+    switch (dst.csp) {
+    case AVCOL_SPC_UNSPECIFIED:
+        luma = av_csp_luma_coeffs_from_avcsp(AVCOL_SPC_BT470BG);
+        break;
+    case AVCOL_SPC_BT709:
+    case AVCOL_SPC_FCC:
+    case AVCOL_SPC_BT470BG:
+    case AVCOL_SPC_SMPTE170M:
+    case AVCOL_SPC_SMPTE240M:
+    case AVCOL_SPC_BT2020_NCL:
+        luma = av_csp_luma_coeffs_from_avcsp(dst.csp);
+        break;
+    default:
+        return AVERROR(ENOTSUP);
+    }
+
+    /* Leave alpha blending and gamma correct scaling to the legacy scaler */
+    if (ctx->gamma_flag || (ctx->alpha_blend != SWS_ALPHA_BLEND_NONE &&
+                            isALPHA(src.format) && !isALPHA(dst.format)))
+        return AVERROR(ENOTSUP);
+
+    premul = isALPHA(src.format) ? ctx->alpha_premul : SWS_ALPHA_PREMUL_NONE;
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < 4; i++)
+        p->off[i] = src_desc->comp[i].offset;
+    p->src_alpha = isALPHA(src.format);
+    p->premul    = premul;
+    p->sub       = sub;
+    p->cosited   = cosited;
+    for (int a = 1; a < 256; a++)
+        p->unpremul[a] = ((0xFF << 16) + a / 2) / a;
+
+    kr = av_q2d(luma->cr);
+    kb = av_q2d(luma->cb);
+    kg = 1.0 - kr - kb;
+    if (dst.range == AVCOL_RANGE_JPEG) {
+        y_scale = c_scale = 1 << RGB2YUV_SHIFT;
+        p->y_off = 0;
+    } else {
+        y_scale = (219 << RGB2YUV_SHIFT) / 255.0;
+        c_scale = (224 << RGB2YUV_SHIFT) / 255.0;
+        p->y_off = 16 << RGB2YUV_SHIFT;
+    }
+    p->y_off += 1 << (RGB2YUV_SHIFT - 1);
+    p->c_off  = (128 << RGB2YUV_SHIFT) + (1 << (RGB2YUV_SHIFT - 1));
+    u_scale   = c_scale / (2.0 * (1.0 - kb));
+    v_scale   = c_scale / (2.0 * (1.0 - kr));
+
+    p->y[0] = lrint(y_scale * kr);
+    p->y[1] = lrint(y_scale * kg);
+    p->y[2] = lrint(y_scale * kb);
+    p->u[0] = lrint(u_scale * -kr);
+    p->u[1] = lrint(u_scale * -kg);
+    p->u[2] = lrint(u_scale * (1.0 - kb));
+    p->v[0] = lrint(v_scale * (1.0 - kr));
+    p->v[1] = lrint(v_scale * -kg);
+    p->v[2] = lrint(v_scale * -kb);
+
+    graph->incomplete |= dst.range == AVCOL_RANGE_UNSPECIFIED;
+    graph->incomplete |= dst.csp == AVCOL_SPC_UNSPECIFIED;
+
+    pass = ff_sws_graph_add_pass(graph, dst.format, dst.width, dst.height,
+                                 NULL, sub ? 2 : 1, p, run_rgb2yuv);
+    if (!pass) {
+        av_free(p);
+        return AVERROR(ENOMEM);
+    }
+    pass->free = av_free;
+    pass->row_local = true;
 
     *output = pass;
     return 0;
@@ -558,6 +844,9 @@ static int init_passes(SwsGraph *graph)
     SwsFormat src = graph->src;
     SwsFormat dst = graph->dst;
     SwsPass *pass = NULL; /* read from main input image */
+    SwsContext *ctx = graph->ctx;
+    const int premul = isALPHA(src.format) &&
+                       ctx->alpha_premul != SWS_ALPHA_PREMUL_NONE;
     int ret;
 
     ret = adapt_colors(graph, src, dst, pass, &pass);
@@ -567,9 +856,18 @@ static int init_passes(SwsGraph *graph)
     src.color  = dst.color;
 
     if (!ff_fmt_equal(&src, &dst)) {
-        ret = add_legacy_sws_pass(graph, src, dst, pass, &pass);
+        ret = AVERROR(ENOTSUP);
+        /* The fused pass ignores the selected scaler and does not give the
+         * same results as the legacy one, so it is only used on request */
+        if (!pass && (premul || (ctx->flags & SWS_UNSTABLE)))
+            ret = add_rgb2yuv_pass(graph, src, dst, &pass);
+        if (ret == AVERROR(ENOTSUP) && !premul)
+            ret = add_legacy_sws_pass(graph, src, dst, pass, &pass);
         if (ret < 0)
-            return ret;
+            goto fail;
+    } else if (premul) {
+        ret = AVERROR(ENOTSUP);
+        goto fail;
     }
 
     if (!pass) {
@@ -584,6 +882,132 @@ static int init_passes(SwsGraph *graph)
     }
 
     return 0;
+
+fail:
+    if (ret == AVERROR(ENOTSUP) && premul) {
+        av_log(ctx, AV_LOG_ERROR, "Alpha premultiplication is only supported "
+               "for unscaled conversions from packed 8-bit RGB to planar "
+               "8-bit YUV.\n");
+    }
+    return ret;
+}
+
+/***********************************************
+ * Cache blocked execution of row-local passes *
+ ***********************************************/
+
+/* Target size of the working set of one tile, across all passes of a chain */
+#define TILE_SIZE (256 << 10)
+
+static size_t line_size(enum AVPixelFormat fmt, int width)
+{
+    int linesize[4];
+    size_t size = 0;
+
+    if (av_image_fill_linesizes(linesize, fmt, width) < 0)
+        return 0;
+    for (int i = 0; i < 4; i++)
+        size += linesize[i] >> ff_fmt_vshift(fmt, i);
+    return size;
+}
+
+/**
+ * Link up runs of consecutive row-local passes, so that they are run
+ * together over tiles of each slice, and allocate their per-thread tile
+ * buffers in place of the full intermediate images.
+ */
+static int init_tiles(SwsGraph *graph)
+{
+    size_t max_size = 0;
+
+    for (int i = 1; i < graph->num_passes; i++) {
+        SwsPass *prev = graph->passes[i - 1];
+        const SwsPass *pass = graph->passes[i];
+        /* Same slices, so that a job covers the same lines in every pass */
+        if (pass->input == prev && prev->row_local && pass->row_local &&
+            pass->width  == prev->width  && pass->height     == prev->height &&
+            pass->slice_h == prev->slice_h && pass->num_slices == prev->num_slices)
+            prev->tile_next = pass;
+    }
+
+    for (int i = 0; i < graph->num_passes; i++) {
+        const SwsPass *pass = graph->passes[i];
+        size_t size;
+        if (!pass->tile_next || (pass->input && pass->input->tile_next))
+            continue;
+
+        size = line_size(pass->input ? pass->input->format : graph->src.format,
+                         pass->width);
+        for (const SwsPass *p = pass; p; p = p->tile_next)
+            size += line_size(p->format, p->width);
+        max_size = FFMAX(max_size, size);
+    }
+
+    if (!max_size)
+        return 0;
+
+    /* Multiple of 16 lines, to satisfy the slice alignment of any pass */
+    graph->tile_h = FFALIGN(FFMAX(TILE_SIZE / max_size, 1), 16);
+
+    for (int i = 0; i < graph->num_passes; i++) {
+        SwsPass *pass = graph->passes[i];
+        const int tile_h = FFMIN(graph->tile_h, pass->slice_h);
+        if (!pass->tile_next)
+            continue;
+
+        pass->tiles = av_calloc(graph->num_threads, sizeof(*pass->tiles));
+        if (!pass->tiles)
+            return AVERROR(ENOMEM);
+        for (int t = 0; t < graph->num_threads; t++) {
+            SwsImg *tile = &pass->tiles[t];
+            int ret = av_image_alloc(tile->data, tile->linesize, pass->width,
+                                     tile_h, pass->format, 64);
+            if (ret < 0)
+                return ret;
+            tile->fmt = pass->format;
+        }
+    }
+
+    av_log(graph->ctx, AV_LOG_DEBUG, "Running row-local passes in tiles of "
+           "%d lines\n", graph->tile_h);
+    return 0;
+}
+
+static const SwsImg *pass_input(const SwsGraph *graph, const SwsPass *pass)
+{
+    return pass->input ? &pass->input->output : &graph->exec.input;
+}
+
+static const SwsImg *pass_output(const SwsGraph *graph, const SwsPass *pass)
+{
+    return pass->output.fmt != AV_PIX_FMT_NONE ? &pass->output : &graph->exec.output;
+}
+
+/* View of a tile buffer as an image whose line `y` is the first tile line */
+static SwsImg tile_img(const SwsImg *tile, int y)
+{
+    SwsImg img = *tile;
+    for (int i = 0; i < 4 && img.data[i]; i++)
+        img.data[i] -= (y >> ff_fmt_vshift(img.fmt, i)) * img.linesize[i];
+    return img;
+}
+
+static void run_tiles(const SwsGraph *graph, const SwsPass *pass, int threadnr,
+                      int slice_y, int slice_h)
+{
+    const int slice_end = slice_y + slice_h;
+
+    for (int y = slice_y; y < slice_end; y += graph->tile_h) {
+        const int h = FFMIN(graph->tile_h, slice_end - y);
+        SwsImg in = *pass_input(graph, pass);
+
+        for (const SwsPass *p = pass; p; p = p->tile_next) {
+            const SwsImg out = p->tile_next ? tile_img(&p->tiles[threadnr], y)
+                                            : *pass_output(graph, p);
+            p->run(&out, &in, y, h, p);
+            in = out;
+        }
+    }
 }
 
 static void sws_graph_worker(void *priv, int jobnr, int threadnr, int nb_jobs,
@@ -591,12 +1015,16 @@ static void sws_graph_worker(void *priv, int jobnr, int threadnr, int nb_jobs,
 {
     SwsGraph *graph = priv;
     const SwsPass *pass = graph->exec.pass;
-    const SwsImg *input  = pass->input ? &pass->input->output : &graph->exec.input;
-    const SwsImg *output = pass->output.fmt != AV_PIX_FMT_NONE ? &pass->output : &graph->exec.output;
     const int slice_y = jobnr * pass->slice_h;
     const int slice_h = FFMIN(pass->slice_h, pass->height - slice_y);
 
-    pass->run(output, input, slice_y, slice_h, pass);
+    if (pass->tile_next) {
+        run_tiles(graph, pass, threadnr, slice_y, slice_h);
+        return;
+    }
+
+    pass->run(pass_output(graph, pass), pass_input(graph, pass),
+              slice_y, slice_h, pass);
 }
 
 int ff_sws_graph_create(SwsContext *ctx, const SwsFormat *dst, const SwsFormat *src,
@@ -629,6 +1057,19 @@ int ff_sws_graph_create(SwsContext *ctx, const SwsFormat *dst, const SwsFormat *
     if (ret < 0)
         goto error;
 
+    ret = init_tiles(graph);
+    if (ret < 0)
+        goto error;
+
+    for (int i = 0; i < graph->num_passes; i++) {
+        SwsPass *input = (SwsPass *) graph->passes[i]->input;
+        if (input && !input->tile_next) {
+            ret = pass_alloc_output(input);
+            if (ret < 0)
+                goto error;
+        }
+    }
+
     *out_graph = graph;
     return 0;
 
@@ -651,6 +1092,9 @@ void ff_sws_graph_free(SwsGraph **pgraph)
             pass->free(pass->priv);
         if (pass->output.fmt != AV_PIX_FMT_NONE)
             av_free(pass->output.data[0]);
+        for (int t = 0; pass->tiles && t < graph->num_threads; t++)
+            av_free(pass->tiles[t].data[0]);
+        av_free(pass->tiles);
         av_free(pass);
     }
     av_free(graph->passes);
@@ -672,6 +1116,7 @@ static int opts_equal(const SwsContext *c1, const SwsContext *c2)
            c1->dst_h_chr_pos == c2->dst_h_chr_pos &&
            c1->dst_v_chr_pos == c2->dst_v_chr_pos &&
            c1->intent        == c2->intent        &&
+           c1->alpha_premul  == c2->alpha_premul  &&
            !memcmp(c1->scaler_params, c2->scaler_params, sizeof(c1->scaler_params));
 
 }
@@ -714,9 +1159,14 @@ void ff_sws_graph_run(SwsGraph *graph, uint8_t *const out_data[4],
 
     for (int i = 0; i < graph->num_passes; i++) {
         const SwsPass *pass = graph->passes[i];
+        if (pass->input && pass->input->tile_next)
+            continue; /* run together with its input */
+
         graph->exec.pass = pass;
-        if (pass->setup)
-            pass->setup(out, in, pass);
+        for (const SwsPass *p = pass; p; p = p->tile_next) {
+            if (p->setup)
+                p->setup(out, in, p);
+        }
         avpriv_slicethread_execute(graph->slicethread, pass->num_slices, 0);
     }
 }
@@ -102,6 +102,20 @@ struct SwsPass {
      */
     void (*free)(void *priv);
     void *priv;
+
+    /**
+     * Set if output lines [y, y + h) only depend on input lines [y, y + h),
+     * so that the pass can be run tile by tile together with its neighbours.
+     */
+    bool row_local;
+
+    /**
+     * Next pass to run on each tile of this pass's output, if the two passes
+     * are run together. The output of such a pass is not kept for the whole
+     * image, but only for one tile of `SwsGraph.tile_h` lines per thread.
+     */
+    const SwsPass *tile_next;
+    SwsImg *tiles; /* per-thread tile buffers */
 };
 
 /**
@@ -118,6 +132,12 @@ typedef struct SwsGraph {
     SwsPass **passes;
     int num_passes;
 
+    /**
+     * Number of lines per tile when running chains of row-local passes,
+     * chosen so that a tile of every image in the chain fits in cache.
+     */
+    int tile_h;
+
     /**
      * Cached copy of the public options that were used to construct this
      * SwsGraph. Used only to detect when the graph needs to be reinitialized.
@@ -49,6 +49,7 @@ static const AVOption swscale_options[] = {
         { "full_chroma_int", "full chroma interpolation",     0,  AV_OPT_TYPE_CONST, { .i64 = SWS_FULL_CHR_H_INT }, .flags = VE, .unit = "sws_flags" },
         { "full_chroma_inp", "full chroma input",             0,  AV_OPT_TYPE_CONST, { .i64 = SWS_FULL_CHR_H_INP }, .flags = VE, .unit = "sws_flags" },
         { "bitexact",        "bit-exact mode",                0,  AV_OPT_TYPE_CONST, { .i64 = SWS_BITEXACT       }, .flags = VE, .unit = "sws_flags" },
+        { "unstable",        "allow experimental code paths", 0,  AV_OPT_TYPE_CONST, { .i64 = SWS_UNSTABLE       }, .flags = VE, .unit = "sws_flags" },
         { "error_diffusion", "error diffusion dither",        0,  AV_OPT_TYPE_CONST, { .i64 = SWS_ERROR_DIFFUSION}, .flags = VE, .unit = "sws_flags" },
 
     { "param0",          "scaler param 0", OFFSET(scaler_params[0]), AV_OPT_TYPE_DOUBLE, { .dbl = SWS_PARAM_DEFAULT  }, INT_MIN, INT_MAX, VE },
@@ -91,6 +92,11 @@ static const AVOption swscale_options[] = {
         { "saturation",            "saturation mapping",             0, AV_OPT_TYPE_CONST,  { .i64 = SWS_INTENT_SATURATION            }, .flags = VE, .unit = "intent" },
         { "absolute_colorimetric", "absolute colorimetric clipping", 0, AV_OPT_TYPE_CONST,  { .i64 = SWS_INTENT_ABSOLUTE_COLORIMETRIC }, .flags = VE, .unit = "intent" },
 
+    { "alpha_premul",    "alpha premultiplication of the source", OFFSET(alpha_premul), AV_OPT_TYPE_INT, { .i64 = SWS_ALPHA_PREMUL_NONE }, .flags = VE, .unit = "alpha_premul", .max = SWS_ALPHA_PREMUL_NB - 1 },
+        { "none",          "keep alpha association",       0, AV_OPT_TYPE_CONST,  { .i64 = SWS_ALPHA_PREMUL_NONE          }, .flags = VE, .unit = "alpha_premul" },
+        { "premultiply",   "premultiply colors by alpha",  0, AV_OPT_TYPE_CONST,  { .i64 = SWS_ALPHA_PREMUL_PREMULTIPLY   }, .flags = VE, .unit = "alpha_premul" },
+        { "unpremultiply", "divide colors by alpha",       0, AV_OPT_TYPE_CONST,  { .i64 = SWS_ALPHA_PREMUL_UNPREMULTIPLY }, .flags = VE, .unit = "alpha_premul" },
+
     { NULL }
 };
 
@@ -91,6 +91,13 @@ typedef enum SwsAlphaBlend {
     SWS_ALPHA_BLEND_NB,  /* not part of the ABI */
 } SwsAlphaBlend;
 
+typedef enum SwsAlphaPremul {
+    SWS_ALPHA_PREMUL_NONE = 0,      /* keep the source alpha association */
+    SWS_ALPHA_PREMUL_PREMULTIPLY,   /* multiply straight colors by alpha */
+    SWS_ALPHA_PREMUL_UNPREMULTIPLY, /* divide premultiplied colors by alpha */
+    SWS_ALPHA_PREMUL_NB,            /* not part of the ABI */
+} SwsAlphaPremul;
+
 typedef enum SwsFlags {
     /**
      * Scaler selection options. Only one may be active at a time.
@@ -155,6 +162,13 @@ typedef enum SwsFlags {
     SWS_ACCURATE_RND   = 1 << 18,
     SWS_BITEXACT       = 1 << 19,
 
+    /**
+     * Allow using experimental new code paths. These may be faster but give
+     * different output than the established ones, and what they cover may
+     * change at any point in time.
+     */
+    SWS_UNSTABLE       = 1 << 20,
+
     /**
      * Deprecated flags.
      */
@@ -239,6 +253,16 @@ typedef struct SwsContext {
      */
     int intent;
 
+    /**
+     * Alpha premultiplication to apply to the source colors. See
+     * `SwsAlphaPremul` for details.
+     *
+     * Only supported by sws_scale_frame(), for conversions from packed 8-bit
+     * RGB with alpha to planar 8-bit YUV of the same size; other conversions
+     * of sources with alpha fail with AVERROR(ENOTSUP) when this is set.
+     */
+    SwsAlphaPremul alpha_premul;
+
     /* Remember to add new fields to graph.c:opts_equal() */
 } SwsContext;
 
@@ -0,0 +1,334 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * Filter frames while they are being decoded: every frame is sent to the
+ * filtergraph thread as soon as the decoder allocates it, and the rows
+ * decoded by the slice threads are reported from draw_horiz_band().
+ * Optionally one packet is cut in half, to check that a frame that fails
+ * to decode does not stall the filtergraph.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/mem.h"
+#include "libavutil/threadmessage.h"
+#include "libavutil/thread.h" // not public
+#include "libavcodec/avcodec.h"
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+#include "libavformat/avformat.h"
+
+static AVFilterGraph *graph;
+static AVFilterContext *src_ctx, *sink_ctx;
+static AVThreadMessageQueue *queue;
+static int draw_horiz_band_called;
+
+static void free_frame(void *msg)
+{
+    av_frame_free(msg);
+}
+
+static int get_buffer(AVCodecContext *avctx, AVFrame *frame, int flags)
+{
+    AVFrame *ref;
+    int ret;
+
+    ret = avcodec_default_get_buffer2(avctx, frame, flags);
+    if (ret < 0)
+        return ret;
+
+    ref = av_frame_clone(frame);
+    if (!ref)
+        return AVERROR(ENOMEM);
+    ret = av_thread_message_queue_send(queue, &ref, 0);
+    if (ret < 0)
+        av_frame_free(&ref);
+    return ret;
+}
+
+static void draw_horiz_band(AVCodecContext *avctx, const AVFrame *frame,
+                            int offset[4], int y, int type, int height)
+{
+    draw_horiz_band_called = 1;
+    if (av_buffersrc_report_slice(src_ctx, frame, y, height) < 0)
+        abort();
+}
+
+static int print_frames(uint8_t *buf, int buf_size, AVFrame *frame)
+{
+    int ret;
+
+    while ((ret = av_buffersink_get_frame(sink_ctx, frame)) >= 0) {
+        ret = av_image_copy_to_buffer(buf, buf_size,
+                                      (const uint8_t * const *)frame->data,
+                                      frame->linesize, frame->format,
+                                      frame->width, frame->height, 1);
+        if (ret < 0)
+            return ret;
+        printf("%"PRId64", 0x%08"PRIx32"\n", frame->pts,
+               (uint32_t)av_adler32_update(0, buf, ret));
+        av_frame_unref(frame);
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+static void *filter_thread(void *arg)
+{
+    const AVFilterLink *outlink = sink_ctx->inputs[0];
+    AVFrame *frame = NULL, *out = av_frame_alloc();
+    int buf_size = av_image_get_buffer_size(outlink->format, outlink->w,
+                                            outlink->h, 1);
+    uint8_t *buf = av_malloc(buf_size);
+    int ret = out && buf ? 0 : AVERROR(ENOMEM);
+
+    while (ret >= 0) {
+        ret = av_thread_message_queue_recv(queue, &frame, 0);
+        if (ret < 0)
+            break;
+        ret = av_buffersrc_add_frame_flags(src_ctx, frame,
+                                           AV_BUFFERSRC_FLAG_INCOMPLETE);
+        av_frame_free(&frame);
+        if (ret >= 0)
+            ret = print_frames(buf, buf_size, out);
+    }
+    if (ret == AVERROR_EOF) {
+        ret = av_buffersrc_add_frame(src_ctx, NULL);
+        if (ret >= 0)
+            ret = print_frames(buf, buf_size, out);
+    }
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Error filtering frames\n");
+        av_thread_message_queue_set_err_send(queue, ret);
+    }
+
+    av_frame_free(&out);
+    av_free(buf);
+    return (void *)(intptr_t)ret;
+}
+
+static int init_graph(const AVCodecContext *ctx, AVRational time_base,
+                      const char *filters)
+{
+    AVFilterInOut *inputs, *outputs;
+    char args[256];
+    int ret;
+
+    graph = avfilter_graph_alloc();
+    if (!graph)
+        return AVERROR(ENOMEM);
+    graph->nb_threads = 2;
+
+    snprintf(args, sizeof(args), "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d",
+             ctx->width, ctx->height, ctx->pix_fmt, time_base.num, time_base.den);
+    ret = avfilter_graph_create_filter(&src_ctx, avfilter_get_by_name("buffer"),
+                                       "in", args, NULL, graph);
+    if (ret < 0)
+        return ret;
+    ret = avfilter_graph_create_filter(&sink_ctx, avfilter_get_by_name("buffersink"),
+                                       "out", NULL, NULL, graph);
+    if (ret < 0)
+        return ret;
+
+    outputs = avfilter_inout_alloc();
+    inputs  = avfilter_inout_alloc();
+    if (!outputs || !inputs) {
+        avfilter_inout_free(&outputs);
+        avfilter_inout_free(&inputs);
+        return AVERROR(ENOMEM);
+    }
+    outputs->name       = av_strdup("in");
+    outputs->filter_ctx = src_ctx;
+    inputs->name        = av_strdup("out");
+    inputs->filter_ctx  = sink_ctx;
+
+    ret = avfilter_graph_parse_ptr(graph, filters, &inputs, &outputs, NULL);
+    avfilter_inout_free(&outputs);
+    avfilter_inout_free(&inputs);
+    if (ret < 0)
+        return ret;
+
+    return avfilter_graph_config(graph, NULL);
+}
+
+static int video_decode_filter(const char *input_filename, int threads,
+                               const char *filters, int truncate)
+{
+    const AVCodec *codec;
+    AVCodecContext *ctx = NULL;
+    AVFormatContext *fmt_ctx = NULL;
+    AVPacket *pkt = NULL;
+    AVFrame *fr = NULL;
+    pthread_t tid;
+    void *thread_ret;
+    int video_stream, result, nb_packets = 0;
+
+    result = avformat_open_input(&fmt_ctx, input_filename, NULL, NULL);
+    if (result < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Can't open file\n");
+        return result;
+    }
+
+    result = avformat_find_stream_info(fmt_ctx, NULL);
+    if (result < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Can't get stream info\n");
+        return result;
+    }
+
+    video_stream = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (video_stream < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Can't find video stream in input file\n");
+        return -1;
+    }
+
+    if (!(codec->capabilities & AV_CODEC_CAP_DRAW_HORIZ_BAND)) {
+        av_log(NULL, AV_LOG_ERROR, "Codec does not support draw_horiz_band\n");
+        return -1;
+    }
+
+    ctx = avcodec_alloc_context3(codec);
+    if (!ctx) {
+        av_log(NULL, AV_LOG_ERROR, "Can't allocate decoder context\n");
+        return AVERROR(ENOMEM);
+    }
+
+    result = avcodec_parameters_to_context(ctx, fmt_ctx->streams[video_stream]->codecpar);
+    if (result) {
+        av_log(NULL, AV_LOG_ERROR, "Can't copy decoder context\n");
+        return result;
+    }
+
+    ctx->get_buffer2     = get_buffer;
+    ctx->draw_horiz_band = draw_horiz_band;
+    ctx->thread_count    = threads;
+    ctx->thread_type     = FF_THREAD_SLICE;
+
+    result = avcodec_open2(ctx, codec, NULL);
+    if (result < 0) {
+        av_log(ctx, AV_LOG_ERROR, "Can't open decoder\n");
+        return result;
+    }
+
+    result = init_graph(ctx, fmt_ctx->streams[video_stream]->time_base, filters);
+    if (result < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Can't configure filtergraph\n");
+        return result;
+    }
+
+    result = av_thread_message_queue_alloc(&queue, 4, sizeof(AVFrame *));
+    if (result < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Can't allocate message queue\n");
+        return result;
+    }
+    av_thread_message_queue_set_free_func(queue, free_frame);
+
+    fr  = av_frame_alloc();
+    pkt = av_packet_alloc();
+    if (!fr || !pkt) {
+        av_log(NULL, AV_LOG_ERROR, "Can't allocate frame or packet\n");
+        return AVERROR(ENOMEM);
+    }
+
+    result = pthread_create(&tid, NULL, filter_thread, NULL);
+    if (result) {
+        av_log(NULL, AV_LOG_ERROR, "Can't create filter thread\n");
+        return AVERROR(result);
+    }
+
+    result = 0;
+    while (result >= 0) {
+        result = av_read_frame(fmt_ctx, pkt);
+        if (result >= 0 && pkt->stream_index != video_stream) {
+            av_packet_unref(pkt);
+            continue;
+        }
+        if (result >= 0 && nb_packets++ == truncate)
+            pkt->size /= 2;
+
+        // pkt will be empty on read error/EOF
+        result = avcodec_send_packet(ctx, pkt);
+
+        av_packet_unref(pkt);
+
+        if (result == AVERROR_INVALIDDATA && truncate >= 0) {
+            av_log(NULL, AV_LOG_WARNING, "Packet %d is invalid\n", nb_packets - 1);
+            result = 0;
+            continue;
+        } else if (result < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error submitting a packet for decoding\n");
+            break;
+        }
+
+        while (result >= 0) {
+            result = avcodec_receive_frame(ctx, fr);
+            if (result == AVERROR_EOF)
+                break;
+            else if (result == AVERROR(EAGAIN)) {
+                result = 0;
+                break;
+            } else if (result < 0) {
+                av_log(NULL, AV_LOG_ERROR, "Error decoding frame\n");
+                break;
+            }
+            if (!draw_horiz_band_called) {
+                av_log(NULL, AV_LOG_ERROR, "draw_horiz_band haven't been called!\n");
+                result = -1;
+                break;
+            }
+            /* The frame has already been sent to the filtergraph. */
+            av_frame_unref(fr);
+        }
+    }
+
+    /* Let the filter thread flush the graph and finish, also on error */
+    av_thread_message_queue_set_err_recv(queue, AVERROR_EOF);
+    pthread_join(tid, &thread_ret);
+    if (result == AVERROR_EOF)
+        result = (intptr_t)thread_ret;
+
+    av_packet_free(&pkt);
+    av_frame_free(&fr);
+    avformat_close_input(&fmt_ctx);
+    avcodec_free_context(&ctx);
+    avfilter_graph_free(&graph);
+    av_thread_message_queue_free(&queue);
+    return result < 0 ? result : 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 4) {
+        av_log(NULL, AV_LOG_ERROR, "Incorrect input: expected %s "
+               "<name of a video file> <number of threads> <filters> "
+               "[<index of the packet to truncate>]\n", argv[0]);
+        return 1;
+    }
+
+    if (video_decode_filter(argv[1], atoi(argv[2]), argv[3],
+                            argc > 4 ? atoi(argv[4]) : -1) != 0)
+        return 1;
+
+    return 0;
+}
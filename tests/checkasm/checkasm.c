@@ -223,12 +223,21 @@ static const struct {
     #if CONFIG_RV40_DECODER
         { "rv40dsp", checkasm_check_rv40dsp },
     #endif
+    #if CONFIG_SNAPPY
+        { "snappy", checkasm_check_snappy },
+    #endif
     #if CONFIG_SVQ1_ENCODER
         { "svq1enc", checkasm_check_svq1enc },
     #endif
     #if CONFIG_TAK_DECODER
         { "takdsp", checkasm_check_takdsp },
     #endif
+    #if CONFIG_TEXTUREDSP
+        { "texturedsp", checkasm_check_texturedsp },
+    #endif
+    #if CONFIG_TEXTUREDSPENC
+        { "texturedspenc", checkasm_check_texturedspenc },
+    #endif
     #if CONFIG_UTVIDEO_DECODER
         { "utvideodsp", checkasm_check_utvideodsp },
     #endif
@@ -0,0 +1,155 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#include "libavcodec/bytestream.h"
+#include "libavcodec/snappy.h"
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+
+#define MAX_RAW_SIZE  (64 * 1024)
+#define MAX_COMP_SIZE (MAX_RAW_SIZE * 5 + 32)
+
+/**
+ * Build a Snappy stream using every element type the format has, and
+ * the data it should decompress to. The data is texture-like: short runs
+ * of repeated 8 and 16 byte blocks, so that back-references dominate.
+ */
+static int build_stream(uint8_t *comp, uint8_t *raw, int raw_size)
+{
+    PutByteContext pb;
+    int pos = 0, v = raw_size;
+
+    bytestream2_init_writer(&pb, comp, MAX_COMP_SIZE);
+    do {
+        bytestream2_put_byte(&pb, (v & 0x7F) | (v > 0x7F ? 0x80 : 0));
+        v >>= 7;
+    } while (v);
+
+    while (pos < raw_size) {
+        int left = raw_size - pos;
+        int type = pos ? rnd() % 5 : 0;
+        int len, off, i, r;
+
+        if (type == 0) {
+            /* literal, short or with an explicit 1 or 2 byte length */
+            r   = (rnd() & 1) ? 1 + rnd() % 60 : 1 + rnd() % 1000;
+            len = FFMIN(left, r);
+            if (len <= 60) {
+                bytestream2_put_byte(&pb, (len - 1) << 2);
+            } else if (len <= 256) {
+                bytestream2_put_byte(&pb, 60 << 2);
+                bytestream2_put_byte(&pb, len - 1);
+            } else {
+                bytestream2_put_byte(&pb, 61 << 2);
+                bytestream2_put_le16(&pb, len - 1);
+            }
+            for (i = 0; i < len; i++)
+                raw[pos + i] = rnd();
+            bytestream2_put_buffer(&pb, raw + pos, len);
+        } else {
+            /* copies, possibly overlapping their own output */
+            static const int block_off[] = { 8, 16, 24, 32 };
+            r   = block_off[rnd() & 3];
+            off = type == 4 ? 1 + rnd() % pos : FFMIN(pos, r);
+            if (type == 1) {
+                off = FFMIN(off, 2047);
+                r   = 4 + rnd() % 8;
+                len = FFMIN(left, r);
+                if (len < 4) {
+                    type = 2;
+                } else {
+                    bytestream2_put_byte(&pb, 1 | (len - 4) << 2 | (off >> 8) << 5);
+                    bytestream2_put_byte(&pb, off & 0xFF);
+                }
+            }
+            if (type >= 2) {
+                off = FFMIN(off, type == 3 ? pos : 0xFFFF);
+                r   = 1 + rnd() % 64;
+                len = FFMIN(left, r);
+                if (type == 3) {
+                    bytestream2_put_byte(&pb, 3 | (len - 1) << 2);
+                    bytestream2_put_le32(&pb, off);
+                } else {
+                    bytestream2_put_byte(&pb, 2 | (len - 1) << 2);
+                    bytestream2_put_le16(&pb, off);
+                }
+            }
+            for (i = 0; i < len; i++)
+                raw[pos + i] = raw[pos + i - off];
+        }
+        pos += len;
+    }
+
+    return bytestream2_tell_p(&pb);
+}
+
+static int snappy_uncompress(const uint8_t *src, int src_size,
+                             uint8_t *dst, int64_t *dst_size)
+{
+    GetByteContext gb;
+
+    bytestream2_init(&gb, src, src_size);
+    return ff_snappy_uncompress(&gb, dst, dst_size);
+}
+
+void checkasm_check_snappy(void)
+{
+    static const int sizes[] = { 1, 64, 1000, 4096, MAX_RAW_SIZE };
+    uint8_t *comp    = av_malloc(MAX_COMP_SIZE);
+    uint8_t *raw     = av_malloc(MAX_RAW_SIZE);
+    uint8_t *dst_ref = av_malloc(MAX_RAW_SIZE);
+    uint8_t *dst_new = av_malloc(MAX_RAW_SIZE);
+    int i;
+
+    declare_func(int, const uint8_t *src, int src_size,
+                 uint8_t *dst, int64_t *dst_size);
+
+    if (!comp || !raw || !dst_ref || !dst_new)
+        goto end;
+
+    if (check_func(snappy_uncompress, "snappy_uncompress")) {
+        for (i = 0; i < FF_ARRAY_ELEMS(sizes); i++) {
+            int comp_size = build_stream(comp, raw, sizes[i]);
+            int64_t size_ref = MAX_RAW_SIZE, size_new = MAX_RAW_SIZE;
+            int ret_ref, ret_new;
+
+            memset(dst_ref, 0, MAX_RAW_SIZE);
+            memset(dst_new, 0, MAX_RAW_SIZE);
+            ret_ref = call_ref(comp, comp_size, dst_ref, &size_ref);
+            ret_new = call_new(comp, comp_size, dst_new, &size_new);
+            if (ret_ref < 0 || ret_ref != ret_new ||
+                size_ref != sizes[i] || size_new != sizes[i] ||
+                memcmp(dst_ref, raw, sizes[i]) ||
+                memcmp(dst_new, raw, sizes[i]))
+                fail();
+
+            if (sizes[i] == MAX_RAW_SIZE)
+                bench_new(comp, comp_size, dst_new, &size_new);
+        }
+    }
+    report("uncompress");
+
+end:
+    av_free(comp);
+    av_free(raw);
+    av_free(dst_ref);
+    av_free(dst_new);
+}
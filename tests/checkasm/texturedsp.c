@@ -0,0 +1,121 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "config_components.h"
+
+#include "checkasm.h"
+#include "libavcodec/texturedsp.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem_internal.h"
+
+#if CONFIG_HAP_DECODER || CONFIG_DDS_DECODER
+#include "libavcodec/bc7dec.h"
+#endif
+
+/* One 4x4 block of RGBA pixels, with some slack on the right to catch
+ * writes past the block width. */
+#define STRIDE  32
+#define BUF_SIZE (STRIDE * TEXTURE_BLOCK_H)
+
+#define randomize_buffers(buf, size)        \
+    do {                                    \
+        int i;                              \
+        for (i = 0; i < size; i += 4)       \
+            AV_WN32A(buf + i, rnd());       \
+    } while (0)
+
+static void check_decompress(int (*func)(uint8_t *, ptrdiff_t, const uint8_t *),
+                             const char *name, int tex_size)
+{
+    LOCAL_ALIGNED_16(uint8_t, tex,     [16]);
+    LOCAL_ALIGNED_16(uint8_t, dst_ref, [BUF_SIZE]);
+    LOCAL_ALIGNED_16(uint8_t, dst_new, [BUF_SIZE]);
+    int i;
+
+    declare_func(int, uint8_t *dst, ptrdiff_t stride, const uint8_t *block);
+
+    if (!check_func(func, "%s", name))
+        return;
+
+    for (i = 0; i < 16; i++) {
+        int ret_ref, ret_new;
+
+        randomize_buffers(tex, 16);
+        /* Constant and two-colour blocks take separate paths in most
+         * decoders, so make sure they show up too. */
+        if (i == 1)
+            memset(tex, 0, 16);
+        else if (i == 2)
+            memset(tex, 0xFF, 16);
+
+        randomize_buffers(dst_ref, BUF_SIZE);
+        memcpy(dst_new, dst_ref, BUF_SIZE);
+
+        ret_ref = call_ref(dst_ref, STRIDE, tex);
+        ret_new = call_new(dst_new, STRIDE, tex);
+        if (ret_ref != tex_size || ret_ref != ret_new ||
+            memcmp(dst_ref, dst_new, BUF_SIZE))
+            fail();
+    }
+    bench_new(dst_new, STRIDE, tex);
+}
+
+void checkasm_check_texturedsp(void)
+{
+    static const struct {
+        const char *name;
+        size_t offset;
+        int tex_size;
+    } funcs[] = {
+#define FUNC(n, s) { #n, offsetof(TextureDSPContext, n), s }
+        FUNC(dxt1_block,          8),
+        FUNC(dxt1a_block,         8),
+        FUNC(dxt2_block,         16),
+        FUNC(dxt3_block,         16),
+        FUNC(dxt4_block,         16),
+        FUNC(dxt5_block,         16),
+        FUNC(dxt5y_block,        16),
+        FUNC(dxt5ys_block,       16),
+        FUNC(rgtc1s_block,        8),
+        FUNC(rgtc1u_block,        8),
+        FUNC(rgtc1u_gray_block,   8),
+        FUNC(rgtc1u_alpha_block,  8),
+        FUNC(rgtc2s_block,       16),
+        FUNC(rgtc2u_block,       16),
+        FUNC(dxn3dc_block,       16),
+#undef FUNC
+    };
+    TextureDSPContext h;
+    int i;
+
+    ff_texturedsp_init(&h);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(funcs); i++) {
+        int (**func)(uint8_t *, ptrdiff_t, const uint8_t *) =
+            (void *)((uint8_t *)&h + funcs[i].offset);
+        check_decompress(*func, funcs[i].name, funcs[i].tex_size);
+    }
+    report("decompress");
+
+#if CONFIG_HAP_DECODER || CONFIG_DDS_DECODER
+    check_decompress(ff_bc7dec_block, "bc7_block", 16);
+    report("bc7");
+#endif
+}
@@ -0,0 +1,122 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "config_components.h"
+
+#include "checkasm.h"
+#include "libavcodec/texturedsp.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem_internal.h"
+
+#if CONFIG_HAP_ENCODER || CONFIG_DDS_ENCODER
+#include "libavcodec/bc7enc.h"
+#endif
+
+#define STRIDE   32
+#define BUF_SIZE (STRIDE * TEXTURE_BLOCK_H)
+
+#define randomize_buffers(buf, size)        \
+    do {                                    \
+        int i;                              \
+        for (i = 0; i < size; i += 4)       \
+            AV_WN32A(buf + i, rnd());       \
+    } while (0)
+
+/* Fill the block with a two-colour gradient plus noise, which is closer
+ * to real content than white noise and exercises the endpoint search. */
+static void fill_block(uint8_t *src, int pattern)
+{
+    int x, y, c;
+
+    randomize_buffers(src, BUF_SIZE);
+    if (pattern == 1) {
+        uint32_t v = rnd();
+        for (y = 0; y < TEXTURE_BLOCK_H; y++)
+            for (x = 0; x < TEXTURE_BLOCK_W; x++)
+                AV_WN32A(src + y * STRIDE + x * 4, v);
+    } else if (pattern == 2) {
+        uint8_t a[4], b[4];
+        AV_WN32(a, rnd());
+        AV_WN32(b, rnd());
+        for (y = 0; y < TEXTURE_BLOCK_H; y++)
+            for (x = 0; x < TEXTURE_BLOCK_W; x++)
+                for (c = 0; c < 4; c++) {
+                    int w = x + y;
+                    src[y * STRIDE + x * 4 + c] =
+                        av_clip_uint8((a[c] * (6 - w) + b[c] * w) / 6 +
+                                      (int)(rnd() & 7) - 4);
+                }
+    }
+}
+
+static void check_compress(int (*func)(uint8_t *, ptrdiff_t, const uint8_t *),
+                           const char *name, int tex_size)
+{
+    LOCAL_ALIGNED_16(uint8_t, src,     [BUF_SIZE]);
+    LOCAL_ALIGNED_16(uint8_t, tex_ref, [32]);
+    LOCAL_ALIGNED_16(uint8_t, tex_new, [32]);
+    int i;
+
+    declare_func(int, uint8_t *dst, ptrdiff_t stride, const uint8_t *block);
+
+    if (!check_func(func, "%s", name))
+        return;
+
+    for (i = 0; i < 24; i++) {
+        int ret_ref, ret_new;
+
+        fill_block(src, i % 3);
+        randomize_buffers(tex_ref, 32);
+        memcpy(tex_new, tex_ref, 32);
+
+        ret_ref = call_ref(tex_ref, STRIDE, src);
+        ret_new = call_new(tex_new, STRIDE, src);
+        if (ret_ref != tex_size || ret_ref != ret_new ||
+            memcmp(tex_ref, tex_new, 32))
+            fail();
+    }
+    bench_new(tex_new, STRIDE, src);
+}
+
+void checkasm_check_texturedspenc(void)
+{
+    TextureDSPEncContext h;
+
+    ff_texturedspenc_init(&h);
+
+    check_compress(h.dxt1_block,         "dxt1_block",          8);
+    check_compress(h.dxt5_block,         "dxt5_block",         16);
+    check_compress(h.dxt5ys_block,       "dxt5ys_block",       16);
+    check_compress(h.rgtc1u_gray_block,  "rgtc1u_gray_block",   8);
+    check_compress(h.rgtc1u_gray8_block, "rgtc1u_gray8_block",  8);
+    check_compress(h.rgtc1u_alpha_block, "rgtc1u_alpha_block",  8);
+    report("compress");
+
+#if CONFIG_HAP_ENCODER || CONFIG_DDS_ENCODER
+    {
+        BC7EncContext bc7;
+
+        ff_bc7enc_init(&bc7, BC7ENC_TRUE, BC7ENC_MAX_PARTITIONS1, 0,
+                       BC7ENC_TRUE, BC7ENC_TRUE);
+        check_compress(bc7.bc7enc_block, "bc7enc_block", 16);
+        report("bc7");
+    }
+#endif
+}
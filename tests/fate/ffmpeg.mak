@@ -16,6 +16,14 @@ fate-ffmpeg-filter_colorkey: CMD = framecrc -auto_conversion_filters -idct simpl
 FATE_FFMPEG-$(call FILTERFRAMECRC, COLOR) += fate-ffmpeg-lavfi
 fate-ffmpeg-lavfi: CMD = framecrc -lavfi color=d=1:r=5 -fflags +bitexact
 
+FATE_FFMPEG-$(call FILTERFRAMECRC, TESTSRC HFLIP VFLIP NEGATE, LAVFI_INDEV) += fate-ffmpeg-filter_pipeline
+fate-ffmpeg-filter_pipeline: CMD = framecrc -filter_pipeline 2 -f lavfi -i testsrc=d=1:r=5:s=160x120 -vf hflip,vflip,negate -fflags +bitexact
+
+FATE_FFMPEG-$(call FILTERFRAMECRC, TESTSRC COLOR HFLIP NEGATE OVERLAY VFLIP) += fate-ffmpeg-filter_complex_pipeline
+fate-ffmpeg-filter_complex_pipeline: CMD = framecrc -auto_conversion_filters -filter_pipeline 2 \
+  -filter_complex "sws_flags=+accurate_rnd+bitexact\;testsrc=d=1:r=5:s=160x120,hflip[a]\;color=c=red:s=80x60:d=1:r=5,negate[b]\;[a][b]overlay=10:10,vflip" \
+  -fflags +bitexact
+
 FATE_FFMPEG-$(call ENCDEC2, MPEG4, RAWVIDEO, AVI, RAWVIDEO_DEMUXER FRAMECRC_MUXER) += fate-force_key_frames
 fate-force_key_frames: tests/data/vsynth1.yuv
 fate-force_key_frames: CMD = enc_dec \
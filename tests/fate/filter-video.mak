@@ -85,6 +85,9 @@ fate-filter-lavd-testsrc: CMD = framecrc -f lavfi -i testsrc=r=7:n=2:d=10
 FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2) += $(addprefix fate-filter-testsrc2-, yuv420p yuv444p rgb24 rgba)
 fate-filter-testsrc2-%: CMD = framecrc -lavfi testsrc2=r=7:d=10 -pix_fmt $(word 4, $(subst -, ,$(@)))
 
+FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2 FORMAT SCALE) += $(addprefix fate-filter-scale-premultiply-, yuva420p yuv444p)
+fate-filter-scale-premultiply-%: CMD = framecrc -lavfi testsrc2=r=7:d=1:alpha=128,format=rgba,scale=alpha_premul=premultiply,format=$(word 5, $(subst -, ,$(@)))
+
 FATE_FILTER-$(call FILTERFRAMECRC, ALLRGB) += fate-filter-allrgb
 fate-filter-allrgb: CMD = framecrc -lavfi allrgb=rate=5:duration=1 -pix_fmt rgb24
 
@@ -274,6 +277,12 @@ fate-filter-overlay_%p10: CMD = framecrc -auto_conversion_filters -c:v pgmyuv -i
 
 $(addprefix fate-filter-overlay_, nv12 nv21): REF = $(SRC_PATH)/tests/ref/fate/filter-overlay_yuv420
 
+# Waiting for the next main frame lets overlay blend in place, the output
+# must not change.
+FATE_FILTER_OVERLAY-$(call FILTERDEMDEC, SPLIT SCALE PAD OVERLAY, IMAGE2, PGMYUV) += fate-filter-overlay-lookahead
+fate-filter-overlay-lookahead: CMD = framecrc -c:v pgmyuv -i $(SRC) -/filter_complex $(FILTERGRAPH)
+fate-filter-overlay-lookahead: REF = $(SRC_PATH)/tests/ref/fate/filter-overlay_yuv420
+
 FATE_FILTER_OVERLAY_SAMPLES-$(call FILTERDEMDEC, SCALE OVERLAY, MATROSKA, H264 DVDSUB) += fate-filter-overlay-dvdsub-2397
 fate-filter-overlay-dvdsub-2397: CMD = framecrc -auto_conversion_filters -flags bitexact -i $(TARGET_SAMPLES)/filter/242_4.mkv -/filter_complex $(FILTERGRAPH) -c:a copy
 
@@ -73,3 +73,163 @@ FATE_HAPQA_EXTRACT_BSF_FFPROBE-$(call DEMMUX, MOV, MOV, HAPQA_EXTRACT_BSF HAP_DE
 FATE_SAMPLES_FFMPEG += $(FATE_HAPQA_EXTRACT_BSF-yes)
 FATE_SAMPLES_FFMPEG_FFPROBE += $(FATE_HAPQA_EXTRACT_BSF_FFPROBE-yes)
 fate-hapqa-extract-bsf: $(FATE_HAPQA_EXTRACT_BSF-yes) $(FATE_HAPQA_EXTRACT_BSF_FFPROBE-yes)
+
+
+# Encoder round trips for every FourCC on the synthetic vsynth1 input.
+# Snappy output depends on the libsnappy version, so the streams whose
+# checksums are pinned are written with the second stage disabled.
+fate-hap-enc-%: SRC = tests/data/vsynth1.yuv
+fate-hap-enc-%: CMD = enc_dec "rawvideo -s 352x288 -pix_fmt yuv420p" $(SRC) mov "-c:v hap -compressor none -frames:v 5 $(ENCOPTS)" rawvideo "-pix_fmt yuv420p" "" "" ""
+fate-hap-enc-%: CMP_UNIT = 1
+
+FATE_HAP_ENC += fate-hap-enc-hap1
+fate-hap-enc-hap1: ENCOPTS = -format hap -pix_fmt rgba
+
+FATE_HAP_ENC += fate-hap-enc-hap5
+fate-hap-enc-hap5: ENCOPTS = -format hap_alpha -pix_fmt rgba
+
+FATE_HAP_ENC += fate-hap-enc-hapy
+fate-hap-enc-hapy: ENCOPTS = -format hap_q -pix_fmt rgba
+
+FATE_HAP_ENC += fate-hap-enc-hapa
+fate-hap-enc-hapa: ENCOPTS = -format hap_a -pix_fmt gray
+
+FATE_HAP_ENC += fate-hap-enc-hapm
+fate-hap-enc-hapm: ENCOPTS = -format hap_m -pix_fmt rgba
+
+FATE_HAP_ENC += fate-hap-enc-hap7
+fate-hap-enc-hap7: ENCOPTS = -format hap_r -pix_fmt rgba
+
+$(FATE_HAP_ENC): tests/data/vsynth1.yuv
+
+# The encoded packets must not depend on the number of slice threads.
+FATE_HAP_ENC_THREADS = $(foreach F,hapm hap7,$(foreach T,1 2 5 8,fate-hap-threads-$(F)-$(T)))
+
+fate-hap-threads-hapm-%: ENCOPTS = -format hap_m
+fate-hap-threads-hapm-%: REF = $(SRC_PATH)/tests/ref/fate/hap-threads-hapm
+fate-hap-threads-hap7-%: ENCOPTS = -format hap_r
+fate-hap-threads-hap7-%: REF = $(SRC_PATH)/tests/ref/fate/hap-threads-hap7
+fate-hap-threads-%: CMD = framecrc -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -frames:v 5 -vf scale -pix_fmt rgba -c:v hap -compressor none -threads $(lastword $(subst -, ,$(@))) $(ENCOPTS)
+
+$(FATE_HAP_ENC_THREADS): tests/data/vsynth1.yuv
+
+# Chunked Snappy streams differ between libsnappy versions, so only the
+# decoded frames are compared. They must match for every chunk count and
+# for the uncompressed stream.
+HAP_CHUNKS = none 1 4 16 64
+
+tests/data/hap-chunks-%.mov: HAP_OPTS = -chunks $*
+tests/data/hap-chunks-none.mov: HAP_OPTS = -compressor none
+tests/data/hap-chunks-%.mov: TAG = GEN
+tests/data/hap-chunks-%.mov: ffmpeg$(PROGSSUF)$(EXESUF) tests/data/vsynth1.yuv | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+	-f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+	-frames:v 5 -pix_fmt rgba -c:v hap -format hap_q -threads 4 $(HAP_OPTS) \
+	-bitexact $(TARGET_PATH)/$@ -y 2>/dev/null
+
+FATE_HAP_ENC_CHUNKS = $(HAP_CHUNKS:%=fate-hap-chunks-%)
+$(FATE_HAP_ENC_CHUNKS): fate-hap-chunks-%: tests/data/hap-chunks-%.mov
+fate-hap-chunks-%: CMD = framecrc -i $(TARGET_PATH)/tests/data/hap-chunks-$(@:fate-hap-chunks-%=%).mov
+fate-hap-chunks-%: REF = $(SRC_PATH)/tests/ref/fate/hap-chunks
+
+# Packets referencing the mapped file must decode to the same frames.
+FATE_HAP_ENC_MMAP = fate-hap-mmap-0 fate-hap-mmap-1
+$(FATE_HAP_ENC_MMAP): tests/data/hap-chunks-16.mov
+fate-hap-mmap-%: CMD = framecrc -mmap $(@:fate-hap-mmap-%=%) -i $(TARGET_PATH)/tests/data/hap-chunks-16.mov
+fate-hap-mmap-%: REF = $(SRC_PATH)/tests/ref/fate/hap-chunks
+
+# Same for reads bypassing the page cache, which fall back to normal reads
+# where that is not supported.
+FATE_HAP_ENC_MMAP += fate-hap-direct
+fate-hap-direct: tests/data/hap-chunks-16.mov
+fate-hap-direct: CMD = framecrc -direct 1 -i $(TARGET_PATH)/tests/data/hap-chunks-16.mov
+fate-hap-direct: REF = $(SRC_PATH)/tests/ref/fate/hap-chunks
+
+# Same for packets read ahead in the background.
+FATE_HAP_ENC_PREFETCH = fate-hap-prefetch-1 fate-hap-prefetch-4
+$(FATE_HAP_ENC_PREFETCH): tests/data/hap-chunks-16.mov
+fate-hap-prefetch-%: CMD = framecrc -prefetch $(@:fate-hap-prefetch-%=%) -i $(TARGET_PATH)/tests/data/hap-chunks-16.mov
+fate-hap-prefetch-%: REF = $(SRC_PATH)/tests/ref/fate/hap-chunks
+
+# Same for packets read into pooled buffers.
+FATE_HAP_ENC_PREFETCH += fate-hap-packet-pool
+fate-hap-packet-pool: tests/data/hap-chunks-16.mov
+fate-hap-packet-pool: CMD = framecrc -packet_pool 1 -packet_pool_flags prefault+hugepages -i $(TARGET_PATH)/tests/data/hap-chunks-16.mov
+fate-hap-packet-pool: REF = $(SRC_PATH)/tests/ref/fate/hap-chunks
+
+# Same for frames allocated with the buffer pool flags, in the decoder and
+# in the filtergraph.
+FATE_HAP_ENC_POOL = fate-hap-buffer-pool
+fate-hap-buffer-pool: tests/data/hap-chunks-16.mov
+fate-hap-buffer-pool: CMD = framecrc -buffer_pool_flags prefault+hugepages+numa_local -i $(TARGET_PATH)/tests/data/hap-chunks-16.mov -filter_buffer_pool_flags prefault+hugetlb+numa_local -vf hflip,hflip
+fate-hap-buffer-pool: REF = $(SRC_PATH)/tests/ref/fate/hap-chunks
+
+# Reduced resolution decoding averages every block down to 2x2 or 1x1
+# pixels.
+FATE_HAP_ENC_LOWRES = fate-hap-lowres-1 fate-hap-lowres-2
+$(FATE_HAP_ENC_LOWRES): tests/data/hap-chunks-none.mov
+fate-hap-lowres-%: CMD = framecrc -lowres $(@:fate-hap-lowres-%=%) -i $(TARGET_PATH)/tests/data/hap-chunks-none.mov
+
+# Frames filtered while the slice threads decode them must be the same as
+# when filtering the complete frames.
+FATE_HAP_ENC_BAND = fate-hap-band-filter
+fate-hap-band-filter: tests/data/hap-chunks-none.mov $(APITESTSDIR)/api-band-filter-test$(EXESUF)
+fate-hap-band-filter: CMD = run $(APITESTSDIR)/api-band-filter-test$(EXESUF) $(TARGET_PATH)/tests/data/hap-chunks-none.mov 4 hflip
+
+# A packet that fails to decode must not stall the filtergraph.
+FATE_HAP_ENC_BAND += fate-hap-band-filter-truncated
+fate-hap-band-filter-truncated: tests/data/hap-chunks-none.mov $(APITESTSDIR)/api-band-filter-test$(EXESUF)
+fate-hap-band-filter-truncated: CMD = run $(APITESTSDIR)/api-band-filter-test$(EXESUF) $(TARGET_PATH)/tests/data/hap-chunks-none.mov 4 hflip 1
+
+# Cropping the textures without decoding them must give the cropped
+# frames, whatever the chunking of the input.
+FATE_HAP_ENC_CROP = fate-hap-crop-none fate-hap-crop-16
+$(FATE_HAP_ENC_CROP): fate-hap-crop-%: tests/data/hap-chunks-%.mov
+fate-hap-crop-%: CMD = framecrc -bsf:v hap_crop=x=64:y=32:w=128:h=96 -i $(TARGET_PATH)/tests/data/hap-chunks-$(@:fate-hap-crop-%=%).mov
+fate-hap-crop-%: REF = $(SRC_PATH)/tests/ref/fate/hap-crop
+
+# Rechunking must keep the textures: dropping the second stage gives the
+# packets of the uncompressed stream, adding it back the same frames.
+FATE_HAP_ENC_RECHUNK = fate-hap-rechunk-none fate-hap-rechunk-16
+fate-hap-rechunk-none: tests/data/hap-chunks-16.mov
+fate-hap-rechunk-none: CMD = framecrc -i $(TARGET_PATH)/tests/data/hap-chunks-16.mov -c:v copy -bsf:v hap_rechunk=compressor=none:threads=4
+fate-hap-rechunk-16: tests/data/hap-chunks-none.mov
+fate-hap-rechunk-16: CMD = framecrc -bsf:v hap_rechunk=compressor=snappy:chunks=16:threads=1 -i $(TARGET_PATH)/tests/data/hap-chunks-none.mov
+fate-hap-rechunk-16: REF = $(SRC_PATH)/tests/ref/fate/hap-chunks
+
+# Block reuse must give the same packets as compressing every block. The
+# input keeps most of the picture static with a moving window on top.
+FATE_HAP_ENC_REUSE = $(foreach F,hapm hap7,$(foreach R,0 1,fate-hap-reuse-$(F)-$(R)))
+
+fate-hap-reuse-hapm-%: ENCOPTS = -format hap_m
+fate-hap-reuse-hapm-%: REF = $(SRC_PATH)/tests/ref/fate/hap-reuse-hapm
+fate-hap-reuse-hap7-%: ENCOPTS = -format hap_r
+fate-hap-reuse-hap7-%: REF = $(SRC_PATH)/tests/ref/fate/hap-reuse-hap7
+fate-hap-reuse-%: CMD = framecrc -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -filter_complex "scale,format=rgba,split[a][b];[a]loop=loop=-1:size=1[bg];[b]crop=128:96:64:48[fg];[bg][fg]overlay=96:64:shortest=1:format=rgb" -frames:v 5 -c:v hap -compressor none -threads 3 -reuse_blocks $(lastword $(subst -, ,$(@))) $(ENCOPTS)
+
+$(FATE_HAP_ENC_REUSE): tests/data/vsynth1.yuv
+
+# Statistics side data; -bitexact zeroes the times in it.
+FATE_HAP_ENC_STATS = fate-hap-stats-hapm fate-hap-stats-hap7
+
+fate-hap-stats-hapm: ENCOPTS = -format hap_m
+fate-hap-stats-hap7: ENCOPTS = -format hap_r
+fate-hap-stats-%: CMD = framecrc -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -frames:v 3 -vf scale -pix_fmt rgba -c:v hap -compressor none -stats_side_data 1 $(ENCOPTS)
+
+$(FATE_HAP_ENC_STATS): tests/data/vsynth1.yuv
+
+FATE_HAP_ENC-$(call ENCDEC, HAP, MOV, RAWVIDEO_DEMUXER SCALE_FILTER) += $(FATE_HAP_ENC)
+FATE_HAP_ENC-$(call ENCMUX, HAP RAWVIDEO, FRAMECRC, RAWVIDEO_DEMUXER SCALE_FILTER PIPE_PROTOCOL FILE_PROTOCOL) += $(FATE_HAP_ENC_THREADS)
+FATE_HAP_ENC-$(call ENCDEC, HAP, MOV, RAWVIDEO_DEMUXER RAWVIDEO_ENCODER FRAMECRC_MUXER PIPE_PROTOCOL) += $(FATE_HAP_ENC_CHUNKS)
+FATE_HAP_ENC-$(call ENCDEC, HAP, MOV, RAWVIDEO_DEMUXER RAWVIDEO_ENCODER FRAMECRC_MUXER FILE_PROTOCOL PIPE_PROTOCOL) += $(FATE_HAP_ENC_MMAP)
+FATE_HAP_ENC-$(call ENCDEC, HAP, MOV, RAWVIDEO_DEMUXER RAWVIDEO_ENCODER FRAMECRC_MUXER FILE_PROTOCOL PIPE_PROTOCOL) += $(FATE_HAP_ENC_PREFETCH)
+FATE_HAP_ENC-$(call ENCDEC, HAP, MOV, RAWVIDEO_DEMUXER RAWVIDEO_ENCODER FRAMECRC_MUXER FILE_PROTOCOL PIPE_PROTOCOL HFLIP_FILTER) += $(FATE_HAP_ENC_POOL)
+FATE_HAP_ENC-$(call ENCDEC, HAP, MOV, RAWVIDEO_DEMUXER RAWVIDEO_ENCODER FRAMECRC_MUXER FILE_PROTOCOL PIPE_PROTOCOL) += $(FATE_HAP_ENC_LOWRES)
+FATE_HAP_ENC-$(if $(HAVE_THREADS),$(call ENCDEC, HAP, MOV, RAWVIDEO_DEMUXER HFLIP_FILTER)) += $(FATE_HAP_ENC_BAND)
+FATE_HAP_ENC-$(call ENCDEC, HAP, MOV, RAWVIDEO_DEMUXER RAWVIDEO_ENCODER FRAMECRC_MUXER FILE_PROTOCOL PIPE_PROTOCOL HAP_CROP_BSF) += $(FATE_HAP_ENC_CROP)
+FATE_HAP_ENC-$(call ENCDEC, HAP, MOV, RAWVIDEO_DEMUXER RAWVIDEO_ENCODER FRAMECRC_MUXER FILE_PROTOCOL PIPE_PROTOCOL HAP_RECHUNK_BSF) += $(FATE_HAP_ENC_RECHUNK)
+FATE_HAP_ENC-$(call ENCMUX, HAP RAWVIDEO, FRAMECRC, RAWVIDEO_DEMUXER SCALE_FILTER FORMAT_FILTER SPLIT_FILTER LOOP_FILTER CROP_FILTER OVERLAY_FILTER PIPE_PROTOCOL FILE_PROTOCOL) += $(FATE_HAP_ENC_REUSE)
+FATE_HAP_ENC-$(call ENCMUX, HAP RAWVIDEO, FRAMECRC, RAWVIDEO_DEMUXER SCALE_FILTER PIPE_PROTOCOL FILE_PROTOCOL) += $(FATE_HAP_ENC_STATS)
+
+FATE_FFMPEG += $(FATE_HAP_ENC-yes)
+fate-hap-enc: $(FATE_HAP_ENC-yes)
@@ -3,6 +3,8 @@ LAVF_IMAGES = $(call ALLYES, FILE_PROTOCOL IMAGE2_DEMUXER PGMYUV_DECODER \
                              $(1)_DECODER RAWVIDEO_ENCODER CRC_MUXER PIPE_PROTOCOL)
 
 FATE_LAVF_IMAGES-$(call LAVF_IMAGES,         BMP) += bmp
+FATE_LAVF_IMAGES-$(call LAVF_IMAGES,         DDS) += dds
+FATE_LAVF_IMAGES-$(call LAVF_IMAGES,         DDS) += mipmaps.dds
 FATE_LAVF_IMAGES-$(call LAVF_IMAGES,         DPX) += dpx
 FATE_LAVF_IMAGES-$(call LAVF_IMAGES,         DPX) += gbrp10le.dpx
 FATE_LAVF_IMAGES-$(call LAVF_IMAGES,         DPX) += gbrp12le.dpx
@@ -72,6 +74,8 @@ fate-lavf-none.gbrapf32le.exr:  CMD = lavf_image "-compression none  -pix_fmt gb
 fate-lavf-rle.gbrapf32le.exr:   CMD = lavf_image "-compression rle   -pix_fmt gbrapf32le" "" "no_file_checksums"
 fate-lavf-zip1.gbrapf32le.exr:  CMD = lavf_image "-compression zip1  -pix_fmt gbrapf32le" "" "no_file_checksums"
 fate-lavf-zip16.gbrapf32le.exr: CMD = lavf_image "-compression zip16 -pix_fmt gbrapf32le" "" "no_file_checksums"
+fate-lavf-dds: CMD = lavf_image "-pix_fmt rgba"
+fate-lavf-mipmaps.dds: CMD = lavf_image "-pix_fmt rgba -format bc4 -mipmaps 0 -dx10 1"
 fate-lavf-jpg: CMD = lavf_image "-pix_fmt yuvj420p"
 fate-lavf-tiff: CMD = lavf_image "-pix_fmt rgb24"
 fate-lavf-gbrp10le.dpx: CMD = lavf_image "-pix_fmt gbrp10le" "-pix_fmt gbrp10le"
@@ -22,6 +22,10 @@ FATE_LIBAVFORMAT-$(call ALLYES, MP4_MUXER ISMV_MUXER) += fate-movenc
 fate-movenc: libavformat/tests/movenc$(EXESUF)
 fate-movenc: CMD = run libavformat/tests/movenc$(EXESUF)
 
+FATE_LIBAVFORMAT-$(call ALLYES, MOV_MUXER MOV_DEMUXER) += fate-movdec
+fate-movdec: libavformat/tests/movdec$(EXESUF)
+fate-movdec: CMD = run libavformat/tests/movdec$(EXESUF)
+
 FATE_LIBAVFORMAT-$(CONFIG_IMF_DEMUXER) += fate-imf
 fate-imf: libavformat/tests/imf$(EXESUF)
 fate-imf: CMD = run libavformat/tests/imf$(EXESUF)
@@ -239,6 +239,24 @@ FATE_MOV_FFMPEG-$(call TRANSCODE, PCM_F32LE, MP4 MOV, WAV_DEMUXER PAN_FILTER) \
 fate-mov-mp4-pcm-float: tests/data/asynth-44100-1.wav
 fate-mov-mp4-pcm-float: CMD = transcode wav $(TARGET_PATH)/tests/data/asynth-44100-1.wav mp4 "-af aresample,pan=FR+FL+FR|c0=c0|c1=c0|c2=c0 -c:a pcm_f32le" "-map 0 -c copy -frames:a 0"
 
+# Test that video samples and audio chunks stay aligned when the moov is moved
+FATE_MOV_FFMPEG_FFPROBE-$(call TRANSCODE, MPEG4 PCM_S16LE, MOV, WAV_DEMUXER RAWVIDEO_DEMUXER RAWVIDEO_DECODER) \
+                          += fate-mov-sample-align
+fate-mov-sample-align: tests/data/asynth-44100-2.wav tests/data/vsynth1.yuv
+fate-mov-sample-align: CMD = transcode wav $(TARGET_PATH)/tests/data/asynth-44100-2.wav mov \
+  "-map 1:v -map 0:a -c:v mpeg4 -c:a pcm_s16le -t 0.2 -movflags +faststart -sample_align 4096" "-map 0 -c copy" \
+  "-show_entries packet=stream_index,pos,size" \
+  "-f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv"
+
+# Test that the moov is written to the space reserved from the sample count
+FATE_MOV_FFMPEG_FFPROBE-$(call TRANSCODE, MPEG4 PCM_S16LE, MOV, WAV_DEMUXER RAWVIDEO_DEMUXER RAWVIDEO_DECODER) \
+                          += fate-mov-moov-samples
+fate-mov-moov-samples: tests/data/asynth-44100-2.wav tests/data/vsynth1.yuv
+fate-mov-moov-samples: CMD = transcode wav $(TARGET_PATH)/tests/data/asynth-44100-2.wav mov \
+  "-map 1:v -map 0:a -c:v mpeg4 -c:a pcm_s16le -t 2 -movflags +faststart -moov_samples 1" "-map 0 -c copy -t 0.2" \
+  "-show_entries format=format_name,nb_streams,duration:stream=index,nb_frames" \
+  "-f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv"
+
 fate-mov-pcm-remux: tests/data/asynth-44100-1.wav
 fate-mov-pcm-remux: CMD = md5 -i $(TARGET_PATH)/tests/data/asynth-44100-1.wav -map 0 -c copy -fflags +bitexact -f mp4
 fate-mov-pcm-remux: CMP = oneline
@@ -0,0 +1,878 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Texture codec benchmark.
+ *
+ * Frames are loaded once into memory as RGBA, either decoded from an input
+ * file or synthesized, and then fed to:
+ *  - every TextureDSPEncContext / TextureDSPContext block function and the
+ *    BC7 block encoder/decoder, single-threaded;
+ *  - the Hap encoder and decoder end-to-end, for each requested format and
+ *    thread count.
+ *
+ * Throughput is reported as MPix/s of source pixels and as bytes/s of
+ * compressed texture data. For single-threaded Hap runs the encode time is
+ * split into block compression, Snappy and the rest (chunking, headers), as
+ * timed by the encoder itself and exported through its stats_side_data
+ * option. The decode stages (header parsing, Snappy, block decompression)
+ * are timed in a separate in-tool pass over the packets produced by the
+ * encoder, so they do not add up to the end-to-end decode time.
+ *
+ * Build with: make tools/texbench (requires static libraries)
+ */
+
+#include "config.h"
+#include "config_components.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "decode_simple.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/dict.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/time.h"
+
+#include "libavcodec/avcodec.h"
+#include "libavcodec/bytestream.h"
+#include "libavcodec/texturedsp.h"
+#if CONFIG_HAP_ENCODER || CONFIG_DDS_ENCODER
+#include "libavcodec/bc7enc.h"
+#endif
+#if CONFIG_HAP_DECODER || CONFIG_DDS_DECODER
+#include "libavcodec/bc7dec.h"
+#endif
+#if CONFIG_HAP_DECODER
+#include "libavcodec/hap.h"
+#include "libavcodec/snappy.h"
+#endif
+
+#include "libswscale/swscale.h"
+
+#if HAVE_UNISTD_H
+#include <unistd.h> /* for getopt */
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#define MAX_FRAMES   256
+#define MAX_THREADS   16
+
+typedef int (*block_func)(uint8_t *dst, ptrdiff_t stride, const uint8_t *block);
+
+typedef struct Kernel {
+    const char *name;
+    int tex_ratio;          // Compressed bytes per 4x4 block
+    int dec_bpp;            // Bytes per decoded pixel, 4 (RGBA) or 1 (gray)
+    unsigned psnr_mask;     // Source RGBA channels compared for PSNR
+    block_func enc;
+    block_func dec;
+
+    /* Results */
+    int run;
+    int64_t enc_us, dec_us;
+    double psnr;
+} Kernel;
+
+typedef struct HapFormat {
+    const char *name;           // Value of the encoder "format" option
+    const char *kernels[2];     // Block kernels used by each texture
+} HapFormat;
+
+static const HapFormat hap_formats[] = {
+    { "hap",       { "dxt1"                 } },
+    { "hap_alpha", { "dxt5"                 } },
+    { "hap_q",     { "dxt5ys"               } },
+    { "hap_a",     { "rgtc1_gray"           } },
+    { "hap_r",     { "bc7"                  } },
+    { "hap_m",     { "dxt5ys", "rgtc1_alpha" } },
+};
+
+typedef struct BenchContext {
+    int width, height;
+    int nb_frames;
+    uint8_t *frames[MAX_FRAMES];
+    ptrdiff_t linesize;
+
+    int runs;
+    int threads[MAX_THREADS];
+    int nb_threads;
+    int chunks;
+    const char *compressor;
+    int bc7_uber;
+    int json;
+    int first_entry;
+
+    const char *kernel_list;
+    const char *hap_list;
+
+    struct SwsContext *sws;
+} BenchContext;
+
+static Kernel kernels[] = {
+    { "dxt1",        8, 4, 0x7 },
+    { "dxt5",       16, 4, 0xF },
+    { "dxt5ys",     16, 4, 0x7 },
+    { "rgtc1_gray",  8, 1, 0x1 },
+    { "rgtc1_alpha", 8, 4, 0x8 },
+    { "bc7",        16, 4, 0xF },
+};
+
+static Kernel *find_kernel(const char *name)
+{
+    for (int i = 0; i < FF_ARRAY_ELEMS(kernels); i++)
+        if (!strcmp(kernels[i].name, name))
+            return &kernels[i];
+    return NULL;
+}
+
+static int in_list(const char *list, const char *name)
+{
+    const char *p = list;
+    size_t len = strlen(name);
+
+    if (!list)
+        return 1;
+    while ((p = strstr(p, name))) {
+        if ((p == list || p[-1] == ',') && (p[len] == ',' || !p[len]))
+            return 1;
+        p += len;
+    }
+    return 0;
+}
+
+static void init_kernels(BenchContext *b)
+{
+#if CONFIG_TEXTUREDSPENC
+    TextureDSPEncContext enc;
+    ff_texturedspenc_init(&enc);
+    find_kernel("dxt1")->enc        = enc.dxt1_block;
+    find_kernel("dxt5")->enc        = enc.dxt5_block;
+    find_kernel("dxt5ys")->enc      = enc.dxt5ys_block;
+    find_kernel("rgtc1_gray")->enc  = enc.rgtc1u_gray_block;
+    find_kernel("rgtc1_alpha")->enc = enc.rgtc1u_alpha_block;
+#endif
+#if CONFIG_TEXTUREDSP
+    {
+        TextureDSPContext dec;
+        ff_texturedsp_init(&dec);
+        find_kernel("dxt1")->dec        = dec.dxt1_block;
+        find_kernel("dxt5")->dec        = dec.dxt5_block;
+        find_kernel("dxt5ys")->dec      = dec.dxt5ys_block;
+        find_kernel("rgtc1_gray")->dec  = dec.rgtc1u_gray_block;
+        find_kernel("rgtc1_alpha")->dec = dec.rgtc1u_alpha_block;
+    }
+#endif
+#if CONFIG_HAP_ENCODER || CONFIG_DDS_ENCODER
+    {
+        BC7EncContext bc7;
+        ff_bc7enc_init(&bc7, BC7ENC_TRUE, BC7ENC_MAX_PARTITIONS1, b->bc7_uber,
+                       BC7ENC_TRUE, BC7ENC_TRUE);
+        find_kernel("bc7")->enc = bc7.bc7enc_block;
+    }
+#endif
+#if CONFIG_HAP_DECODER || CONFIG_DDS_DECODER
+    find_kernel("bc7")->dec = ff_bc7dec_block;
+#endif
+}
+
+/* Accumulate squared error over the channels in mask; dec is RGBA or gray. */
+static void add_sse(const BenchContext *b, const uint8_t *src, ptrdiff_t src_linesize,
+                    const uint8_t *dec, ptrdiff_t dec_linesize, int dec_bpp,
+                    unsigned mask, uint64_t *sse, uint64_t *count)
+{
+    for (int y = 0; y < b->height; y++) {
+        const uint8_t *s = src + y * src_linesize;
+        const uint8_t *d = dec + y * dec_linesize;
+        for (int x = 0; x < b->width; x++) {
+            for (int c = 0; c < 4; c++) {
+                int diff;
+                if (!(mask & (1 << c)))
+                    continue;
+                diff = s[x * 4 + c] - (dec_bpp == 1 ? d[x] : d[x * 4 + c]);
+                *sse += diff * diff;
+                (*count)++;
+            }
+        }
+    }
+}
+
+static double sse_to_psnr(uint64_t sse, uint64_t count)
+{
+    if (!sse)
+        return INFINITY;
+    return 10.0 * log10(255.0 * 255.0 * count / sse);
+}
+
+static void compress_frame(const BenchContext *b, const Kernel *k,
+                           uint8_t *tex, const uint8_t *src)
+{
+    for (int y = 0; y < b->height; y += TEXTURE_BLOCK_H)
+        for (int x = 0; x < b->width; x += TEXTURE_BLOCK_W)
+            tex += k->enc(tex, b->linesize, src + y * b->linesize + x * 4);
+}
+
+static void decompress_frame(const BenchContext *b, const Kernel *k,
+                             uint8_t *dst, ptrdiff_t dst_linesize, const uint8_t *tex)
+{
+    for (int y = 0; y < b->height; y += TEXTURE_BLOCK_H)
+        for (int x = 0; x < b->width; x += TEXTURE_BLOCK_W)
+            tex += k->dec(dst + y * dst_linesize + x * k->dec_bpp, dst_linesize, tex);
+}
+
+static size_t tex_size(const BenchContext *b, const Kernel *k)
+{
+    return (size_t)(b->width / TEXTURE_BLOCK_W) * (b->height / TEXTURE_BLOCK_H) * k->tex_ratio;
+}
+
+static int bench_kernel(BenchContext *b, Kernel *k)
+{
+    size_t size = tex_size(b, k);
+    ptrdiff_t dec_linesize = b->width * k->dec_bpp;
+    uint8_t *tex = av_malloc(size * b->nb_frames);
+    uint8_t *out = av_mallocz(dec_linesize * b->height);
+    uint64_t sse = 0, count = 0;
+    int64_t t0;
+
+    if (!tex || !out) {
+        av_free(tex);
+        av_free(out);
+        return AVERROR(ENOMEM);
+    }
+
+    t0 = av_gettime_relative();
+    for (int r = 0; r < b->runs; r++)
+        for (int i = 0; i < b->nb_frames; i++)
+            compress_frame(b, k, tex + i * size, b->frames[i]);
+    k->enc_us = av_gettime_relative() - t0;
+
+    if (k->dec) {
+        t0 = av_gettime_relative();
+        for (int r = 0; r < b->runs; r++)
+            for (int i = 0; i < b->nb_frames; i++)
+                decompress_frame(b, k, out, dec_linesize, tex + i * size);
+        k->dec_us = av_gettime_relative() - t0;
+
+        for (int i = 0; i < b->nb_frames; i++) {
+            decompress_frame(b, k, out, dec_linesize, tex + i * size);
+            add_sse(b, b->frames[i], b->linesize, out, dec_linesize, k->dec_bpp,
+                    k->psnr_mask, &sse, &count);
+        }
+        k->psnr = sse_to_psnr(sse, count);
+    }
+    k->run = 1;
+
+    av_free(tex);
+    av_free(out);
+    return 0;
+}
+
+static void print_rate(const BenchContext *b, const char *label,
+                       int64_t us, uint64_t bytes, int last)
+{
+    double pixels = (double)b->width * b->height * b->nb_frames * b->runs;
+    double secs   = FFMAX(us, 1) / 1000000.0;
+
+    if (b->json)
+        printf("\"%s\": { \"time_us\": %"PRId64", \"mpix_s\": %.3f, \"bytes_s\": %.0f }%s",
+               label, us, pixels / secs / 1000000.0, bytes * b->runs / secs, last ? "" : ", ");
+    else
+        printf("  %s %9.2f MPix/s %9.2f MB/s", label, pixels / secs / 1000000.0,
+               bytes * b->runs / secs / 1000000.0);
+}
+
+static void print_psnr(const BenchContext *b, double psnr)
+{
+    if (b->json) {
+        if (isinf(psnr))
+            printf("\"psnr\": null");
+        else
+            printf("\"psnr\": %.3f", psnr);
+    } else {
+        printf("  PSNR %6.2f dB", psnr);
+    }
+}
+
+static void begin_entry(BenchContext *b)
+{
+    if (b->json)
+        printf("%s\n    { ", b->first_entry ? "" : ",");
+    b->first_entry = 0;
+}
+
+static void report_kernel(BenchContext *b, const Kernel *k)
+{
+    uint64_t bytes = tex_size(b, k) * b->nb_frames;
+
+    begin_entry(b);
+    if (b->json)
+        printf("\"name\": \"%s\", ", k->name);
+    else
+        printf("%-12s", k->name);
+    print_rate(b, "encode", k->enc_us, bytes, !k->dec);
+    if (k->dec) {
+        print_rate(b, "decode", k->dec_us, bytes, 0);
+        print_psnr(b, k->psnr);
+    }
+    printf(b->json ? " }" : "\n");
+}
+
+#if CONFIG_HAP_DECODER
+typedef struct HapTexture {
+    int fmt;
+    int chunk_count;
+    HapChunk chunks[64];
+    const uint8_t *data;
+} HapTexture;
+
+/* Parse one texture section; mirrors hap_parse_frame_header() in hapdec.c. */
+static int parse_hap_texture(GetByteContext *gb, HapTexture *tex)
+{
+    enum HapSectionType type;
+    int size, ret;
+
+    ret = ff_hap_parse_section_header(gb, &size, &type);
+    if (ret < 0)
+        return ret;
+    tex->fmt = type & 0x0F;
+
+    if ((type & 0xF0) != HAP_COMP_COMPLEX) {
+        tex->chunk_count = 1;
+        tex->chunks[0].compressor        = type & 0xF0;
+        tex->chunks[0].compressed_offset = 0;
+        tex->chunks[0].compressed_size   = size;
+        tex->data = gb->buffer;
+        bytestream2_skip(gb, size);
+        return 0;
+    }
+
+    ret = ff_hap_parse_section_header(gb, &size, &type);
+    if (ret < 0 || type != HAP_ST_DECODE_INSTRUCTIONS)
+        return AVERROR_INVALIDDATA;
+    {
+        const uint8_t *end = gb->buffer + size;
+        size_t offset = 0;
+
+        while (gb->buffer < end) {
+            ret = ff_hap_parse_section_header(gb, &size, &type);
+            if (ret < 0)
+                return ret;
+            if (type == HAP_ST_COMPRESSOR_TABLE) {
+                tex->chunk_count = FFMIN(size, FF_ARRAY_ELEMS(tex->chunks));
+                for (int i = 0; i < tex->chunk_count; i++)
+                    tex->chunks[i].compressor = bytestream2_get_byte(gb) << 4;
+                bytestream2_skip(gb, size - tex->chunk_count);
+            } else if (type == HAP_ST_SIZE_TABLE) {
+                for (int i = 0; i < size / 4; i++) {
+                    size_t chunk_size = bytestream2_get_le32(gb);
+                    if (i < FF_ARRAY_ELEMS(tex->chunks)) {
+                        tex->chunks[i].compressed_size   = chunk_size;
+                        tex->chunks[i].compressed_offset = offset;
+                    }
+                    offset += chunk_size;
+                }
+            } else {
+                bytestream2_skip(gb, size);
+            }
+        }
+        tex->data = gb->buffer;
+        bytestream2_skip(gb, offset);
+    }
+    return 0;
+}
+
+static int parse_hap_packet(const AVPacket *pkt, HapTexture *tex, int *nb_tex)
+{
+    GetByteContext gb;
+    enum HapSectionType type;
+    int size, ret;
+
+    bytestream2_init(&gb, pkt->data, pkt->size);
+    *nb_tex = 1;
+    if ((pkt->data[3] & 0x0F) == HAP_FMT_HAPM) {
+        ret = ff_hap_parse_section_header(&gb, &size, &type);
+        if (ret < 0)
+            return ret;
+        *nb_tex = 2;
+    }
+    for (int t = 0; t < *nb_tex; t++) {
+        ret = parse_hap_texture(&gb, &tex[t]);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static void bench_hap_stages(BenchContext *b, const HapFormat *fmt,
+                             AVPacket **pkts, int64_t *stage_us)
+{
+    HapTexture tex[2];
+    uint8_t *buf[2] = { NULL };
+    uint8_t *out = av_malloc(b->width * 4 * b->height);
+    int nb_tex = 1;
+    int64_t t0;
+
+    for (int t = 0; t < 2; t++) {
+        const Kernel *k = fmt->kernels[t] ? find_kernel(fmt->kernels[t]) : NULL;
+        if (k)
+            buf[t] = av_malloc(tex_size(b, k));
+    }
+
+    memset(stage_us, 0, 3 * sizeof(*stage_us));
+    for (int r = 0; r < b->runs; r++) {
+        for (int i = 0; i < b->nb_frames; i++) {
+            t0 = av_gettime_relative();
+            if (parse_hap_packet(pkts[i], tex, &nb_tex) < 0)
+                continue;
+            stage_us[0] += av_gettime_relative() - t0;
+
+            for (int t = 0; t < nb_tex; t++) {
+                const Kernel *k = find_kernel(fmt->kernels[t]);
+                const uint8_t *src = tex[t].data;
+                size_t done = 0;
+
+                if (!k || !buf[t] || !out)
+                    continue;
+
+                t0 = av_gettime_relative();
+                for (int c = 0; c < tex[t].chunk_count; c++) {
+                    const HapChunk *chunk = &tex[t].chunks[c];
+                    GetByteContext gb;
+                    int64_t size = tex_size(b, k) - done;
+
+                    bytestream2_init(&gb, src + chunk->compressed_offset, chunk->compressed_size);
+                    if (chunk->compressor == HAP_COMP_SNAPPY) {
+                        if (ff_snappy_uncompress(&gb, buf[t] + done, &size) < 0)
+                            break;
+                        done += size;
+                    } else {
+                        memcpy(buf[t] + done, gb.buffer, FFMIN(chunk->compressed_size, size));
+                        done += FFMIN(chunk->compressed_size, size);
+                    }
+                }
+                stage_us[1] += av_gettime_relative() - t0;
+
+                t0 = av_gettime_relative();
+                decompress_frame(b, k, out, b->width * k->dec_bpp, buf[t]);
+                stage_us[2] += av_gettime_relative() - t0;
+            }
+        }
+    }
+
+    av_free(buf[0]);
+    av_free(buf[1]);
+    av_free(out);
+}
+#endif
+
+/**
+ * Add the stage times the Hap encoder exported for one packet.
+ */
+static int add_hap_stats(const AVPacket *pkt, int64_t *block_us, int64_t *snappy_us)
+{
+    AVDictionary *dict = NULL;
+    const AVDictionaryEntry *e;
+    size_t size;
+    const uint8_t *data = av_packet_get_side_data(pkt, AV_PKT_DATA_STRINGS_METADATA, &size);
+    int ret;
+
+    if (!data)
+        return 0;
+    ret = av_packet_unpack_dictionary(data, size, &dict);
+    if (ret < 0)
+        return ret;
+    if ((e = av_dict_get(dict, "hap.block_us", NULL, 0)))
+        *block_us += strtoll(e->value, NULL, 10);
+    if ((e = av_dict_get(dict, "hap.snappy_us", NULL, 0)))
+        *snappy_us += strtoll(e->value, NULL, 10);
+    av_dict_free(&dict);
+    return 0;
+}
+
+static int bench_hap(BenchContext *b, const HapFormat *fmt, int threads)
+{
+    const AVCodec *encoder = avcodec_find_encoder_by_name("hap");
+    const AVCodec *decoder = avcodec_find_decoder_by_name("hap");
+    AVCodecContext *enc = NULL, *dec = NULL;
+    AVPacket *pkts[MAX_FRAMES] = { NULL };
+    AVPacket *pkt = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    uint64_t bytes = 0, sse = 0, count = 0;
+    int64_t enc_us = 0, dec_us = 0, t0;
+    int64_t enc_block_us = 0, enc_snappy_us = 0;
+    int ret;
+
+    if (!pkt || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    enc = avcodec_alloc_context3(encoder);
+    if (!enc) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    enc->width        = b->width;
+    enc->height       = b->height;
+    enc->pix_fmt      = AV_PIX_FMT_RGBA;
+    enc->time_base    = (AVRational){ 1, 25 };
+    enc->thread_count = threads;
+    enc->thread_type  = FF_THREAD_SLICE;
+    av_opt_set(enc->priv_data, "format", fmt->name, 0);
+    av_opt_set(enc->priv_data, "compressor", b->compressor, 0);
+    av_opt_set_int(enc->priv_data, "chunks", b->chunks, 0);
+    av_opt_set_int(enc->priv_data, "bc7_uber", b->bc7_uber, 0);
+    av_opt_set_int(enc->priv_data, "stats_side_data", threads == 1, 0);
+    ret = avcodec_open2(enc, encoder, NULL);
+    if (ret < 0)
+        goto end;
+
+    frame->width  = b->width;
+    frame->height = b->height;
+    frame->format = AV_PIX_FMT_RGBA;
+
+    for (int r = 0; r < b->runs; r++) {
+        for (int i = 0; i < b->nb_frames; i++) {
+            frame->data[0]     = b->frames[i];
+            frame->linesize[0] = b->linesize;
+            frame->pts         = r * b->nb_frames + i;
+            t0 = av_gettime_relative();
+            ret = avcodec_send_frame(enc, frame);
+            if (ret < 0)
+                goto end;
+            ret = avcodec_receive_packet(enc, pkt);
+            if (ret < 0)
+                goto end;
+            enc_us += av_gettime_relative() - t0;
+            if (threads == 1) {
+                ret = add_hap_stats(pkt, &enc_block_us, &enc_snappy_us);
+                if (ret < 0)
+                    goto end;
+            }
+            if (!r) {
+                bytes += pkt->size;
+                pkts[i] = av_packet_clone(pkt);
+                if (!pkts[i]) {
+                    ret = AVERROR(ENOMEM);
+                    goto end;
+                }
+            }
+            av_packet_unref(pkt);
+        }
+    }
+    frame->data[0] = NULL;
+
+    dec = avcodec_alloc_context3(decoder);
+    if (!dec) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    dec->width        = b->width;
+    dec->height       = b->height;
+    dec->codec_tag    = enc->codec_tag;
+    dec->thread_count = threads;
+    dec->thread_type  = FF_THREAD_SLICE;
+    ret = avcodec_open2(dec, decoder, NULL);
+    if (ret < 0)
+        goto end;
+
+    t0 = av_gettime_relative();
+    for (int r = 0; r < b->runs; r++) {
+        for (int i = 0; i < b->nb_frames; i++) {
+            ret = avcodec_send_packet(dec, pkts[i]);
+            if (ret < 0)
+                goto end;
+            ret = avcodec_receive_frame(dec, frame);
+            if (ret < 0)
+                goto end;
+            if (!r) {
+                int gray = frame->format == AV_PIX_FMT_GRAY8;
+                unsigned mask = gray ? 0x1 : frame->format == AV_PIX_FMT_RGBA ? 0xF : 0x7;
+                add_sse(b, b->frames[i], b->linesize, frame->data[0], frame->linesize[0],
+                        gray ? 1 : 4, mask, &sse, &count);
+            }
+            av_frame_unref(frame);
+        }
+    }
+    dec_us = av_gettime_relative() - t0;
+
+    begin_entry(b);
+    if (b->json)
+        printf("\"format\": \"%s\", \"threads\": %d, \"chunks\": %d, \"compressor\": \"%s\", "
+               "\"bytes\": %"PRIu64", ", fmt->name, threads, b->chunks, b->compressor, bytes);
+    else
+        printf("%-10s t=%-2d", fmt->name, threads);
+    print_rate(b, "encode", enc_us, bytes, 0);
+    print_rate(b, "decode", dec_us, bytes, 0);
+    print_psnr(b, sse_to_psnr(sse, count));
+
+    if (threads == 1) {
+        int64_t dec_stage_us[3] = { 0 };
+
+#if CONFIG_HAP_DECODER
+        bench_hap_stages(b, fmt, pkts, dec_stage_us);
+#endif
+        if (b->json)
+            printf(", \"stages\": { \"encode\": { \"block_us\": %"PRId64", \"snappy_us\": %"PRId64
+                   ", \"other_us\": %"PRId64" }, \"decode_pass\": { \"header_us\": %"PRId64
+                   ", \"snappy_us\": %"PRId64", \"block_us\": %"PRId64" } }",
+                   enc_block_us, enc_snappy_us, enc_us - enc_block_us - enc_snappy_us,
+                   dec_stage_us[0], dec_stage_us[1], dec_stage_us[2]);
+        else
+            printf("\n             encode stages: block %.1f ms, snappy %.1f ms, other %.1f ms"
+                   "\n             separate decode pass: header %.1f ms, snappy %.1f ms, block %.1f ms",
+                   enc_block_us / 1000.0, enc_snappy_us / 1000.0,
+                   (enc_us - enc_block_us - enc_snappy_us) / 1000.0,
+                   dec_stage_us[0] / 1000.0, dec_stage_us[1] / 1000.0, dec_stage_us[2] / 1000.0);
+    }
+    printf(b->json ? " }" : "\n");
+    ret = 0;
+
+end:
+    if (ret < 0)
+        fprintf(stderr, "%s (threads=%d): %s\n", fmt->name, threads, av_err2str(ret));
+    for (int i = 0; i < MAX_FRAMES; i++)
+        av_packet_free(&pkts[i]);
+    av_packet_free(&pkt);
+    av_frame_free(&frame);
+    avcodec_free_context(&enc);
+    avcodec_free_context(&dec);
+    return ret;
+}
+
+static int store_frame(DecodeContext *dc, AVFrame *frame)
+{
+    BenchContext *b = dc->opaque;
+    uint8_t *dst[4] = { NULL };
+    int dst_linesize[4] = { b->linesize };
+
+    if (!frame || b->nb_frames >= MAX_FRAMES)
+        return 0;
+
+    if (!b->sws) {
+        b->sws = sws_getContext(frame->width, frame->height, frame->format,
+                                b->width, b->height, AV_PIX_FMT_RGBA,
+                                SWS_BICUBIC, NULL, NULL, NULL);
+        if (!b->sws)
+            return AVERROR(EINVAL);
+    }
+
+    b->frames[b->nb_frames] = av_malloc(b->linesize * b->height);
+    if (!b->frames[b->nb_frames])
+        return AVERROR(ENOMEM);
+    dst[0] = b->frames[b->nb_frames++];
+
+    return sws_scale(b->sws, (const uint8_t * const *)frame->data, frame->linesize,
+                     0, frame->height, dst, dst_linesize);
+}
+
+static int load_frames(BenchContext *b, const char *url, int max_frames)
+{
+    DecodeContext dc = { 0 };
+    int ret;
+
+    ret = ds_open(&dc, url, 0);
+    if (ret < 0)
+        return ret;
+
+    /* Texture formats work on 4x4 blocks. */
+    if (!b->width) {
+        b->width  = FFMAX(dc.decoder->width  & ~3, 4);
+        b->height = FFMAX(dc.decoder->height & ~3, 4);
+    }
+    b->linesize      = b->width * 4;
+    dc.process_frame = store_frame;
+    dc.opaque        = b;
+    dc.max_frames    = max_frames;
+
+    ret = ds_run(&dc);
+    ds_free(&dc);
+    sws_freeContext(b->sws);
+    b->sws = NULL;
+    return ret;
+}
+
+/* Smooth gradients, hard edges, flat areas, noise and a semi-transparent
+ * region, moving slightly from frame to frame. */
+static int synth_frames(BenchContext *b, int nb_frames)
+{
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, 0xdeadbeef);
+    b->linesize = b->width * 4;
+    for (int i = 0; i < nb_frames; i++) {
+        uint8_t *p = av_malloc(b->linesize * b->height);
+        if (!p)
+            return AVERROR(ENOMEM);
+        b->frames[b->nb_frames++] = p;
+        for (int y = 0; y < b->height; y++) {
+            for (int x = 0; x < b->width; x++) {
+                uint8_t *px = p + y * b->linesize + x * 4;
+                int xx = x + i * 3;
+                if (y < b->height / 3) {
+                    px[0] = xx * 255 / b->width;
+                    px[1] = y  * 255 / b->height;
+                    px[2] = 128;
+                } else if (y < 2 * b->height / 3) {
+                    int on = ((xx >> 4) ^ (y >> 4)) & 1;
+                    px[0] = on ? 230 : 20;
+                    px[1] = on ? 40  : 200;
+                    px[2] = on ? 90  : 60;
+                } else {
+                    px[0] = av_lfg_get(&lfg);
+                    px[1] = av_lfg_get(&lfg);
+                    px[2] = av_lfg_get(&lfg);
+                }
+                px[3] = x < b->width / 2 ? 255 : (xx + y) & 0xFF;
+            }
+        }
+    }
+    return 0;
+}
+
+static void usage(void)
+{
+    printf("Usage: texbench [options]\n"
+           "  -i <url>       load frames from a file instead of synthesizing them\n"
+           "  -s <WxH>       frame size (default 1280x720 or the input size)\n"
+           "  -n <frames>    number of frames to keep in memory (default 8)\n"
+           "  -r <runs>      number of passes over the frames (default 1)\n"
+           "  -t <list>      comma separated thread counts for Hap (default 1)\n"
+           "  -c <chunks>    Hap chunk count (default 1)\n"
+           "  -z <name>      Hap compressor, snappy or none (default snappy)\n"
+           "  -u <level>     BC7 uber level (default 0)\n"
+           "  -k <list>      block kernels to run (default all)\n"
+           "  -f <list>      Hap formats to run (default all, \"none\" to skip)\n"
+           "  -j             JSON output\n");
+}
+
+int main(int argc, char **argv)
+{
+    BenchContext b = {
+        .runs        = 1,
+        .threads     = { 1 },
+        .nb_threads  = 1,
+        .chunks      = 1,
+        .compressor  = "snappy",
+        .first_entry = 1,
+    };
+    const char *url = NULL;
+    int nb_frames = 8;
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "i:s:n:r:t:c:z:u:k:f:jh")) != -1) {
+        switch (opt) {
+        case 'i': url = optarg;                                             break;
+        case 's':
+            if (sscanf(optarg, "%dx%d", &b.width, &b.height) != 2 ||
+                b.width < 4 || b.height < 4) {
+                fprintf(stderr, "Invalid size %s\n", optarg);
+                return 1;
+            }
+            b.width  &= ~3;
+            b.height &= ~3;
+            break;
+        case 'n': nb_frames = av_clip(atoi(optarg), 1, MAX_FRAMES);         break;
+        case 'r': b.runs    = FFMAX(atoi(optarg), 1);                       break;
+        case 'c': b.chunks  = av_clip(atoi(optarg), 1, 64);                 break;
+        case 'z': b.compressor = optarg;                                    break;
+        case 'u': b.bc7_uber   = av_clip(atoi(optarg), 0, 4);               break;
+        case 'k': b.kernel_list = optarg;                                   break;
+        case 'f': b.hap_list    = optarg;                                   break;
+        case 'j': b.json = 1;                                               break;
+        case 't': {
+            char *p = optarg;
+            b.nb_threads = 0;
+            while (*p && b.nb_threads < MAX_THREADS) {
+                b.threads[b.nb_threads++] = av_clip(strtol(p, &p, 10), 1, 64);
+                if (*p == ',')
+                    p++;
+                else
+                    break;
+            }
+            break;
+        }
+        default:
+            usage();
+            return opt != 'h';
+        }
+    }
+
+    if (url) {
+        ret = load_frames(&b, url, nb_frames);
+    } else {
+        if (!b.width) {
+            b.width  = 1280;
+            b.height = 720;
+        }
+        ret = synth_frames(&b, nb_frames);
+    }
+    if (ret < 0 || !b.nb_frames) {
+        fprintf(stderr, "Could not load frames: %s\n", av_err2str(ret));
+        return 1;
+    }
+
+    init_kernels(&b);
+
+    if (b.json)
+        printf("{ \"width\": %d, \"height\": %d, \"frames\": %d, \"runs\": %d,\n"
+               "  \"kernels\": [", b.width, b.height, b.nb_frames, b.runs);
+    else
+        printf("%dx%d, %d frames, %d runs\n", b.width, b.height, b.nb_frames, b.runs);
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(kernels); i++) {
+        Kernel *k = &kernels[i];
+        if (!k->enc || !in_list(b.kernel_list, k->name))
+            continue;
+        ret = bench_kernel(&b, k);
+        if (ret < 0)
+            return 1;
+        report_kernel(&b, k);
+    }
+
+    if (b.json) {
+        printf(" ],\n  \"hap\": [");
+        b.first_entry = 1;
+    }
+    if (!avcodec_find_encoder_by_name("hap") || !avcodec_find_decoder_by_name("hap")) {
+        if (!b.hap_list || strcmp(b.hap_list, "none"))
+            fprintf(stderr, "Hap encoder or decoder not available, skipping Hap benchmarks\n");
+    } else {
+        for (int i = 0; i < FF_ARRAY_ELEMS(hap_formats); i++) {
+            if (!in_list(b.hap_list, hap_formats[i].name))
+                continue;
+            for (int t = 0; t < b.nb_threads; t++)
+                bench_hap(&b, &hap_formats[i], b.threads[t]);
+        }
+    }
+    if (b.json)
+        printf(" ]\n}\n");
+
+    for (int i = 0; i < b.nb_frames; i++)
+        av_free(b.frames[i]);
+
+    return 0;
+}
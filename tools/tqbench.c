@@ -0,0 +1,227 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Thread queue benchmark.
+ *
+ * Measures the fftools thread queues as used between the ffmpeg scheduler
+ * threads, in both the general and the single producer/consumer variant:
+ *  - stream: one thread sends packets as fast as it can, another receives
+ *    them; reported as time per packet;
+ *  - ping-pong: a packet is sent back and forth between two threads over a
+ *    pair of queues, so that every hop wakes the other side; reported as
+ *    time per hop, i.e. the latency of a send on an idle queue.
+ * Where available, context switches per item are reported as well, as the
+ * number of times the threads had to sleep and be woken up.
+ *
+ * Build with: make tools/tqbench
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavutil/error.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "libavcodec/packet.h"
+
+#include "fftools/thread_queue.h"
+
+#if HAVE_SYS_RESOURCE_H
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h> /* for getopt */
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+typedef struct Bench {
+    ThreadQueue *q[2];
+    int64_t      nb_items;
+    int          ret;
+} Bench;
+
+static ThreadQueue *queue_alloc(int spsc, size_t queue_size)
+{
+    return spsc ? tq_alloc_spsc(queue_size, THREAD_QUEUE_PACKETS) :
+                  tq_alloc(1, queue_size, THREAD_QUEUE_PACKETS);
+}
+
+/* Receive from q[0], forwarding to q[1] if present, until EOF. */
+static void *receiver(void *arg)
+{
+    Bench *b = arg;
+    AVPacket *pkt = av_packet_alloc();
+    int64_t nb = 0;
+    int ret = 0, idx;
+
+    if (!pkt) {
+        b->ret = AVERROR(ENOMEM);
+        return NULL;
+    }
+
+    while ((ret = tq_receive(b->q[0], &idx, pkt)) >= 0) {
+        if (pkt->pos != nb++) {
+            ret = AVERROR_BUG;
+            break;
+        }
+        if (b->q[1]) {
+            ret = tq_send(b->q[1], 0, pkt);
+            if (ret < 0)
+                break;
+        } else
+            av_packet_unref(pkt);
+    }
+    if (b->q[1])
+        tq_send_finish(b->q[1], 0);
+    tq_receive_finish(b->q[0], 0);
+
+    b->ret = (ret == AVERROR_EOF && nb == b->nb_items) ? 0 :
+             ret < 0 && ret != AVERROR_EOF ? ret : AVERROR_BUG;
+    av_packet_free(&pkt);
+    return NULL;
+}
+
+static int64_t context_switches(void)
+{
+#if HAVE_GETRUSAGE
+    struct rusage rusage;
+    getrusage(RUSAGE_SELF, &rusage);
+    return rusage.ru_nvcsw + rusage.ru_nivcsw;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @return time per item in nanoseconds or a negative error code
+ */
+static double run(int spsc, int pingpong, size_t queue_size, int64_t nb_items,
+                  double *switches)
+{
+    Bench b = { .nb_items = nb_items };
+    AVPacket *pkt = av_packet_alloc();
+    pthread_t thread;
+    int64_t t0, t1, cs;
+    int ret = 0, idx;
+
+    b.q[0] = queue_alloc(spsc, queue_size);
+    if (pingpong)
+        b.q[1] = queue_alloc(spsc, queue_size);
+    if (!pkt || !b.q[0] || (pingpong && !b.q[1])) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    ret = pthread_create(&thread, NULL, receiver, &b);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto end;
+    }
+
+    cs = context_switches();
+    t0 = av_gettime_relative();
+    for (int64_t i = 0; i < nb_items; i++) {
+        pkt->pos = i;
+        ret = tq_send(b.q[0], 0, pkt);
+        if (ret < 0)
+            break;
+        if (pingpong) {
+            ret = tq_receive(b.q[1], &idx, pkt);
+            if (ret < 0)
+                break;
+            av_packet_unref(pkt);
+        }
+    }
+    tq_send_finish(b.q[0], 0);
+    pthread_join(thread, NULL);
+    t1 = av_gettime_relative();
+    *switches = (double)(context_switches() - cs) / nb_items;
+
+    if (ret >= 0)
+        ret = b.ret;
+end:
+    tq_free(&b.q[0]);
+    tq_free(&b.q[1]);
+    av_packet_free(&pkt);
+    if (ret < 0)
+        return ret;
+    return (t1 - t0) * 1000.0 / (nb_items * (pingpong ? 2 : 1));
+}
+
+static void usage(void)
+{
+    printf("Usage: tqbench [options]\n"
+           "  -n <count>     number of packets per run (default 200000)\n"
+           "  -q <size>      queue size (default 8)\n"
+           "  -r <runs>      number of runs, the fastest is reported (default 3)\n");
+}
+
+int main(int argc, char **argv)
+{
+    static const char *const names[] = { "general", "spsc" };
+    int64_t nb_items  = 200000;
+    size_t queue_size = 8;
+    int runs = 3, opt;
+
+    while ((opt = getopt(argc, argv, "n:q:r:h")) != -1) {
+        switch (opt) {
+        case 'n': nb_items   = strtoll(optarg, NULL, 0); break;
+        case 'q': queue_size = strtoul(optarg, NULL, 0); break;
+        case 'r': runs       = atoi(optarg);             break;
+        default:
+            usage();
+            return opt != 'h';
+        }
+    }
+    if (nb_items <= 0 || !queue_size || runs <= 0) {
+        usage();
+        return 1;
+    }
+
+    printf("%-10s %-8s %12s %12s\n", "test", "queue", "ns/item", "switches/item");
+    for (int pingpong = 0; pingpong < 2; pingpong++) {
+        for (int spsc = 0; spsc < 2; spsc++) {
+            double best = 0, best_switches = 0;
+
+            for (int i = 0; i < runs; i++) {
+                double switches;
+                double t = run(spsc, pingpong, queue_size, nb_items, &switches);
+                if (t < 0) {
+                    fprintf(stderr, "%s queue failed: %s\n", names[spsc],
+                            av_err2str((int)t));
+                    return 1;
+                }
+                if (!i || t < best) {
+                    best          = t;
+                    best_switches = switches;
+                }
+            }
+            printf("%-10s %-8s %12.1f %12.3f\n", pingpong ? "ping-pong" : "stream",
+                   names[spsc], best, best_switches);
+        }
+    }
+
+    return 0;
+}